@@ -164,8 +164,13 @@ int main(int argv, char* argc[])
     {
         for (const auto& i : ant_vec)
         {
-            pcv_pattern pcv ( atx.get_antenna_pattern(i) );
-            print_pcv_info(pcv, i,
+            auto pcv = atx.cached_antenna_pattern(i);
+            if ( !pcv )
+            {
+                std::cerr<<"\nAntenna not found: "<<i.to_string()<<"\n";
+                return 1;
+            }
+            print_pcv_info(*pcv, i,
                     zen_start, zen_stop, zen_step, azi_start, azi_stop, azi_step);
         }
     }
@@ -177,14 +182,24 @@ int main(int argv, char* argc[])
             return 1;
         }
         antenna ref_ant = ant_vec[0];
-        pcv_pattern ref_pcv ( atx.get_antenna_pattern(ref_ant) );
+        auto ref_pcv = atx.cached_antenna_pattern(ref_ant);
+        if ( !ref_pcv )
+        {
+            std::cerr<<"\nAntenna not found: "<<ref_ant.to_string()<<"\n";
+            return 1;
+        }
         auto ant = ant_vec.cbegin() + 1;
         auto last_ant = ant_vec.cend();
 
         while ( ant != last_ant )
         {
-            pcv_pattern pcv ( atx.get_antenna_pattern(*ant) );
-            print_pcv_diff(pcv, *ant, ref_pcv, ref_ant,
+            auto pcv = atx.cached_antenna_pattern(*ant);
+            if ( !pcv )
+            {
+                std::cerr<<"\nAntenna not found: "<<ant->to_string()<<"\n";
+                return 1;
+            }
+            print_pcv_diff(*pcv, *ant, *ref_pcv, ref_ant,
                     zen_start, zen_stop, zen_step, azi_start, azi_stop, azi_step);
             ++ant;
         }
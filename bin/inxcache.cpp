@@ -0,0 +1,77 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <stdexcept>
+
+#include "ionex.hpp"
+
+void help();
+void usage();
+
+// Convert IONEX files to binary cache files (see ionex::write_cache()); any
+// program reading IONEX files will read the cache files just as well, only
+// with no parsing.
+int main(int argv, char* argc[])
+{
+    if ( argv < 2 ) {
+        usage();
+        std::cout << "\n";
+        return 1;
+    }
+    if ( !std::strcmp(argc[1], "-h") || !std::strcmp(argc[1], "--help") ) {
+        help();
+        std::cout << "\n";
+        usage();
+        std::cout << "\n";
+        return 0;
+    }
+
+    int errors = 0;
+    for (int i=1; i<argv; ++i) {
+        std::string cache ( std::string(argc[i]) + ".bin" );
+        try {
+            ngpt::ionex inx ( argc[i] );
+            if ( inx.load() || inx.write_cache(cache.c_str()) ) {
+                std::cerr << "\nFailed to convert file: " << argc[i];
+                ++errors;
+                continue;
+            }
+            std::cout << "\n" << argc[i] << " -> " << cache << " ("
+                      << inx.map_epochs().size() << " maps)";
+        } catch (std::runtime_error& e) {
+            std::cerr << "\nFailed to convert file: " << argc[i]
+                      << " (" << e.what() << ")";
+            ++errors;
+        }
+    }
+
+    std::cout << "\n";
+    return errors ? 1 : 0;
+}
+
+void
+help()
+{
+    std::cout << "\n"
+    "Program inxcache\n"
+    "This program will convert IONEX files to (binary) cache files, holding\n"
+    "the decoded maps in a layout that is memory-mapped and used in place.\n"
+    "Cache files can be used (e.g. by inxtr) wherever IONEX files are\n"
+    "expected. They are not portable across hosts of different byte order.";
+    return;
+}
+
+void
+usage()
+{
+    std::cout << "\n"
+    "Usage:\n"
+    " inxcache IONEX [IONEX ...]\n"
+    "\n"
+    " -h or --help\n"
+    "\tDisplay (this) help message and exit.\n"
+    " IONEX\n"
+    "\tThe IONEX file(s) to convert; each one is written\n"
+    "\tto a cache file of the same name, plus \".bin\".\n";
+    return;
+}
@@ -3,8 +3,12 @@
 #include <cstring>
 #include <algorithm>
 #include <limits>
+#include <cmath>
 #include "datetime_v2.hpp"
 #include "ionex.hpp"
+#include "ionex_collection.hpp"
+#include "ionex_cursor.hpp"
+#include "ionex_diff.hpp"
 
 void help();
 void usage();
@@ -56,18 +60,43 @@ resolve_geo_range(std::string, range<float>&);
 int
 resolve_str_date(std::string, epoch&);
 
+/// The points, epochs and maps to interpolate, as resolved off the command
+/// line arguments.
+struct query {
+    range<float> lat_range;
+    range<float> lon_range;
+    range<epoch> epoch_range;
+    long         time_step; // in seconds
+    std::vector<_point_> points;
+    ngpt::ionex::map_type map_type;
+    std::size_t  level;
+};
+
+std::vector<std::string>
+split_files(const std::string&);
+
+template<typename T>
+int
+resolve_query(const T&, const str_str_map&, query&);
+
+template<typename T>
+int
+dispatch(T&, const std::string&, const str_str_map&);
+
+template<typename T>
+int
+extract(T&, const std::string&, const str_str_map&);
+
+template<typename T, typename U>
+int
+difference(T&, const std::string&, U&, const std::string&,
+           const str_str_map&);
+
 int main(int argv, char* argc[])
 {
     // a dictionary with any default options
     str_str_map arg_dict;
     arg_dict["list" ] = std::string( "N" );
-    arg_dict["diff" ] = std::string( "N" );
-    
-    // axis/epoch limits
-    range<float> lat_range;
-    range<float> lon_range;
-    range<epoch> epoch_range;
-    long time_step; // in seconds
 
     // get cmd arguments into the dictionary
     int status = cmd_parse(argv, argc, arg_dict);
@@ -89,7 +118,63 @@ int main(int argv, char* argc[])
         std::cerr << "\nMust provide name of ionex file.\n";
         return 1;
     }
-    ngpt::ionex inx ( sit->second.c_str() );
+
+    // more than one (comma-seperated) files are handled as a collection.
+    std::vector<std::string> files = split_files( sit->second );
+    if ( files.size() == 1 ) {
+        ngpt::ionex inx ( files[0].c_str() );
+        return dispatch(inx, sit->second, arg_dict);
+    }
+    ngpt::ionex_collection inxs ( files );
+    return dispatch(inxs, sit->second, arg_dict);
+}
+
+// Split a comma-seperated list of files.
+std::vector<std::string>
+split_files(const std::string& str)
+{
+    std::vector<std::string> files;
+    std::string::size_type start = 0, pos;
+    while ( (pos = str.find(',', start)) != std::string::npos ) {
+        files.emplace_back( str.substr(start, pos-start) );
+        start = pos + 1;
+    }
+    files.emplace_back( str.substr(start) );
+    return files;
+}
+
+// Extract TEC values off the (-i) product; or, if a second product is given
+// (-diff), the differences between the two.
+template<typename T>
+int
+dispatch(T& inx, const std::string& inx_name, const str_str_map& arg_dict)
+{
+    auto sit = arg_dict.find("diff");
+    if ( sit == arg_dict.end() ) {
+        return extract(inx, inx_name, arg_dict);
+    }
+    std::vector<std::string> files = split_files( sit->second );
+    if ( files.size() == 1 ) {
+        ngpt::ionex prd ( files[0].c_str() );
+        return difference(inx, inx_name, prd, sit->second, arg_dict);
+    }
+    ngpt::ionex_collection prds ( files );
+    return difference(inx, inx_name, prds, sit->second, arg_dict);
+}
+
+// Resolve the points, epochs and maps to interpolate off an ionex (or
+// ionex_collection) instance, given the (parsed) command line arguments.
+template<typename T>
+int
+resolve_query(const T& inx, const str_str_map& arg_dict, query& q)
+{
+    // axis/epoch limits
+    range<float>& lat_range   = q.lat_range;
+    range<float>& lon_range   = q.lon_range;
+    range<epoch>& epoch_range = q.epoch_range;
+    long& time_step = q.time_step; // in seconds
+
+    auto sit = arg_dict.end();
 
     // set the start date
     if ( (sit = arg_dict.find("start")) == arg_dict.end() ) {
@@ -213,7 +298,8 @@ int main(int argv, char* argc[])
             return 1;
         }
     }
-    std::vector<_point_> points;
+    std::vector<_point_>& points = q.points;
+    points.clear();
     for (float lat = lat_range.from; lat_range.less(lat); lat_range.increment(lat)) {
         for (float lon = lon_range.from; lon_range.less(lon); lon_range.increment(lon)) {
             points.emplace_back( lon, lat );
@@ -225,28 +311,154 @@ int main(int argv, char* argc[])
     std::cout<<"\n[DEBUG] Interpolating for "<< points.size() <<" points";
 #endif
 
-    // let's do this!
-    std::vector<epoch> epochs;
-    int i_time_step (time_step);
-    auto tec_results = inx.interpolate(points, epochs,
-                        &epoch_range.from, &epoch_range.to, i_time_step);
+    // the type of maps to interpolate (default TEC)
+    auto& map_type = q.map_type;
+    map_type = ngpt::ionex::map_type::tec;
+    if ( (sit = arg_dict.find("map")) != arg_dict.end() ) {
+        if ( sit->second == "RMS" ) {
+            map_type = ngpt::ionex::map_type::rms;
+        } else if ( sit->second == "HGT" ) {
+            map_type = ngpt::ionex::map_type::height;
+        } else if ( sit->second != "TEC" ) {
+            std::cerr << "\nERROR. Invalid map type: \"" << sit->second << "\"";
+            std::cerr << " (should be one of TEC, RMS or HGT).\n";
+            return 1;
+        }
+    }
+
+    // the height level (3d maps); default is the first height in the grid.
+    std::size_t& level = q.level;
+    level = 0;
+    if ( (sit = arg_dict.find("hgt")) != arg_dict.end() ) {
+        auto hgrid = inx.height_grid();
+        float hgt;
+        try {
+            hgt = std::stof( sit->second );
+        } catch (std::exception&) {
+            std::cerr << "\nERROR. Failed to resolve height from:";
+            std::cerr << " \"" << sit->second << "\"";
+            return 1;
+        }
+        float dhgt = std::get<2>(hgrid);
+        long  lvl  = dhgt ? std::lround( (hgt-std::get<0>(hgrid)) / dhgt ) : 0;
+        if (   lvl < 0
+            || std::abs(std::get<0>(hgrid) + lvl*dhgt - hgt) > 1e-3 ) {
+            std::cerr << "\nERROR. Height " << hgt << " is not on the grid.\n";
+            return 1;
+        }
+        level = static_cast<std::size_t>( lvl );
+    }
+
+    return 0;
+}
+
+// Extract and report TEC values off from an ionex (or ionex_collection)
+// instance, given the (parsed) command line arguments.
+template<typename T>
+int
+extract(T& inx, const std::string& inx_name, const str_str_map& arg_dict)
+{
+    query q;
+    if ( resolve_query(inx, arg_dict, q) ) { return 1; }
+
+    // let's do this! results are streamed, one epoch at a time.
+    int i_time_step (q.time_step);
+    ngpt::ionex_cursor cursor (inx, q.points, q.epoch_range.from,
+                               q.epoch_range.to, i_time_step, q.map_type,
+                               q.level);
+    std::vector<double> row ( cursor.points() );
 
     // print results
-    std::cout<<"\nINX: " << inx.filename();
-    std::cout<<"\nEPH: " << epoch_range.from.stringify()<<" "<<epoch_range.to.stringify()<<" "<<time_step;
-    std::cout<<"\nLAT: " << lat_range.from<<" "<<lat_range.to<<" "<<lat_range.step;
-    std::cout<<"\nLON: " << lon_range.from<<" "<<lon_range.to<<" "<<lon_range.step;
+    std::cout<<"\nINX: " << inx_name;
+    std::cout<<"\nEPH: " << q.epoch_range.from.stringify()<<" "<<q.epoch_range.to.stringify()<<" "<<q.time_step;
+    std::cout<<"\nLAT: " << q.lat_range.from<<" "<<q.lat_range.to<<" "<<q.lat_range.step;
+    std::cout<<"\nLON: " << q.lon_range.from<<" "<<q.lon_range.to<<" "<<q.lon_range.step;
 
-    std::size_t epoch_index = 0;
-    for (const auto& eph : epochs) {
+    cursor.for_each(row.data(), [&row](const epoch& eph, const double* tec) {
         std::cout << "\n" << eph.stringify() << "\n";
-        for (const auto& p : tec_results) {
-            std::cout << p[epoch_index] << " ";
+        for (std::size_t i=0; i<row.size(); ++i) {
+            std::cout << tec[i] << " ";
         }
-        ++epoch_index;
+        return true;
+    });
+    std::cout<<"\nEOT";
+
+    std::cout<<"\n";
+    return 0;
+}
+
+// Report the differences (product minus reference) between two products, at
+// the points/epochs resolved off the reference; the product is interpolated
+// (regridded) at the reference grid points and epochs. The difference maps
+// are followed by the statistics of all points and of every point.
+template<typename T, typename U>
+int
+difference(T& ref, const std::string& ref_name, U& prd,
+           const std::string& prd_name, const str_str_map& arg_dict)
+{
+    query q;
+    if ( resolve_query(ref, arg_dict, q) ) { return 1; }
+
+    // the epochs (within both products) and the points (on both grids).
+    int i_time_step (q.time_step);
+    std::vector<epoch> epochs = ngpt::ionex_diff::align_epochs(
+        ref.map_epochs(), prd.map_epochs(), q.epoch_range.from,
+        q.epoch_range.to, i_time_step);
+    if ( epochs.empty() ) {
+        std::cerr << "\nERROR. The products have no common epochs.\n";
+        return 1;
     }
+    auto covers = [](const std::tuple<float,float,float>& g, float x) {
+        float lo = std::min(std::get<0>(g), std::get<1>(g));
+        float hi = std::max(std::get<0>(g), std::get<1>(g));
+        return x >= lo - 1e-4f && x <= hi + 1e-4f;
+    };
+    auto plat = prd.latitude_grid();
+    auto plon = prd.longtitude_grid();
+    std::vector<_point_> points;
+    for (const auto& p : q.points) {
+        if ( covers(plat, p.second) && covers(plon, p.first) ) {
+            points.push_back( p );
+        }
+    }
+    if ( points.empty() ) {
+        std::cerr << "\nERROR. The products have no common grid points.\n";
+        return 1;
+    }
+
+    ngpt::ionex_cursor rcursor (ref, points, epochs, q.map_type, q.level);
+    ngpt::ionex_cursor pcursor (prd, points, epochs, q.map_type, q.level);
+    ngpt::ionex_diff diff (rcursor, pcursor);
+    std::vector<double> row ( diff.points() );
+
+    // print results
+    std::cout<<"\nINX: " << ref_name;
+    std::cout<<"\nDIF: " << prd_name;
+    std::cout<<"\nEPH: " << epochs.front().stringify()<<" "<<epochs.back().stringify()<<" "<<q.time_step;
+    std::cout<<"\nPTS: " << points.size();
+
+    diff.for_each(row.data(), [&row](const epoch& eph, const double* d) {
+        std::cout << "\n" << eph.stringify() << "\n";
+        for (std::size_t i=0; i<row.size(); ++i) {
+            std::cout << d[i] << " ";
+        }
+        return true;
+    });
     std::cout<<"\nEOT";
 
+    // statistics; count, mean, std. deviation, rms, min and max
+    auto report = [](const ngpt::running_stats& s) {
+        std::cout << s.count() << " " << s.mean() << " " << s.stddev() << " "
+                  << s.rms() << " " << s.min() << " " << s.max();
+    };
+    std::cout<<"\nSTS: ";
+    report( diff.total() );
+    for (std::size_t i=0; i<points.size(); ++i) {
+        std::cout << "\n" << points[i].first << " " << points[i].second << " ";
+        report( diff.cells()[i] );
+    }
+    std::cout<<"\nEOS";
+
     std::cout<<"\n";
     return 0;
 }
@@ -317,7 +529,9 @@ cmd_parse(int argv, char* argc[], str_str_map& smap)
         } 
         else if ( !std::strcmp(argc[i], "-diff") )
         {
-            smap["diff"] = std::string("Y");
+            if ( i+1 >= argv ) { return 1; }
+            smap["diff"] = std::string( argc[i+1] );
+            ++i;
         }
         else if ( !std::strcmp(argc[i], "-i") )
         {
@@ -367,6 +581,18 @@ cmd_parse(int argv, char* argc[], str_str_map& smap)
             smap["dlon"] = std::string( argc[i+1] );
             ++i;
         }
+        else if ( !std::strcmp(argc[i], "-map") )
+        {
+            if ( i+1 >= argv ) { return 1; }
+            smap["map"] = std::string( argc[i+1] );
+            ++i;
+        }
+        else if ( !std::strcmp(argc[i], "-hgt") )
+        {
+            if ( i+1 >= argv ) { return 1; }
+            smap["hgt"] = std::string( argc[i+1] );
+            ++i;
+        }
         else
         {
             std::cerr << "\nIrrelevant cmd: " << argc[i];
@@ -449,7 +675,9 @@ usage()
     " -h or --help\n"
     "\tDisplay (this) help message and exit.\n"
     " -i [IONEX]\n"
-    "\tSpecify the input IONEX file.\n"
+    "\tSpecify the input IONEX file. Any number of (e.g. daily)\n"
+    "\tfiles can be given as a comma-seperated list; they are\n"
+    "\tloaded in parallel and treated as one time series.\n"
     " -start [YYYY/MM/DDTHH:MM:SS] or [HH:MM:SS]\n"
     "\tSpecify the first epoch to interpolate. In case only\n"
     "\ta time argument is provided (i.e. \"HH:MM:SS\") it is\n"
@@ -485,7 +713,23 @@ usage()
     " -dlon [LONGTITUDE STEP]\n"
     "\tSpecify the longtitude step in decimal degrees (the\n"
     "\tmax precission is two decimal places). This will\n"
-    "\toverride the value of \"-lon\" argument (if provided).\n";
+    "\toverride the value of \"-lon\" argument (if provided).\n"
+    " -map [TEC|RMS|HGT]\n"
+    "\tThe type of maps to interpolate; default is TEC. The\n"
+    "\tfile(s) must hold maps of the given type.\n"
+    " -hgt [HEIGHT]\n"
+    "\tFor 3d maps, the height (km) of the maps to interpolate;\n"
+    "\tit must be on the height grid. If not provided, it is\n"
+    "\tset to the first height in the IONEX file.\n"
+    " -diff [IONEX]\n"
+    "\tReport the differences of this product (file, or\n"
+    "\tcomma-seperated list of files) minus the one given\n"
+    "\tvia \"-i\", instead of the TEC values. The product is\n"
+    "\tinterpolated at the grid points (within both grids)\n"
+    "\tand epochs (within both products) of the \"-i\" one;\n"
+    "\tthe difference maps are followed by the statistics\n"
+    "\t(count, mean, std. deviation, rms, min and max) of\n"
+    "\tall points (\"STS:\") and of every point.\n";
 
     std ::cout << "Example usage:\n";
     return;
@@ -0,0 +1,487 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <streambuf>
+#include <type_traits>
+#ifdef DEBUG
+    #include <iostream>
+#endif
+#include "antenna_database.hpp"
+#include "binfmt.hpp"
+#include "infile.hpp"
+#include "mmfile.hpp"
+#include "parallel.hpp"
+#include "satsys.hpp"
+
+using ngpt::antenna_database;
+
+namespace
+{
+/// Column of the record labels in ANTEX files.
+constexpr std::size_t LABEL_COLUMN { 60 };
+
+/// Chars of model+radome+serial in a "TYPE / SERIAL NO" record.
+constexpr std::size_t NAME_CHARS
+{   ngpt::antenna_details::antenna_model_max_chars + 1
+  + ngpt::antenna_details::antenna_radome_max_chars
+  + ngpt::antenna_details::antenna_serial_max_chars };
+
+/// First bytes of a binary (ANTEX) snapshot file.
+constexpr char ATX_SNAPSHOT_MAGIC[8] { 'N', 'G', 'P', 'T', 'A', 'T', 'X', 'S' };
+
+/// Version of the binary snapshot layout; bump on any change.
+constexpr std::uint32_t ATX_SNAPSHOT_VERSION { 2 };
+
+/// Sections of a binary snapshot file start at multiples of this (bytes).
+constexpr std::size_t ATX_SNAPSHOT_ALIGN { 64 };
+
+static_assert(std::is_same<ngpt::pcv_type, float>::value,
+              "Snapshot pcv values are stored as float");
+
+typedef ngpt::antex::datetime_ms datetime_ms;
+
+/// The header of a binary (ANTEX) snapshot file. The file layout is: header,
+/// antenna records, frequency records and the pcv values (NOAZI then AZI, of
+/// every frequency of every antenna) as one float array, each section at an
+/// offset aligned to ATX_SNAPSHOT_ALIGN bytes. All values are stored in the
+/// byte order of the host that wrote the file.
+struct atx_snapshot_header
+{
+    char          magic[8];           ///< ATX_SNAPSHOT_MAGIC
+    std::uint32_t version;            ///< ATX_SNAPSHOT_VERSION
+    std::uint32_t byte_order;         ///< 0x01020304, as written
+    std::uint64_t antennas;           ///< Number of antennas
+    std::uint64_t frequencies;        ///< Number of frequency patterns
+    std::uint64_t values;             ///< Number of pcv values
+    std::uint64_t antennas_offset;    ///< Offset of the antenna records
+    std::uint64_t frequencies_offset; ///< Offset of the frequency records
+    std::uint64_t values_offset;      ///< Offset of the pcv values
+    std::uint64_t file_size;          ///< Size of the whole file (bytes)
+    std::uint64_t checksum;           ///< FNV-1a of the whole file, with
+                                      ///< this field zeroed
+};
+
+/// An antenna record of a binary snapshot.
+struct atx_snapshot_antenna
+{
+    char          type[LABEL_COLUMN]; ///< The "TYPE / SERIAL NO" record
+    std::uint32_t freqs;              ///< Number of frequencies
+    std::int64_t  valid_from[2];      ///< MJD, millisec
+    std::int64_t  valid_until[2];     ///< MJD, millisec
+    float         zen[3];             ///< ZEN1, ZEN2, DZEN
+    float         dazi;               ///< DAZI
+    std::uint64_t first_freq;         ///< Index of its first frequency record
+};
+
+/// A frequency record of a binary snapshot.
+struct atx_snapshot_frequency
+{
+    char          satsys;      ///< Satellite system identifier
+    char          reserved;
+    std::int16_t  band;        ///< Frequency band
+    float         neu[3];      ///< North, east, up offsets
+    std::uint32_t no_azi;      ///< Number of NOAZI values
+    std::uint32_t azi;         ///< Number of AZI values (following the NOAZI)
+    std::uint64_t first_value; ///< Index of its first (NOAZI) value
+};
+
+/// A read-only stream buffer over a block of memory it does not own.
+class view_buf : public std::streambuf
+{
+public:
+    view_buf(const char* begin, const char* end) noexcept
+    {
+        char* b = const_cast<char*>(begin);
+        this->setg(b, b, b + (end - begin));
+    }
+};
+
+/// An antenna block, i.e. the range of its record lines, from
+/// 'METH / BY / # / DATE' up to (and including) 'END OF ANTENNA'.
+struct block
+{
+    const char* begin;
+    const char* end;
+};
+
+/// Does the line [begin, end) carry the given label ?
+inline bool
+_has_label_(const char* begin, const char* end, const char* label) noexcept
+{
+    const std::size_t n = std::strlen(label);
+    return end - begin >= static_cast<std::ptrdiff_t>(LABEL_COLUMN + n)
+        && !std::memcmp(begin + LABEL_COLUMN, label, n);
+}
+
+/// [Help function] 64-bit FNV-1a hash of a block of memory; continues off h
+/// (i.e. the hash of any previous blocks), if given.
+std::uint64_t
+_checksum_(const char* data, std::size_t size,
+           std::uint64_t h = 14695981039346656037ULL) noexcept
+{
+    for (std::size_t i=0; i<size; ++i) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+}
+
+/**
+ *  \details A snapshot file is mapped (see load_snapshot()). For ANTEX files,
+ *           plain files are mapped (see mapped_file) and compressed files are
+ *           decompressed into memory (see input_file); the contents are only
+ *           held while the instance is being constructed.
+ */
+antenna_database::antenna_database(const char* filename, unsigned threads)
+    : _filename(filename),
+      _snapshot(false)
+{
+    // a binary snapshot ?
+    {
+        char magic[sizeof(ATX_SNAPSHOT_MAGIC)] = {};
+        std::ifstream fin ( filename, std::ios::in | std::ios::binary );
+        fin.read(magic, sizeof(magic));
+        _snapshot = fin.gcount() == sizeof(magic)
+                 && !std::memcmp(magic, ATX_SNAPSHOT_MAGIC, sizeof(magic));
+    }
+    if ( _snapshot ) {
+        this->load_snapshot(threads);
+        this->build_index();
+        return;
+    }
+
+    std::unique_ptr<mapped_file> mapped;
+    std::unique_ptr<input_file>  decompressed;
+    const char* data;
+    std::size_t size;
+    if ( ngpt::detect_compression(filename) == compression::none ) {
+        mapped.reset( new mapped_file(filename) );
+        data = mapped->data();
+        size = mapped->size();
+    } else {
+        decompressed.reset( new input_file(filename) );
+        if ( !decompressed->is_open() ) {
+            throw std::runtime_error
+                ("antenna_database::antenna_database() -> Cannot read file "
+                 + _filename);
+        }
+        data = decompressed->data();
+        size = decompressed->size();
+    }
+    if ( !data ) {
+        throw std::runtime_error
+            ("antenna_database::antenna_database() -> Empty file "
+             + _filename);
+    }
+
+    this->load_antex(data, size, threads);
+    this->build_index();
+}
+
+/**
+ *  \details The antenna blocks are located (with their "TYPE / SERIAL NO"
+ *           and VALID FROM / VALID UNTIL records) in one pass and then parsed
+ *           concurrently, each off its own stream over its lines.
+ */
+void
+antenna_database::load_antex(const char* data, std::size_t size,
+                             unsigned threads)
+{
+    const char* const last = data + size;
+    auto next_line = [last](const char* p) {
+        const char* nl = static_cast<const char*>(
+            std::memchr(p, '\n', static_cast<std::size_t>(last - p)) );
+        return nl ? nl + 1 : last;
+    };
+
+    std::vector<block> blocks;
+    const char* p = data;
+    bool in_header = true;
+    while ( p < last ) {
+        const char* eol = next_line(p);
+        if ( in_header ) {
+            in_header = !_has_label_(p, eol, "END OF HEADER");
+        } else if ( _has_label_(p, eol, "START OF ANTENNA") ) {
+            // next record is the 'TYPE / SERIAL NO'
+            const char* type = eol;
+            eol = next_line(type);
+            if ( !_has_label_(type, eol, "TYPE / SERIAL NO") ) {
+                throw std::runtime_error
+                    ("antenna_database::load_antex() -> "
+                     "'TYPE / SERIAL NO' expected.");
+            }
+            record r { std::string(type, LABEL_COLUMN), datetime_ms(),
+                satellite_antenna_index<std::size_t>::end_of_time() };
+            block  b { eol, nullptr };
+            while ( eol < last && !_has_label_(p, eol, "END OF ANTENNA") ) {
+                p   = eol;
+                eol = next_line(p);
+                const bool from = _has_label_(p, eol, "VALID FROM");
+                if (   ( from || _has_label_(p, eol, "VALID UNTIL") )
+                    && antex::read_epoch(std::string(p, eol - p).c_str(),
+                                         from ? r.from : r.until) ) {
+                    throw std::runtime_error
+                        ("antenna_database::load_antex() -> "
+                         "Invalid validity epoch.");
+                }
+            }
+            if ( !_has_label_(p, eol, "END OF ANTENNA") ) {
+                throw std::runtime_error
+                    ("antenna_database::load_antex() -> "
+                     "'END OF ANTENNA' expected.");
+            }
+            b.end = eol;
+            _records.emplace_back( std::move(r) );
+            blocks.push_back( b );
+        }
+        p = eol;
+    }
+    if ( in_header ) {
+        throw std::runtime_error
+            ("antenna_database::load_antex() -> 'END OF HEADER' not found.");
+    }
+
+    // parse all blocks, each off its own stream.
+    _patterns.resize( blocks.size() );
+    ngpt::parallel_for(blocks.size(), [&](std::size_t i) {
+        view_buf     buf ( blocks[i].begin, blocks[i].end );
+        std::istream fin ( &buf );
+        _patterns[i] = std::make_shared<const antenna_pcv<pcv_type>>(
+                           antex::read_pattern(fin) );
+    }, threads);
+}
+
+/**
+ *  \details The file (header included) is validated against its checksum,
+ *           and the layout against the file size, before anything is read off
+ *           it; counts are bounded by division, so that no (wrapped around)
+ *           size can pass. Every antenna/frequency record is checked against
+ *           the counts and its grid before use, so no access can go past the
+ *           mapping. The patterns are then built (concurrently) off the
+ *           records, copying the pcv values off the mapped arrays.
+ */
+void
+antenna_database::load_snapshot(unsigned threads)
+{
+    const mapped_file mfile ( _filename.c_str() );
+    const char* data = mfile.data();
+
+    atx_snapshot_header hdr;
+    bool ok = mfile.size() >= sizeof(hdr);
+    if ( ok ) {
+        std::memcpy(&hdr, data, sizeof(hdr));
+        // the checksum covers the header too (with the checksum zeroed).
+        atx_snapshot_header zhdr { hdr };
+        zhdr.checksum = 0;
+        const std::uint64_t checksum = _checksum_(
+            data + sizeof(hdr), mfile.size() - sizeof(hdr),
+            _checksum_(reinterpret_cast<const char*>(&zhdr), sizeof(zhdr)) );
+        // count records of size bytes fit at offset (no overflow).
+        auto fits = [&hdr](std::uint64_t offset, std::uint64_t count,
+                           std::uint64_t bytes) {
+            return offset % ATX_SNAPSHOT_ALIGN == 0
+                && offset >= sizeof(hdr)
+                && offset <= hdr.file_size
+                && count <= (hdr.file_size - offset) / bytes;
+        };
+        ok =  hdr.version    == ATX_SNAPSHOT_VERSION
+           && hdr.byte_order == 0x01020304
+           && hdr.file_size  == mfile.size()
+           && hdr.checksum   == checksum
+           && fits(hdr.antennas_offset, hdr.antennas,
+                   sizeof(atx_snapshot_antenna))
+           && fits(hdr.frequencies_offset, hdr.frequencies,
+                   sizeof(atx_snapshot_frequency))
+           && fits(hdr.values_offset, hdr.values, sizeof(float));
+    }
+    if ( !ok ) {
+#ifdef DEBUG
+        std::cerr<<"\n[DEBUG] Invalid (or corrupted) snapshot file "<<_filename;
+#endif
+        throw std::runtime_error
+            ("antenna_database::load_snapshot() -> Invalid snapshot file.");
+    }
+
+    const std::size_t nants = hdr.antennas;
+    _records.resize( nants );
+    _patterns.resize( nants );
+    ngpt::parallel_for(nants, [&](std::size_t i) {
+        atx_snapshot_antenna a;
+        std::memcpy(&a, data + hdr.antennas_offset + i*sizeof(a), sizeof(a));
+        // the grids can not have more nodes than there are values.
+        const double nvals = static_cast<double>( hdr.values );
+        if (   !(a.zen[2] > 0e0) || !(a.zen[1] >= a.zen[0])
+            || !((a.zen[1] - a.zen[0]) / a.zen[2] < nvals)
+            || !(a.dazi >= 0e0)
+            || ( a.dazi > 0e0 && !(360e0 / a.dazi < nvals) )
+            || a.first_freq > hdr.frequencies
+            || a.freqs > hdr.frequencies - a.first_freq ) {
+            throw std::runtime_error
+                ("antenna_database::load_snapshot() -> Invalid antenna record.");
+        }
+        _records[i] = record { std::string(a.type, LABEL_COLUMN),
+                               binfmt_details::join_epoch(a.valid_from),
+                               binfmt_details::join_epoch(a.valid_until) };
+
+        antenna_pcv<pcv_type> pcv ( a.zen[0], a.zen[1], a.zen[2],
+                                    static_cast<int>(a.freqs), a.dazi );
+        // NOAZI values per frequency (as in pcv.no_azi_grid_pts(), which
+        // requires the values to be already set).
+        const std::size_t no_azi_pts =
+            grid_skeleton<pcv_type, false, Grid_Dimension::OneDim>
+                (a.zen[0], a.zen[1], a.zen[2]).size();
+        const float* values = reinterpret_cast<const float*>
+                              (data + hdr.values_offset);
+        for (std::size_t j=0; j<a.freqs; ++j) {
+            atx_snapshot_frequency f;
+            std::memcpy(&f, data + hdr.frequencies_offset
+                              + (a.first_freq + j)*sizeof(f), sizeof(f));
+            if (   f.first_value > hdr.values
+                || f.no_azi > hdr.values - f.first_value
+                || f.azi > hdr.values - f.first_value - f.no_azi
+                || f.no_azi != no_azi_pts
+                || f.azi != pcv.azi_grid_pts() ) {
+                throw std::runtime_error
+                    ("antenna_database::load_snapshot() -> "
+                     "Invalid frequency record.");
+            }
+            frequency_pcv<pcv_type>& fp = pcv.freq_pcv_pattern(j);
+            fp.type() = observation_type(ngpt::char_to_satsys(f.satsys),
+                                         observable_type::carrier_phase,
+                                         f.band, '?');
+            fp.north() = f.neu[0];
+            fp.east()  = f.neu[1];
+            fp.up()    = f.neu[2];
+            const float* v = values + f.first_value;
+            fp.no_azi_vector().assign(v, v + f.no_azi);
+            fp.azi_vector().assign(v + f.no_azi, v + f.no_azi + f.azi);
+        }
+        _patterns[i] = std::make_shared<const antenna_pcv<pcv_type>>(
+                           std::move(pcv) );
+    }, threads);
+}
+
+void
+antenna_database::build_index()
+{
+    _antennas.clear();
+    _index.clear();
+    _satellites.clear();
+    _antennas.reserve( _records.size() );
+    _index.reserve( _records.size() );
+    for (std::size_t i=0; i<_records.size(); ++i) {
+        const std::string name { _records[i].type.substr(0, NAME_CHARS) };
+        _antennas.emplace_back();
+        _antennas.back() = name;
+        _index.emplace( name, i );
+        _satellites.add( _records[i].type, _records[i].from,
+                         _records[i].until, i );
+    }
+    _satellites.sort();
+}
+
+/** Write the database to a binary snapshot file, i.e. the antenna records
+ *  (with their validity), the grids, offsets and pcv values of all patterns,
+ *  in a layout that can be memory-mapped (see atx_snapshot_header) and
+ *  validated by its checksum. A database constructed off the snapshot holds
+ *  exactly the same antennas and patterns as this instance.
+ *
+ *  \returns An integer denoting the exit status; anything other than 0
+ *           denotes failure.
+ */
+int
+antenna_database::write_snapshot(const char* filename)
+const
+{
+    std::vector<atx_snapshot_antenna>   ants ( _records.size() );
+    std::vector<atx_snapshot_frequency> freqs;
+    std::vector<float>                  values;
+
+    for (std::size_t i=0; i<_records.size(); ++i) {
+        const antenna_pcv<pcv_type>& pcv = *_patterns[i];
+        atx_snapshot_antenna& a = ants[i];
+        std::memset(&a, 0, sizeof(a));
+        std::memset(a.type, ' ', sizeof(a.type));
+        std::memcpy(a.type, _records[i].type.data(),
+                    std::min(_records[i].type.size(), sizeof(a.type)));
+        a.freqs = static_cast<std::uint32_t>( pcv.frequencies() );
+        binfmt_details::split_epoch(_records[i].from,  a.valid_from);
+        binfmt_details::split_epoch(_records[i].until, a.valid_until);
+        a.zen[0] = pcv.zen1(); a.zen[1] = pcv.zen2(); a.zen[2] = pcv.dzen();
+        a.dazi   = pcv.has_azi_pcv() ? pcv.dazi() : 0e0;
+        a.first_freq = freqs.size();
+
+        for (std::size_t j=0; j<pcv.frequencies(); ++j) {
+            const frequency_pcv<pcv_type>& fp = pcv.freq_pcv_pattern(j);
+            atx_snapshot_frequency f;
+            std::memset(&f, 0, sizeof(f));
+            f.satsys = ngpt::satsys_identifier( fp.type().raw_obs(0).satsys() );
+            f.band   = fp.type().raw_obs(0).band();
+            f.neu[0] = fp.north(); f.neu[1] = fp.east(); f.neu[2] = fp.up();
+            f.no_azi = static_cast<std::uint32_t>( fp.no_azi_size() );
+            f.azi    = static_cast<std::uint32_t>( fp.azi_size() );
+            f.first_value = values.size();
+            values.insert(values.end(), fp.no_azi_vector_c().cbegin(),
+                          fp.no_azi_vector_c().cend());
+            values.insert(values.end(), fp.azi_vector_c().cbegin(),
+                          fp.azi_vector_c().cend());
+            freqs.push_back( f );
+        }
+    }
+
+    atx_snapshot_header hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic, ATX_SNAPSHOT_MAGIC, sizeof(hdr.magic));
+    hdr.version     = ATX_SNAPSHOT_VERSION;
+    hdr.byte_order  = 0x01020304;
+    hdr.antennas    = ants.size();
+    hdr.frequencies = freqs.size();
+    hdr.values      = values.size();
+    using binfmt_details::align;
+    hdr.antennas_offset    = align( sizeof(hdr), ATX_SNAPSHOT_ALIGN );
+    hdr.frequencies_offset = align( hdr.antennas_offset
+                                  + ants.size() * sizeof(ants[0]),
+                                    ATX_SNAPSHOT_ALIGN );
+    hdr.values_offset      = align( hdr.frequencies_offset
+                                  + freqs.size() * sizeof(freqs[0]),
+                                    ATX_SNAPSHOT_ALIGN );
+    hdr.file_size          = hdr.values_offset + values.size() * sizeof(float);
+
+    // the whole file, in memory (for the checksum)
+    std::vector<char> buf ( hdr.file_size, 0 );
+    std::memcpy(buf.data() + hdr.antennas_offset, ants.data(),
+                ants.size() * sizeof(ants[0]));
+    std::memcpy(buf.data() + hdr.frequencies_offset, freqs.data(),
+                freqs.size() * sizeof(freqs[0]));
+    std::memcpy(buf.data() + hdr.values_offset, values.data(),
+                values.size() * sizeof(float));
+    std::memcpy(buf.data(), &hdr, sizeof(hdr));
+    hdr.checksum = _checksum_(buf.data(), buf.size());
+    std::memcpy(buf.data(), &hdr, sizeof(hdr));
+
+    std::ofstream fout ( filename, std::ios::out | std::ios::binary
+                                   | std::ios::trunc );
+    if ( !fout.is_open() ) { return 1; }
+    fout.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+    return fout.good() ? 0 : 1;
+}
+
+antenna_database::pcv_handle
+antenna_database::find(const antenna& ant)
+const
+{
+    const auto it = ngpt::find_antenna_record(_index, ant);
+    return it == _index.cend() ? nullptr : _patterns[it->second];
+}
+
+antenna_database::pcv_handle
+antenna_database::find_satellite(const std::string& sat, const datetime_ms& t)
+const
+{
+    const std::size_t* i = _satellites.find(sat, t);
+    return i ? _patterns[*i] : nullptr;
+}
@@ -0,0 +1,143 @@
+#ifndef __NGPT_ANTENNA_DATABASE_HPP__
+#define __NGPT_ANTENNA_DATABASE_HPP__
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "antenna.hpp"
+#include "antex.hpp"
+#include "satellite_antenna_index.hpp"
+
+/**
+ * \file
+ *
+ * \version
+ *
+ * \author    xanthos@mail.ntua.gr <br>
+ *            danast@mail.ntua.gr
+ *
+ * \date
+ *
+ * \brief     All antenna calibrations of an ANTEX file, loaded (in parallel)
+ *            into an immutable, in-memory database.
+ *
+ * \copyright Copyright © 2015 Dionysos Satellite Observatory, <br>
+ *            National Technical University of Athens. <br>
+ *            This work is free. You can redistribute it and/or modify it under
+ *            the terms of the Do What The Fuck You Want To Public License,
+ *            Version 2, as published by Sam Hocevar. See http://www.wtfpl.net/
+ *            for more details.
+ *
+ * <b><center><hr>
+ * National Technical University of Athens <br>
+ *      Dionysos Satellite Observatory     <br>
+ *        Higher Geodesy Laboratory        <br>
+ *      http://dionysos.survey.ntua.gr
+ * <hr></center></b>
+ *
+ */
+
+namespace ngpt
+{
+
+/*
+ * \class   antenna_database
+ *
+ * \details The calibration patterns of all antennas of an ANTEX file. The
+ *          (whole) file is brought into memory once (mapped, or decompressed
+ *          if compressed; see input_file), the antenna blocks are located in
+ *          one pass and then parsed concurrently, each off its own in-memory
+ *          stream (see antex::read_pattern(std::istream&)); no stream is
+ *          shared. The instance is read-only after construction, hence safe
+ *          to query from any number of threads.
+ *
+ *          Antennas are found as in antex::find_antenna(), i.e. by the exact
+ *          model+radome+serial, or else the generic antenna (blank serial);
+ *          satellite antennas also by PRN/SVN and epoch, as in
+ *          antex::find_satellite_antenna().
+ *
+ *          The database can be written to a binary snapshot file (see
+ *          write_snapshot()), holding the antenna records, the grids and the
+ *          pcv values of all patterns as contiguous float arrays; a database
+ *          constructed off the snapshot (detected off its first bytes) maps
+ *          it, validates it against its checksum and builds the patterns
+ *          straight off the arrays, with no text parsing.
+ *
+ * \throw   The constructor throws std::runtime_error if the file cannot be
+ *          read, any antenna block cannot be parsed, or a snapshot is invalid
+ *          (or corrupted).
+ */
+class antenna_database
+{
+public:
+    /// Shared, immutable handle to an antenna calibration pattern.
+    typedef antex::pcv_handle pcv_handle;
+
+    /// Constructor from an ANTEX filename or a binary snapshot (see
+    /// write_snapshot()); threads is the max number of threads to build the
+    /// patterns on (0 means one per hardware thread).
+    explicit antenna_database(const char* filename, unsigned threads = 0);
+
+    /// Is the instance constructed off a binary snapshot ?
+    bool is_snapshot() const noexcept { return _snapshot; }
+
+    /// Write the database to a binary snapshot file; returns 0 on success.
+    int write_snapshot(const char*) const;
+
+    /// The name of the ANTEX file.
+    std::string filename() const noexcept { return _filename; }
+
+    /// Number of antennas.
+    std::size_t size() const noexcept { return _antennas.size(); }
+
+    /// The i-th antenna (as recorded in the file, i.e. including the serial).
+    const antenna& antenna_at(std::size_t i) const noexcept
+    { return _antennas[i]; }
+
+    /// The calibration pattern of the i-th antenna.
+    pcv_handle pattern_at(std::size_t i) const noexcept
+    { return _patterns[i]; }
+
+    /// The calibration pattern of an antenna; nullptr if not found.
+    pcv_handle find(const antenna&) const;
+
+    /// Epochs (e.g. of VALID FROM / VALID UNTIL records).
+    typedef antex::datetime_ms datetime_ms;
+
+    /// The calibration pattern of a satellite, by PRN (e.g. "G01") or SVN
+    /// (e.g. "G063"), valid at the given epoch; nullptr if not found.
+    pcv_handle find_satellite(const std::string&, const datetime_ms&) const;
+
+private:
+    /// The "TYPE / SERIAL NO" record and validity interval of an antenna.
+    struct record
+    {
+        std::string type;
+        datetime_ms from;
+        datetime_ms until;
+    };
+
+    /// Locate and parse (concurrently) all antenna blocks of ANTEX contents.
+    void load_antex(const char* data, std::size_t size, unsigned threads);
+
+    /// Map, validate and load a binary snapshot file.
+    void load_snapshot(unsigned threads);
+
+    /// Set the antennas and (re)build the indexes off the records.
+    void build_index();
+
+    std::string             _filename; ///< The name of the ANTEX file.
+    bool                    _snapshot; ///< Constructed off a snapshot ?
+    std::vector<record>     _records;  ///< Records, in file order.
+    std::vector<antenna>    _antennas; ///< Antennas, in file order.
+    std::vector<pcv_handle> _patterns; ///< Pattern of every antenna.
+    std::unordered_map<std::string, std::size_t> _index; ///< Index (in
+    ///< _antennas) of every antenna, keyed by model+radome+serial.
+    satellite_antenna_index<std::size_t> _satellites; ///< Index (in
+    ///< _antennas) of every satellite antenna, by PRN/SVN and validity.
+
+}; // end antenna_database
+
+} // end ngpt
+
+#endif
@@ -75,7 +75,11 @@ antex::antex(const char* filename)
       _version    {ngpt::antex::ATX_VERSION::v14},
       _type       {ngpt::antex::PCV_TYPE::Absolute},
       _refant     {},
-      _end_of_head{0}
+      _end_of_head{0},
+      _index      {},
+      _satellites {},
+      _indexed    {false},
+      _cache      {}
 {
     if ( !_istream.is_open() ) {
         throw std::runtime_error{
@@ -226,6 +230,19 @@ antex::read_header()
  */
 ngpt::antenna_pcv<ngpt::pcv_type> 
 ngpt::antex::read_pattern()
+{ return antex::read_pattern(_istream); }
+
+/**
+ *  \details Read an antenna calibration info block off any input stream,
+ *           positioned at the begining of a 'METH / BY / # / DATE' field
+ *           (see read_pattern()). The function only uses the stream it is
+ *           handed, so blocks can be read concurrently off different
+ *           streams.
+ *
+ *  \throw   std::runtime_error if the block cannot be read.
+ */
+ngpt::antenna_pcv<ngpt::pcv_type> 
+ngpt::antex::read_pattern(std::istream& fin)
 {
     using ngpt::pcv_type;
 
@@ -233,7 +250,7 @@ ngpt::antex::read_pattern()
 
     // next field is 'METH / BY / # / DATE'
     char clbr[20];
-    if (_istream.getline(line, MAX_HEADER_CHARS)
+    if (fin.getline(line, MAX_HEADER_CHARS)
         && !strncmp(line+60, "METH / BY / # / DATE", 20))
     {
         std::memcpy(clbr, line, 20);
@@ -241,7 +258,7 @@ ngpt::antex::read_pattern()
 
     // next field is 'DAZI'
     pcv_type dazi {-1000};
-    if (_istream.getline(line, MAX_HEADER_CHARS)
+    if (fin.getline(line, MAX_HEADER_CHARS)
         && !strncmp(line+60, "DAZI", 4)) 
     {
         dazi = std::stof(line+2, nullptr);
@@ -250,7 +267,7 @@ ngpt::antex::read_pattern()
     // next field is 'ZEN1 / ZEN2 / DZEN'
     pcv_type zen1,  zen2,  dzen;
     zen1 = zen2 = dzen = -1000;
-    if (_istream.getline(line, MAX_HEADER_CHARS)
+    if (fin.getline(line, MAX_HEADER_CHARS)
         && !strncmp(line+60, "ZEN1 / ZEN2 / DZEN", 18))
     {
         // TODO is this always correct ?
@@ -263,7 +280,7 @@ ngpt::antex::read_pattern()
 
     // next field is '# OF FREQUENCIES'
     int num_of_freqs {0};
-    if (_istream.getline(line, MAX_HEADER_CHARS)
+    if (fin.getline(line, MAX_HEADER_CHARS)
         && !strncmp(line+60, "# OF FREQUENCIES", 16))
     {
         // TODO is this ALWAYS correct ?
@@ -288,7 +305,7 @@ ngpt::antex::read_pattern()
 
     // From here up untill the block 'START OF FREQUENCY' there can be a number
     // of optional fields.
-    while ( _istream.getline(line, MAX_HEADER_CHARS)
+    while ( fin.getline(line, MAX_HEADER_CHARS)
           && strncmp(line+60, "START OF FREQUENCY", 18) )
     {
 #ifdef DEBUG
@@ -296,7 +313,7 @@ ngpt::antex::read_pattern()
 #endif
     }
     // make sure we're not at EOF or anything funny happened ...
-    if ( !_istream.good() ) {
+    if ( !fin.good() ) {
         throw std::runtime_error
         ("antex::read_pattern -> Could not find 'START OF FREQUENCY'.");
     }
@@ -328,7 +345,7 @@ ngpt::antex::read_pattern()
         freq_pcv_ptr->type() = ot;
 
         // next field is 'NORTH / EAST / UP'
-        if (_istream.getline(line, MAX_HEADER_CHARS) 
+        if (fin.getline(line, MAX_HEADER_CHARS) 
             && !strncmp(line+60, "NORTH / EAST / UP", 17))
         {
             tmp[10] = '\0';
@@ -342,7 +359,7 @@ ngpt::antex::read_pattern()
 
         // read 'NOAZI' grid values
         std::vector<ngpt::pcv_type>* nav = &freq_pcv_ptr->no_azi_vector();
-        if (_istream.getline(g_line, MAX_GRID_CHARS)
+        if (fin.getline(g_line, MAX_GRID_CHARS)
             && !strncmp(g_line, "   NOAZI", 8)) {
             char* lptr  = g_line + 8;
             char ntc    = '\0';
@@ -366,7 +383,7 @@ ngpt::antex::read_pattern()
         std::size_t azi_grid_pts = antpat.azi_grid_pts();
         if ( dazi != 0 ) {
             for (int j=0; j<num_of_azi_lines; ++j) {
-                if ( !_istream.getline(g_line, MAX_GRID_CHARS) ) {
+                if ( !fin.getline(g_line, MAX_GRID_CHARS) ) {
                     throw std::runtime_error
                     ("antex::read_pattern -> Failed to read 'AZI' grid (1).");
                 }
@@ -410,9 +427,9 @@ ngpt::antex::read_pattern()
 
         // should now see the 'END OF FREQUENCY' marker
         // since we're here, also read the next line ...
-        if (   !_istream.getline(line, MAX_HEADER_CHARS)
+        if (   !fin.getline(line, MAX_HEADER_CHARS)
             || strncmp(line+60, "END OF FREQUENCY", 16) 
-            || !_istream.getline(line, MAX_HEADER_CHARS) ) {
+            || !fin.getline(line, MAX_HEADER_CHARS) ) {
             throw  std::runtime_error
             ("antex::read_pattern -> Error reading frequency pcv.");
         }
@@ -437,10 +454,10 @@ ngpt::antex::read_pattern()
  *  \todo    Need to also read 'FREQ RMS'
  */ 
 int
-__skip_rest_of_antenna__(std::ifstream& fin)
+__skip_rest_of_antenna__(std::istream& fin)
 {
-    static char line     [MAX_HEADER_CHARS];
-    static char grid_line[MAX_GRID_CHARS];
+    char line     [MAX_HEADER_CHARS];
+    char grid_line[MAX_GRID_CHARS];
 
     // next field is 'METH / BY / # / DATE'
     if (!fin.getline(line, MAX_HEADER_CHARS)
@@ -572,38 +589,156 @@ __skip_rest_of_antenna__(std::ifstream& fin)
     return 0;
 }
 
-/// Check if a given string is empty, i.e. only holds whitespaces
-inline bool
-__string_is_empty__(const char* c, std::size_t max_chars)
-noexcept
+/**
+ *  \details Collect the position of every antenna in the file (i.e. of the
+ *           record following "TYPE / SERIAL NO") into the instance's antenna
+ *           index, keyed by the model+radome+serial, i.e. the first 40 chars
+ *           of the "TYPE / SERIAL NO" record. If an antenna is recorded more
+ *           than once, the first record is kept. On the same pass, satellite
+ *           antennas are added to the satellite antenna index, with their
+ *           VALID FROM / VALID UNTIL epochs (if any).
+ *
+ *  \return  0 on success, -1 on ANTEX format error.
+ */
+int
+antex::build_index()
 {
-    for (std::size_t i=0; i<max_chars; i++)
-        if ( *(c+i) != ' ' )
-            return false;
-    return true;
+    // The stream should be open by now!
+    assert(this->_istream.is_open());
+
+    std::string line, record;
+    pos_type    pos { 0 };
+    datetime_ms from, until;
+    bool        in_antenna { false };
+    int         status     { 0 };
+
+    _index.clear();
+    _satellites.clear();
+
+    // Go to the end of header.
+    _istream.clear();
+    _istream.seekg(_end_of_head, std::ios_base::beg);
+
+    while ( !status && std::getline(_istream, line) ) {
+        if ( line.size() < 60 ) { continue; }
+        const char* label = line.c_str() + 60;
+        if ( !std::strncmp(label, "START OF ANTENNA", 16) ) {
+            // next record must be the 'TYPE / SERIAL NO'
+            if (   in_antenna
+                || !std::getline(_istream, record)
+                || record.size() < 60
+                || std::strncmp(record.c_str()+60, "TYPE / SERIAL NO", 16) ) {
+                status = -1;
+            } else {
+                pos   = _istream.tellg();
+                from  = datetime_ms();
+                until = satellite_antenna_index<pos_type>::end_of_time();
+                in_antenna = true;
+                _index.emplace(antenna(record.c_str()).to_string(), pos);
+            }
+        } else if ( !std::strncmp(label, "VALID FROM", 10) ) {
+            if ( !in_antenna || read_epoch(line.c_str(), from) ) { status = -1; }
+        } else if ( !std::strncmp(label, "VALID UNTIL", 11) ) {
+            if ( !in_antenna || read_epoch(line.c_str(), until) ) { status = -1; }
+        } else if ( !std::strncmp(label, "END OF ANTENNA", 14) ) {
+            if ( !in_antenna ) {
+                status = -1;
+            } else {
+                _satellites.add(record, from, until, pos);
+                in_antenna = false;
+            }
+        }
+    }
+
+    if ( status || in_antenna ) {
+#ifdef DEBUG
+        std::cerr << "\n[DEBUG] ERROR while indexing antex file; in line:\n"
+                  << line;
+#endif
+        _index.clear();
+        _satellites.clear();
+        return -1;
+    }
+
+    // .. we' ve stoped at eof.
+    _istream.clear();
+    _satellites.sort();
+    _indexed = true;
+
+    return 0;
+}
+
+/// \details Fields are read as 5I6,F13.7 (i.e. year, month, day, hours,
+///          minutes and seconds).
+///
+/// \return  0 on success, 1 if the epoch cannot be resolved.
+int
+antex::read_epoch(const char* c, datetime_ms& t)
+{
+    const char* start = c;
+    char*       end;
+    int         fields[5];
+
+    for (int i=0; i<5; ++i) {
+        fields[i] = static_cast<int>( std::strtol(start, &end, 10) );
+        if ( end == start ) { return 1; }
+        start = end;
+    }
+    const double secs { std::strtod(start, &end) };
+    if ( end == start ) { return 1; }
+
+    try {
+        t = datetime_ms(ngpt::year{fields[0]},
+                        ngpt::month{fields[1]},
+                        ngpt::day_of_month{fields[2]},
+                        ngpt::milliseconds{
+                            (fields[3]*60L*60L + fields[4]*60L) * 1000L
+                          + std::lround(secs * 1000e0) });
+    } catch (std::out_of_range& e) {
+        return 1;
+    }
+    return 0;
 }
 
 /**
- *  Search through the ANTEX file (i.e. this instance's buffer) to find
- *  a specific antenna. If the antenna is indeed found, the file buffer is
- *  set at the record line "TYPE / SERIAL NO" of the requested antenna.
- *  Note that the function will try to match the antenna based on the model,
- *  radome and serial number. The model+radome must be found exactly as
- *  recorded in the antenna instance. For the serial (if not matched exactly),
- *  the function will return a 'generic' antenna, i.e. with a serial of
- *  20 whitespaces. The ANTEX format specifications state that a blank serial 
- *  number match all representatives.
- * 
- *  \note  This function expects that the antenna patterns are sorted as
- *         documented by IGS, i.e.
- \verbatim
+ *  \details Resolve an antenna to the position of its record in the file,
+ *           i.e. the record line following "TYPE / SERIAL NO". The antenna is
+ *           matched based on the model, radome and serial number. The
+ *           model+radome must be found exactly as recorded in the antenna
+ *           instance. For the serial (if not matched exactly), the function
+ *           will return a 'generic' antenna, i.e. with a serial of 20
+ *           whitespaces. The ANTEX format specifications state that a blank
+ *           serial number match all representatives.
+ *
+ *           The file is only read once, on the first call, to build the
+ *           antenna index (see build_index()); every call is then (at most)
+ *           two hashed lookups (see find_antenna_record()), one for the exact
+ *           model+radome+serial and one for the generic antenna.
+ *
+ *  \return  -1 on ANTEX format error, 0 if the antenna is found (pos is set)
+ *           and 1 if it is not.
+ */
+int
+antex::locate_antenna(const antenna& ant, pos_type& pos)
+{
+    if ( !_indexed && this->build_index() ) {
+        return -1;
+    }
 
-RECEIVER ANTENNAS:
---> sorted by antenna code
-    --> sorted by radome code (NONE -> other radome types)
-            --> sorted by 'SERIAL NO'
+    const auto it = ngpt::find_antenna_record(_index, ant);
+    if ( it == _index.cend() ) {
+        return 1;
+    }
 
- \endverbatim
+    pos = it->second;
+    return 0;
+}
+
+/**
+ *  Find a specific antenna in the ANTEX file (i.e. this instance's buffer).
+ *  If the antenna is indeed found, the file buffer is set at the record line
+ *  following "TYPE / SERIAL NO" of the requested antenna. See locate_antenna()
+ *  for how antennas (and serial numbers) are matched.
  *
  *  \return An integer denoting the exit status.
  *  Integer | Status
@@ -611,176 +746,92 @@ RECEIVER ANTENNAS:
  *       -1 | ANTEX format error; something went wrong while reading.
  *        0 | Success; antenna found.
  *        1 | Antenna could not be found.
- * 
- *  \warning 
- *  \todo consider serial numbers.
  *
  */
 int
 antex::find_antenna(const antenna& ant)
 {
-    using ngpt::antenna;
-
-    char line[MAX_HEADER_CHARS];
-
-    /// See the definition of eoh_size for why the following is needed.
-#ifdef __clang__
-    const     std::size_t soa_size { std::strlen("START OF ANTENNA") };
-#else
-    constexpr std::size_t soa_size { std::strlen("START OF ANTENNA") };
-#endif
-
-    std::size_t antennas_read { 0 };
-    antenna     t_ant;
-    int         status;
-    pos_type    best_match { 0 }; /* if more than one types match, this marks the
-                                     best match depending on serial nr */
-
     // The stream should be open by now!
     assert(this->_istream.is_open());
 
-    // Go to the end of header.
-    _istream.seekg(_end_of_head, std::ios_base::beg);
-
-    // First line after end of header, should be the start of a new antenna.
-    if (!_istream.getline(line, MAX_HEADER_CHARS)
-        || strncmp(line+60, "START OF ANTENNA", soa_size)) 
-    {
-        return -1;
+    pos_type pos;
+    int      status;
+    if ( (status = this->locate_antenna(ant, pos)) ) {
+        return status;
     }
 
-    // Read & check antenna type
-    if (!_istream.getline(line, MAX_HEADER_CHARS)
-        || strncmp(line+60, "TYPE / SERIAL NO    ", 20))
-    {
-        return -1;
-    }
+    // position the buffer at the match
+    _istream.clear();
+    _istream.seekg( pos );
 
-    // Set the antenna type of the current antenna.
-    t_ant     = (line);
-    
-    // note that antenna::operator= only compares type+radome !
-    while (t_ant != ant && _istream.good())
-    {
-        // skip the antenna details ...
-        if ( (status = __skip_rest_of_antenna__(_istream)) ) {
-#ifdef DEBUG
-            std::cerr << "\n[DEBUG] ERROR in __skip_rest_of_antenna__; "
-                      << "status="<<status;
-            std::cerr << "\nError in line:\n"
-                      << line;
-#endif
-            return -1;
-        }
-        antennas_read++;
+    return 0;
+}
 
-        // read new antenna ..
-        if (!_istream.getline(line, MAX_HEADER_CHARS)
-            || strncmp(line+60, "START OF ANTENNA", soa_size))
-        {
-#ifdef DEBUG
-            std::cerr << "\n[DEBUG] ERROR while reading antex file. "
-                      << "'START OF ANTENNA' expected";
-            std::cerr << "\n\tError in line:\n"
-                      << line;
-#endif
-            return -1;
-        }
-        // read & check antenna type
-        if (!_istream.getline(line, MAX_HEADER_CHARS)
-            || strncmp(line+60, "TYPE / SERIAL NO", 16))
-        {
-#ifdef DEBUG
-            std::cerr << "\n[DEBUG] ERROR while reading antex file. "
-                      << "'TYPE / SERIAL NO' expected";
-            std::cerr << "\n\tError in line:\n"
-                      << line;
-#endif
-            return -1;
-        }
-        // Set the antenna type.
-        t_ant = (line);
+/**
+ *  \details Antennas are cached by the position of their record, so that
+ *           antennas resolving to the same record (e.g. different serials
+ *           of a generic antenna) share one pattern. A cache hit reads
+ *           nothing off the file.
+ */
+antex::pcv_handle
+antex::cached_antenna_pattern(const antenna& ant)
+{
+    pos_type pos;
+    if ( this->locate_antenna(ant, pos) ) {
+        return nullptr;
     }
+    return this->cached_pattern_at(pos);
+}
 
-    // .. we' ve stoped; either eof encountered ...
-    if (_istream.eof()) {
-        _istream.clear();
+/**
+ *  \details Satellites are resolved off the satellite antenna index, i.e. by
+ *           PRN or SVN and the VALID FROM / VALID UNTIL interval (see
+ *           satellite_antenna_index), in O(log n).
+ */
+int
+antex::find_satellite_antenna(const std::string& sat, const datetime_ms& t)
+{
+    // The stream should be open by now!
+    assert(this->_istream.is_open());
+
+    if ( !_indexed && this->build_index() ) {
+        return -1;
+    }
+    const pos_type* pos = _satellites.find(sat, t);
+    if ( !pos ) {
         return 1;
     }
 
-    // .. or we found the antenna !! Cool, but we 're not done matherfucker.
-    // We need to see if there is a better match, based on the serial.
-    char* serial_ptr = line + 20;
-    while ( t_ant == ant && _istream ) {
-        if ( ant.compare_serial(serial_ptr)  ) {
-            best_match = _istream.tellg();
-            break;
-        } else if (__string_is_empty__(serial_ptr, ANTEX_SERIAL_CHARS)) {
-            best_match = _istream.tellg();
-        }
-#ifdef DEBUG
-        std::cout << "\n[DEBUG] Searching for a better match than:"
-                  << line;
-#endif
-        // skip the antenna details ...
-        if ( (status = __skip_rest_of_antenna__(_istream)) ) {
-#ifdef DEBUG
-            std::cerr << "\n[DEBUG] ERROR in __skip_rest_of_antenna__; "
-                      << "status="<<status;
-            std::cerr << "\nError in line:\n"
-                      << line;
-#endif
-            return -1;
-        }
-        antennas_read++;
+    // position the buffer at the match
+    _istream.clear();
+    _istream.seekg( *pos );
 
-        // read new antenna ..
-        if (!_istream.getline(line, MAX_HEADER_CHARS)
-            || strncmp(line+60, "START OF ANTENNA", soa_size))
-        {
-            // Oh shit, wait a minute! we could have just read the last
-            // antenna (line) in the file, so the lat op ended in eof state.
-            if ( _istream.eof() ) {
-                _istream.clear();
-                break;
-            } else {
-#ifdef DEBUG
-                std::cerr << "\n[DEBUG] ERROR while reading antex file (searching for a perfect match)"
-                          << "'START OF ANTENNA' expected";
-                std::cerr << "\n\tError in line:\n"
-                          << line;
-#endif
-                return -1;
-            }
-        }
-        // read & check antenna type
-        if (!_istream.getline(line, MAX_HEADER_CHARS)
-            || strncmp(line+60, "TYPE / SERIAL NO", 16))
-        {
-#ifdef DEBUG
-            std::cerr << "\n[DEBUG] ERROR while reading antex file. "
-                      << "'TYPE / SERIAL NO' expected";
-            std::cerr << "\n\tError in line:\n"
-                      << line;
-#endif
-            return -1;
-        }
-        // Set the antenna type.
-        t_ant = ( line );
-        serial_ptr = line + 20;
+    return 0;
+}
+
+antex::pcv_handle
+antex::cached_satellite_pattern(const std::string& sat, const datetime_ms& t)
+{
+    if ( !_indexed && this->build_index() ) {
+        return nullptr;
     }
+    const pos_type* pos = _satellites.find(sat, t);
+    return pos ? this->cached_pattern_at(*pos) : nullptr;
+}
 
-    // position the buffer at the best match
-    if ( !best_match ) {
-        return 1;
-    } else {
-        _istream.seekg( best_match );
+/// The pattern at a record position, off the pattern cache (read and cached
+/// on a miss).
+antex::pcv_handle
+antex::cached_pattern_at(pos_type pos)
+{
+    const pcv_cache<pcv_type>::key_type key { pos };
+    if ( pcv_handle h = _cache.find(key) ) {
+        return h;
     }
 
-#ifdef DEBUG
-    printf ("\n[DEBUG] Antenna found after reading %zu antennas",antennas_read);
-#endif
-    return 0;
+    _istream.clear();
+    _istream.seekg( pos );
+    return _cache.insert(key, this->read_pattern());
 }
 
 std::vector<ngpt::antex::ant_pos_pair>
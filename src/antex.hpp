@@ -2,9 +2,16 @@
 #define __ANTEX_HPP__
 
 #include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "satsys.hpp"
 #include "antenna.hpp"
 #include "antpcv.hpp"
+#include "infile.hpp"
+#include "pcv_cache.hpp"
+#include "satellite_antenna_index.hpp"
+#include "datetime_v2.hpp"
 
 /**
  * \file
@@ -97,6 +104,37 @@ namespace ngpt
 /// ngpt::frequency_pcv
 using pcv_type = float;
 
+/// Find an antenna in an index keyed by model+radome+serial, as recorded in
+/// the "TYPE / SERIAL NO" records of ANTEX files (i.e. 40 chars). The exact
+/// match is returned or else the generic antenna (i.e. blank serial); if
+/// neither is found, index.cend().
+template<typename M>
+typename M::const_iterator
+find_antenna_record(const M& index, const antenna& ant)
+{
+    constexpr std::size_t mr_chars { antenna_details::antenna_model_max_chars
+                                   + 1
+                                   + antenna_details::antenna_radome_max_chars };
+    constexpr std::size_t sn_chars { antenna_details::antenna_serial_max_chars };
+
+    // model+radome (and serial, if any) as recorded in the antenna instance.
+    const std::string name { ant.to_string() };
+    if ( name.size() < mr_chars ) {
+        return index.cend();
+    }
+
+    auto it = index.cend();
+    // exact match (including the serial) ...
+    if ( name.size() >= mr_chars + sn_chars ) {
+        it = index.find( name.substr(0, mr_chars + sn_chars) );
+    }
+    // ... or the generic antenna (i.e. blank serial).
+    if ( it == index.cend() ) {
+        it = index.find( name.substr(0, mr_chars) + std::string(sn_chars, ' ') );
+    }
+    return it;
+}
+
 /*
  * \class   antex
  *
@@ -131,7 +169,8 @@ class antex
 
 public:
     
-    /// Constructor from filename.
+    /// Constructor from filename; the file may be gzip or Unix compress(ed)
+    /// (see input_file).
     antex(const char*);
 
     /// Destructor (closing the file is not mandatory, but nevertheless)
@@ -172,9 +211,37 @@ public:
         return read_pattern();
     }
 
-    /// Find a specific antenna in the instance.
+    /// Shared, immutable handle to a (parsed) antenna calibration pattern.
+    typedef pcv_cache<pcv_type>::handle pcv_handle;
+
+    /// Get the calibration pattern of an antenna off the pattern cache; the
+    /// pattern is only read (and cached) on a cache miss. Returns nullptr if
+    /// the antenna is not found.
+    pcv_handle cached_antenna_pattern(const antenna&);
+
+    /// The pattern cache (e.g. to set its capacity or get its counters).
+    pcv_cache<pcv_type>& pattern_cache() noexcept { return _cache; }
+    const pcv_cache<pcv_type>& pattern_cache() const noexcept { return _cache; }
+
+    /// Find a specific antenna in the instance (off the antenna index, which
+    /// is built on the first call).
     int find_antenna(const antenna&);
 
+    /// Epochs (e.g. of VALID FROM / VALID UNTIL records).
+    typedef satellite_antenna_index<pos_type>::datetime_ms datetime_ms;
+
+    /// Find the calibration of a satellite, by PRN (e.g. "G01") or SVN (e.g.
+    /// "G063"), valid at the given epoch (off the antenna index); the stream
+    /// is set as in find_antenna().
+    int find_satellite_antenna(const std::string&, const datetime_ms&);
+
+    /// Get the calibration pattern of a satellite (PRN or SVN) valid at the
+    /// given epoch off the pattern cache; nullptr if not found.
+    pcv_handle cached_satellite_pattern(const std::string&, const datetime_ms&);
+
+    /// Read an epoch off a VALID FROM / VALID UNTIL record (5I6,F13.7).
+    static int read_epoch(const char*, datetime_ms&);
+
     /// Get a list of all antennas in the ANTEX and their respective positions
     std::vector<ant_pos_pair> get_antenna_list();
   
@@ -183,18 +250,39 @@ public:
     ngpt::antenna_pcv<pcv_type>
     read_pattern();
 
+    /// Read antenna calibration pattern off any stream (positioned at the
+    /// 'METH / BY / # / DATE' record of an antenna block).
+    static ngpt::antenna_pcv<pcv_type>
+    read_pattern(std::istream&);
+
 private:
   
     /// Read the instance header, and assign (most of) the fields.
     int read_header();
 
+    /// Build the antenna (and satellite antenna) index, in one pass over the
+    /// file.
+    int build_index();
+
+    /// Resolve an antenna to the position of its record (off the index).
+    int locate_antenna(const antenna&, pos_type&);
+
+    /// The pattern of the antenna recorded at a position, off the cache.
+    pcv_handle cached_pattern_at(pos_type);
+
     std::string            _filename; ///< The name of the antex file.
-    std::ifstream          _istream;  ///< The infput (file) stream.
+    input_file             _istream;  ///< The infput (file) stream.
     ngpt::satellite_system _satsys;   ///< satellite system.
     ATX_VERSION            _version;  ///< Atx version (1.4).
     PCV_TYPE               _type;     ///< Pcv type (absolute or relative).
     ngpt::antenna          _refant;   ///< Reference antenna (only relative pcv).
     pos_type               _end_of_head; ///< Mark the 'END OF HEADER' field.
+    std::unordered_map<std::string, pos_type> _index; ///< Position of every
+    ///< antenna, keyed by model+radome+serial (as recorded in the file).
+    satellite_antenna_index<pos_type> _satellites; ///< Position of every
+    ///< satellite antenna, by PRN/SVN and validity interval.
+    bool                   _indexed;  ///< Is the antenna index built ?
+    pcv_cache<pcv_type>    _cache;    ///< Parsed patterns (LRU cache).
 
 }; // end antex
 
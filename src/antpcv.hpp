@@ -2,6 +2,9 @@
 #define __ANTPCV_HPP__
 
 #include <array>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 #include "grid.hpp"
 #include "obstype.hpp"
 
@@ -306,6 +309,21 @@ public:
     /// Destructor
     ~antenna_pcv() noexcept { delete azi_grid_; }
 
+    // Return the index of the fequency_pcv which matches the given (input)
+    // raw observable. The matching (between freq_pcv.obtype and obs) is
+    // performed based on Satellite System and frequency number/band.
+    std::size_t
+    freq_pcv_index( const ngpt::gnss_obs_details::_rawobs_& obs ) const
+    {
+        for (std::size_t i=0; i<freq_pcv_.size(); ++i) {
+            const auto r = freq_pcv_[i].type().raw_obs(0);
+            if ( r.satsys() == obs.satsys() && r.band() == obs.band() ) {
+                return i;
+            }
+        }
+        throw std::runtime_error("antenna_pcv::freq_pcv_index -> Invalid frequency");
+    }
+
     // Return/access a fequency_pcv based on its frequency. The matching
     // (between freq_pcv.obtype and type) must be performed based on Satellite
     // System and frequency number/band.
@@ -313,30 +331,73 @@ public:
     freq_pcv_pattern( ngpt::observation_type type )
     {
         assert( type.raw_obs_num() == 1 );
+        return freq_pcv_[ this->freq_pcv_index(type.raw_obs(0)) ];
+    }
 
-        for (auto& i : freq_pcv_) {
-            if (   i.raw_obs(0).satsys() == type.raw_obs(0).satsys() 
-                && i.raw_obs(0).band()   == type.raw_obs(0).band() ) {
-                return i;
-            }
+    // Return the (coefficient, index) pairs of the fequency_pcv patterns
+    // making up the given (input) observation_type, i.e. one per raw
+    // observable. Throws if any raw observable has no matching pattern.
+    std::vector<std::pair<double, std::size_t>>
+    freq_pcv_coefficients( const ngpt::observation_type& type ) const
+    {
+        std::vector<std::pair<double, std::size_t>> coefs;
+        coefs.reserve( type.raw_obs_num() );
+        for (std::size_t i=0; i<type.raw_obs_num(); ++i) {
+            coefs.emplace_back( type.coefficient(i),
+                                this->freq_pcv_index(type.raw_obs(i)) );
         }
-        throw std::runtime_error("antenna_pcv::freq_pcv_pattern -> Invalid frequency");
+        return coefs;
     }
 
-    // Return the index of the fequency_pcv which matches the given (input)
-    // observation_type. The matching (between freq_pcv.obtype and type) must 
-    // be performed based on Satellite System and frequency number/band.
-    /*std::vector<std::pair<double, std::size_t>>
-    freq_pcv_pattern( ngpt::observation_type type )
+    /// Build the pattern of a linear combination of the recorded frequencies
+    /// (e.g. the ionosphere-free one), described by an observation_type. The
+    /// result has the same grid(s) and a single frequency_pcv (at index 0),
+    /// where the eccentricities and the 'NOAZI'/'AZI' pcv values are the
+    /// (node by node) linear combination of the ones of the raw observables;
+    /// evaluating it then costs the same as evaluating a single frequency.
+    /// Throws std::runtime_error if any raw observable has no matching
+    /// pattern, or the patterns have different sizes.
+    antenna_pcv
+    combination( const ngpt::observation_type& type ) const
     {
-        std::vector<std::pair<double, std::size_t>> coefs;
-        for (
-    }*/
+        const auto coefs = this->freq_pcv_coefficients( type );
+        antenna_pcv c ( zen1(), zen2(), dzen(), 1,
+                        azi_grid_ ? dazi() : static_cast<T>(0) );
+        frequency_pcv<T>& f = c.freq_pcv_[0];
+        f.type() = type;
+        f.no_azi_vector().assign( no_azi_grid_.size(), static_cast<T>(0) );
+        if ( azi_grid_ ) {
+            f.azi_vector().assign( azi_grid_->size(), static_cast<T>(0) );
+        }
+        for (const auto& k : coefs) {
+            const frequency_pcv<T>& p = freq_pcv_[k.second];
+            if (   p.no_azi_size() != f.no_azi_size()
+                || ( azi_grid_ && p.azi_size() != f.azi_size() ) ) {
+                throw std::runtime_error
+                    ("antenna_pcv::combination -> Invalid pattern size");
+            }
+            const T w = static_cast<T>( k.first );
+            f.north() += w * p.north();
+            f.east()  += w * p.east();
+            f.up()    += w * p.up();
+            for (std::size_t i=0; i<f.no_azi_size(); ++i) {
+                f.no_azi_vector(i) += w * p.no_azi_vector(i);
+            }
+            for (std::size_t i=0; i<f.azi_size(); ++i) {
+                f.azi_vector(i) += w * p.azi_vector(i);
+            }
+        }
+        return c;
+    }
     
     // Return/access a fequency_pcv based on its index.
     frequency_pcv<T>&
     freq_pcv_pattern( std::size_t i ) { return freq_pcv_[i]; }
 
+    // Return a fequency_pcv based on its index.
+    const frequency_pcv<T>&
+    freq_pcv_pattern( std::size_t i ) const { return freq_pcv_[i]; }
+
     /// Get the ZEN1 value, i.e. the starting zenith angle for the correction
     /// grid.
     T zen1() const noexcept { return no_azi_grid_.from(); }
@@ -394,6 +455,21 @@ public:
                : 0;
     }
 
+    /// Number of frequencies (i.e. frequency_pcv patterns).
+    std::size_t frequencies() const noexcept { return freq_pcv_.size(); }
+
+    /// (Approximate) memory held by the instance, in bytes.
+    std::size_t bytes() const noexcept
+    {
+        std::size_t sz = sizeof(*this) + ( azi_grid_ ? sizeof(dim2_grid) : 0 )
+                       + freq_pcv_.capacity() * sizeof(frequency_pcv<T>);
+        for (const auto& i : freq_pcv_) {
+            sz += ( i.no_azi_vector_c().capacity()
+                  + i.azi_vector_c().capacity() ) * sizeof(T);
+        }
+        return sz;
+    }
+
     //TODO
     T no_azi_pcv(T zenith, std::size_t i) const
     {
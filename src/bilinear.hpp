@@ -0,0 +1,191 @@
+#ifndef __NGPT_BILINEAR_HPP__
+#define __NGPT_BILINEAR_HPP__
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/**
+ * \file      bilinear.hpp
+ *
+ * \version
+ *
+ * \author    xanthos@mail.ntua.gr <br>
+ *            danast@mail.ntua.gr
+ *
+ * \date
+ *
+ * \brief     Batched bilinear interpolation of many points on a regular grid.
+ *
+ * \copyright Copyright © 2015 Dionysos Satellite Observatory, <br>
+ *            National Technical University of Athens. <br>
+ *            This work is free. You can redistribute it and/or modify it under
+ *            the terms of the Do What The Fuck You Want To Public License,
+ *            Version 2, as published by Sam Hocevar. See http://www.wtfpl.net/
+ *            for more details.
+ *
+ * <b><center><hr>
+ * National Technical University of Athens <br>
+ *      Dionysos Satellite Observatory     <br>
+ *        Higher Geodesy Laboratory        <br>
+ *      http://dionysos.survey.ntua.gr
+ * <hr></center></b>
+ *
+ */
+
+namespace ngpt
+{
+
+/*
+ * \class   bilinear_batch
+ *
+ * \details Bilinear interpolation of a (fixed) set of points, on any number
+ *          of maps defined on the same regular 2D grid. The grid has nx
+ *          nodes on the x-axis (x0, x0+dx, ...) and ny nodes on the y-axis
+ *          (y0, y0+dy, ...); the steps may be negative (e.g. IONEX latitudes
+ *          run from north to south). Map values are stored row by row, i.e.
+ *          value(x_i, y_j) = map[j*nx + i].
+ *
+ *          For every point, the index of its cell (i.e. of the lower-left
+ *          node) and the four weights are computed once (see set_points())
+ *          and stored in SoA layout; interpolating a map (see apply()) is then
+ *          a branch-free gather-and-multiply-add loop over the points.
+ *          Points on the last node of an axis are assigned to the last cell,
+ *          with a zero weight for the (non-existing) next node.
+ *
+ * \warning The grid must have at least two nodes on each axis.
+ */
+class bilinear_batch
+{
+public:
+    /// Constructor from the grid definition.
+    bilinear_batch(double x0, double dx, std::size_t nx,
+                   double y0, double dy, std::size_t ny) noexcept
+        : _x0(x0), _dx(dx), _nx(nx), _y0(y0), _dy(dy), _ny(ny)
+    {}
+
+    /// Number of points set.
+    std::size_t size() const noexcept { return _index.size(); }
+
+    /// Number of grid nodes (i.e. the size of a map).
+    std::size_t grid_size() const noexcept { return _nx * _ny; }
+
+    /** Compute (and store) the cell indexes and weights for n points, given
+     *  as separate x and y arrays. Any previously set points are cleared.
+     *
+     *  \return 0 on success; else the (1-based) index of the first point
+     *          outside the grid (in which case no points are set).
+     */
+    std::size_t
+    set_points(const double* x, const double* y, std::size_t n)
+    {
+        _index.clear(); _w00.clear(); _w10.clear(); _w01.clear(); _w11.clear();
+        if ( _nx < 2 || _ny < 2 ) { return n ? 1 : 0; }
+
+        _index.resize(n); _w00.resize(n); _w10.resize(n);
+        _w01.resize(n);   _w11.resize(n);
+
+        // tolerance (in cells) for points on the grid limits
+        constexpr double eps { 1e-9 };
+        const double xmax = static_cast<double>(_nx - 1);
+        const double ymax = static_cast<double>(_ny - 1);
+
+        for (std::size_t i=0; i<n; ++i) {
+            double u = (x[i] - _x0) / _dx;
+            double v = (y[i] - _y0) / _dy;
+            if ( !(u >= -eps && u <= xmax+eps && v >= -eps && v <= ymax+eps) ) {
+                _index.clear(); _w00.clear(); _w10.clear();
+                _w01.clear();   _w11.clear();
+                return i+1;
+            }
+            double fu = std::floor(u), fv = std::floor(v);
+            if ( fu < 0e0 )  { fu = 0e0; }
+            if ( fu > xmax-1e0 ) { fu = xmax-1e0; }
+            if ( fv < 0e0 )  { fv = 0e0; }
+            if ( fv > ymax-1e0 ) { fv = ymax-1e0; }
+            double tx = u - fu, ty = v - fv;
+            _index[i] = static_cast<std::size_t>(fv) * _nx
+                      + static_cast<std::size_t>(fu);
+            _w00[i] = (1e0-tx)*(1e0-ty);
+            _w10[i] = tx*(1e0-ty);
+            _w01[i] = (1e0-tx)*ty;
+            _w11[i] = tx*ty;
+        }
+        return 0;
+    }
+
+    /** Interpolate the map for all points set; out must have (at least)
+     *  size() elements. Any map value type convertible to double will do
+     *  (e.g. raw IONEX int16 values).
+     */
+    template<typename T>
+    void
+    apply(const T* map, double* out) const noexcept
+    {
+        const std::size_t  n   = _index.size();
+        const std::size_t  nx  = _nx;
+        const std::size_t* idx = _index.data();
+        const double *w00 = _w00.data(), *w10 = _w10.data(),
+                     *w01 = _w01.data(), *w11 = _w11.data();
+        for (std::size_t i=0; i<n; ++i) {
+            const T* c = map + idx[i];
+            out[i] = w00[i] * static_cast<double>(c[0])
+                   + w10[i] * static_cast<double>(c[1])
+                   + w01[i] * static_cast<double>(c[nx])
+                   + w11[i] * static_cast<double>(c[nx+1]);
+        }
+    }
+
+    /** Same as above, using only the valid nodes of the map: bit k of valid
+     *  (i.e. bit k%64 of word k/64) is set if node k holds a value. The
+     *  weights of the (up to four) nodes of every cell are renormalized over
+     *  its valid nodes; points with no valid node (of non-zero weight) get a
+     *  NaN. If valid is nullptr, all nodes are valid.
+     */
+    template<typename T>
+    void
+    apply(const T* map, const std::uint64_t* valid, double* out) const noexcept
+    {
+        if ( !valid ) { this->apply(map, out); return; }
+        const std::size_t  n   = _index.size();
+        const std::size_t  nx  = _nx;
+        const std::size_t* idx = _index.data();
+        const double *w00 = _w00.data(), *w10 = _w10.data(),
+                     *w01 = _w01.data(), *w11 = _w11.data();
+        auto bit = [valid](std::size_t k) {
+            return static_cast<double>( (valid[k>>6] >> (k&63)) & 1u );
+        };
+        for (std::size_t i=0; i<n; ++i) {
+            const std::size_t k = idx[i];
+            const T* c = map + k;
+            const double a00 = w00[i] * bit(k),    a10 = w10[i] * bit(k+1),
+                         a01 = w01[i] * bit(k+nx), a11 = w11[i] * bit(k+nx+1);
+            const double ws  = a00 + a10 + a01 + a11;
+            const double v   = a00 * static_cast<double>(c[0])
+                             + a10 * static_cast<double>(c[1])
+                             + a01 * static_cast<double>(c[nx])
+                             + a11 * static_cast<double>(c[nx+1]);
+            out[i] = ws > 0e0 ? v / ws
+                              : std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+
+    /// The (flat) map index of the lower-left node of the i-th point's cell.
+    std::size_t cell_index(std::size_t i) const noexcept { return _index[i]; }
+
+private:
+    double      _x0, _dx;  ///< First node and step of the x-axis.
+    std::size_t _nx;       ///< Number of nodes on the x-axis.
+    double      _y0, _dy;  ///< First node and step of the y-axis.
+    std::size_t _ny;       ///< Number of nodes on the y-axis.
+    std::vector<std::size_t> _index; ///< Cell (lower-left node) index per point
+    std::vector<double> _w00, _w10, _w01, _w11; ///< Weights per point, for the
+    ///< nodes at (i,j), (i+1,j), (i,j+1) and (i+1,j+1).
+
+}; // end bilinear_batch
+
+} // end ngpt
+
+#endif
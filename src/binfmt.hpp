@@ -0,0 +1,71 @@
+#ifndef __NGPT_BINFMT_HPP__
+#define __NGPT_BINFMT_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include "datetime_v2.hpp"
+
+/**
+ * \file      binfmt.hpp
+ *
+ * \version
+ *
+ * \author    xanthos@mail.ntua.gr <br>
+ *            danast@mail.ntua.gr
+ *
+ * \date
+ *
+ * \brief     Helpers shared by the binary file formats of the library (the
+ *            IONEX cache and the antenna snapshot); internal, not installed.
+ *
+ * \copyright Copyright © 2015 Dionysos Satellite Observatory, <br>
+ *            National Technical University of Athens. <br>
+ *            This work is free. You can redistribute it and/or modify it under
+ *            the terms of the Do What The Fuck You Want To Public License,
+ *            Version 2, as published by Sam Hocevar. See http://www.wtfpl.net/
+ *            for more details.
+ *
+ * <b><center><hr>
+ * National Technical University of Athens <br>
+ *      Dionysos Satellite Observatory     <br>
+ *        Higher Geodesy Laboratory        <br>
+ *      http://dionysos.survey.ntua.gr
+ * <hr></center></b>
+ *
+ */
+
+namespace ngpt
+{
+
+namespace binfmt_details
+{
+    /// Epochs, as stored in binary files.
+    typedef ngpt::datev2<ngpt::milliseconds> datetime_ms;
+
+    /// Split an epoch to (MJD, milliseconds of day).
+    inline void
+    split_epoch(const datetime_ms& d, std::int64_t* out) noexcept
+    {
+        datetime_ms day { d.mjd() };
+        out[0] = d.mjd().as_underlying_type();
+        out[1] = d.delta_sec(day).as_underlying_type();
+    }
+
+    /// Join an epoch off (MJD, milliseconds of day).
+    inline datetime_ms
+    join_epoch(const std::int64_t* in) noexcept
+    {
+        datetime_ms d { ngpt::modified_julian_day(in[0]) };
+        d.add_seconds( static_cast<long>(in[1]) );
+        return d;
+    }
+
+    /// Round an offset up to a multiple of alignment.
+    inline std::uint64_t
+    align(std::uint64_t offset, std::uint64_t alignment) noexcept
+    { return (offset + alignment - 1) / alignment * alignment; }
+}
+
+} // end ngpt
+
+#endif
@@ -0,0 +1,236 @@
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include "i5decode.hpp"
+
+// The SIMD decoder is compiled (with the 'target' attribute) on x86 hosts
+// and selected at runtime, so that no special compilation flags are needed.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    #define NGPT_I5_SIMD
+    #include <tmmintrin.h>
+#endif
+
+namespace
+{
+
+/// Length of a full I5 record line (16 fields).
+constexpr std::size_t I5_LINE_CHARS { 5 * ngpt::I5_FIELDS_PER_LINE };
+
+#ifdef NGPT_I5_SIMD
+/// Shuffle masks to transpose an 80-char line (held in 5 16-byte registers)
+/// to 5 registers, each holding the d-th char of every field; i.e.
+/// column[d][k] = line[5*k + d]. masks[d][j] picks the chars of column d that
+/// live in register j (all other lanes are zeroed, i.e. 0x80).
+struct i5_shuffle_masks
+{
+    alignas(16) std::uint8_t m[5][5][16];
+
+    constexpr i5_shuffle_masks() : m{}
+    {
+        for (int d=0; d<5; ++d) {
+            for (int j=0; j<5; ++j) {
+                for (int k=0; k<16; ++k) {
+                    int byte = 5*k + d;
+                    m[d][j][k] = ( byte/16 == j )
+                               ? static_cast<std::uint8_t>( byte%16 )
+                               : 0x80;
+                }
+            }
+        }
+    }
+};
+
+constexpr i5_shuffle_masks i5_masks {};
+
+/// Decode 16 I5 fields (80 chars) at once; lanes not set in lane_mask are
+/// neither validated nor written.
+__attribute__((target("ssse3")))
+int
+decode_i5_simd(const char* line, unsigned lane_mask, std::int16_t* out,
+               std::uint16_t* no_value)
+noexcept
+{
+    __m128i src[5];
+    for (int j=0; j<5; ++j) {
+        src[j] = _mm_loadu_si128( reinterpret_cast<const __m128i*>(line+16*j) );
+    }
+
+    const __m128i zero   = _mm_setzero_si128();
+    const __m128i nine   = _mm_set1_epi8( 9 );
+    const __m128i ascii0 = _mm_set1_epi8( '0' );
+    const __m128i blank  = _mm_set1_epi8( ' ' );
+    const __m128i minus  = _mm_set1_epi8( '-' );
+    const __m128i ten    = _mm_set1_epi16( 10 );
+
+    __m128i bad      = zero; // lanes holding a malformed field
+    __m128i negative = zero; // lanes holding a negative value
+    __m128i is_digit_prev = zero, sign_or_digit_prev = zero;
+    __m128i acc_lo = zero, acc_hi = zero, last = zero;
+
+    for (int d=0; d<5; ++d) {
+        // transpose: the d-th char of every field
+        __m128i col = zero;
+        for (int j=0; j<5; ++j) {
+            col = _mm_or_si128(col, _mm_shuffle_epi8(src[j],
+                   _mm_load_si128(
+                     reinterpret_cast<const __m128i*>(i5_masks.m[d][j]))));
+        }
+        // classify
+        __m128i digit    = _mm_sub_epi8( col, ascii0 );
+        __m128i is_digit = _mm_cmpeq_epi8( _mm_min_epu8(digit, nine), digit );
+        __m128i is_blank = _mm_cmpeq_epi8( col, blank );
+        __m128i is_minus = _mm_cmpeq_epi8( col, minus );
+        // any char other than blank, '-' or digit is an error
+        bad = _mm_or_si128(bad, _mm_andnot_si128(
+                _mm_or_si128(is_digit, _mm_or_si128(is_blank, is_minus)),
+                _mm_set1_epi8(-1)));
+        // a digit or a sign must be followed by a digit
+        if ( d ) {
+            bad = _mm_or_si128(bad,
+                    _mm_andnot_si128(is_digit, sign_or_digit_prev));
+        }
+        negative = _mm_or_si128( negative, is_minus );
+        is_digit_prev      = is_digit;
+        sign_or_digit_prev = _mm_or_si128( is_digit, is_minus );
+        // accumulate the first 4 digits in 16-bit lanes (max 9999)
+        digit = _mm_and_si128( digit, is_digit );
+        if ( d < 4 ) {
+            acc_lo = _mm_add_epi16( _mm_mullo_epi16(acc_lo, ten),
+                                    _mm_unpacklo_epi8(digit, zero) );
+            acc_hi = _mm_add_epi16( _mm_mullo_epi16(acc_hi, ten),
+                                    _mm_unpackhi_epi8(digit, zero) );
+        } else {
+            last = digit;
+        }
+    }
+    // the last char must be a digit
+    bad = _mm_or_si128( bad, _mm_andnot_si128(is_digit_prev, _mm_set1_epi8(-1)) );
+
+    // value = acc*10 + last_digit; this may not fit in 16 bits, so use 32.
+    const __m128i w = _mm_set1_epi32( 0x0001000A ); // (10, 1) pairs
+    __m128i last_lo = _mm_unpacklo_epi8( last, zero );
+    __m128i last_hi = _mm_unpackhi_epi8( last, zero );
+    __m128i v0 = _mm_madd_epi16( _mm_unpacklo_epi16(acc_lo, last_lo), w );
+    __m128i v1 = _mm_madd_epi16( _mm_unpackhi_epi16(acc_lo, last_lo), w );
+    __m128i v2 = _mm_madd_epi16( _mm_unpacklo_epi16(acc_hi, last_hi), w );
+    __m128i v3 = _mm_madd_epi16( _mm_unpackhi_epi16(acc_hi, last_hi), w );
+
+    // values exceeding the int16 range are errors (only positive values may,
+    // since a negative field holds at most 4 digits).
+    const __m128i i16max = _mm_set1_epi32( std::numeric_limits<std::int16_t>::max() );
+    __m128i ovf = _mm_packs_epi16(
+                    _mm_packs_epi32(_mm_cmpgt_epi32(v0, i16max),
+                                    _mm_cmpgt_epi32(v1, i16max)),
+                    _mm_packs_epi32(_mm_cmpgt_epi32(v2, i16max),
+                                    _mm_cmpgt_epi32(v3, i16max)));
+    bad = _mm_or_si128( bad, ovf );
+
+    if ( static_cast<unsigned>(_mm_movemask_epi8(bad)) & lane_mask ) {
+        return 1;
+    }
+
+    // pack to 16 bits and apply the sign
+    __m128i r_lo = _mm_packs_epi32( v0, v1 );
+    __m128i r_hi = _mm_packs_epi32( v2, v3 );
+    __m128i s_lo = _mm_unpacklo_epi8( negative, negative );
+    __m128i s_hi = _mm_unpackhi_epi8( negative, negative );
+    r_lo = _mm_sub_epi16( _mm_xor_si128(r_lo, s_lo), s_lo );
+    r_hi = _mm_sub_epi16( _mm_xor_si128(r_hi, s_hi), s_hi );
+
+    if ( no_value ) {
+        const __m128i nv = _mm_set1_epi16( ngpt::IONEX_NO_VALUE );
+        *no_value = static_cast<std::uint16_t>( lane_mask &
+                        _mm_movemask_epi8(_mm_packs_epi16(
+                            _mm_cmpeq_epi16(r_lo, nv),
+                            _mm_cmpeq_epi16(r_hi, nv))) );
+    }
+
+    if ( lane_mask == 0xFFFFu ) {
+        _mm_storeu_si128( reinterpret_cast<__m128i*>(out),   r_lo );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>(out+8), r_hi );
+    } else {
+        alignas(16) std::int16_t tmp[16];
+        _mm_store_si128( reinterpret_cast<__m128i*>(tmp),   r_lo );
+        _mm_store_si128( reinterpret_cast<__m128i*>(tmp+8), r_hi );
+        for (int k=0; k<16 && (lane_mask>>k)&1u; ++k) { out[k] = tmp[k]; }
+    }
+
+    return 0;
+}
+
+/// Decide (once) if the host can run the SIMD decoder.
+const bool use_simd_decoder = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3") != 0;
+}();
+#endif
+
+} // end anonymous namespace
+
+int
+ngpt::decode_i5_line_scalar(const char* line, std::size_t len, std::size_t n,
+                            std::int16_t* out, std::uint16_t* no_value)
+noexcept
+{
+    if ( n > I5_FIELDS_PER_LINE || len < 5*n ) { return 1; }
+
+    std::uint16_t nv_mask = 0;
+    for (std::size_t k=0; k<n; ++k) {
+        const char* c = line + 5*k;
+        std::size_t i = 0;
+        while ( i < 5 && c[i] == ' ' ) { ++i; }
+        bool negative = ( i < 5 && c[i] == '-' );
+        if ( negative ) { ++i; }
+        if ( i == 5 ) { return 1; }
+        long v = 0;
+        for ( ; i < 5; ++i ) {
+            unsigned digit = static_cast<unsigned char>(c[i]) - '0';
+            if ( digit > 9 ) { return 1; }
+            v = v*10 + digit;
+        }
+        if ( v > std::numeric_limits<std::int16_t>::max() ) { return 1; }
+        out[k] = static_cast<std::int16_t>( negative ? -v : v );
+        if ( out[k] == IONEX_NO_VALUE ) { nv_mask |= (1u << k); }
+    }
+
+    if ( no_value ) { *no_value = nv_mask; }
+    return 0;
+}
+
+int
+ngpt::decode_i5_line(const char* line, std::size_t len, std::size_t n,
+                     std::int16_t* out, std::uint16_t* no_value)
+noexcept
+{
+#ifdef NGPT_I5_SIMD
+    if ( use_simd_decoder ) {
+        if ( n > I5_FIELDS_PER_LINE || len < 5*n ) { return 1; }
+        if ( !n ) {
+            if ( no_value ) { *no_value = 0; }
+            return 0;
+        }
+        unsigned lane_mask = ( n == I5_FIELDS_PER_LINE )
+                           ? 0xFFFFu
+                           : ( (1u << n) - 1u );
+        // short lines are padded (with blanks) to a full 80-char record.
+        if ( len < I5_LINE_CHARS ) {
+            char buf[I5_LINE_CHARS];
+            std::memset(buf, ' ', I5_LINE_CHARS);
+            std::memcpy(buf, line, len);
+            return decode_i5_simd(buf, lane_mask, out, no_value);
+        }
+        return decode_i5_simd(line, lane_mask, out, no_value);
+    }
+#endif
+    return decode_i5_line_scalar(line, len, n, out, no_value);
+}
+
+bool
+ngpt::i5_simd_enabled() noexcept
+{
+#ifdef NGPT_I5_SIMD
+    return use_simd_decoder;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,77 @@
+#ifndef __NGPT_I5DECODE_HPP__
+#define __NGPT_I5DECODE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \file
+ *
+ * \version
+ *
+ * \author    xanthos@mail.ntua.gr <br>
+ *            danast@mail.ntua.gr
+ *
+ * \date
+ *
+ * \brief     Decoding of fixed-width I5 integer records (e.g. IONEX TEC lines).
+ *
+ * \copyright Copyright © 2015 Dionysos Satellite Observatory, <br>
+ *            National Technical University of Athens. <br>
+ *            This work is free. You can redistribute it and/or modify it under
+ *            the terms of the Do What The Fuck You Want To Public License,
+ *            Version 2, as published by Sam Hocevar. See http://www.wtfpl.net/
+ *            for more details.
+ *
+ * <b><center><hr>
+ * National Technical University of Athens <br>
+ *      Dionysos Satellite Observatory     <br>
+ *        Higher Geodesy Laboratory        <br>
+ *      http://dionysos.survey.ntua.gr
+ * <hr></center></b>
+ *
+ */
+
+namespace ngpt
+{
+
+/// Max number of I5 fields in an (80-column) record line.
+constexpr std::size_t I5_FIELDS_PER_LINE { 16 };
+
+/// The value marking a non-available value in IONEX maps.
+constexpr int IONEX_NO_VALUE { 9999 };
+
+/** Decode the first n (<= 16) right-justified I5 fields of a record line.
+ *  A valid field is made up of (optional) leading blanks, an (optional) minus
+ *  sign and at least one digit, e.g. "  123", "-9999", "    0".
+ *
+ *  If the host supports it (SSSE3), the whole line is decoded at once using
+ *  SIMD instructions; else a scalar decoder is used. The results are the same.
+ *
+ *  \param[in]  line     The record line; need not be null-terminated.
+ *  \param[in]  len      Number of chars in line; must be at least 5*n.
+ *  \param[in]  n        Number of fields to decode (at most 16).
+ *  \param[out] out      At output, the n decoded values.
+ *  \param[out] no_value If not null, at output bit i is set if field i holds
+ *                       the IONEX_NO_VALUE marker (i.e. 9999).
+ *  \return              0 on success; anything else denotes a malformed field
+ *                       or a value that does not fit in an std::int16_t.
+ */
+int
+decode_i5_line(const char* line, std::size_t len, std::size_t n,
+               std::int16_t* out, std::uint16_t* no_value = nullptr)
+noexcept;
+
+/// The scalar version of decode_i5_line(); mostly for testing/benchmarking.
+int
+decode_i5_line_scalar(const char* line, std::size_t len, std::size_t n,
+                      std::int16_t* out, std::uint16_t* no_value = nullptr)
+noexcept;
+
+/// Is the SIMD decoder used (on this host) by decode_i5_line() ?
+bool
+i5_simd_enabled() noexcept;
+
+} // end ngpt
+
+#endif
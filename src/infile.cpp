@@ -0,0 +1,353 @@
+#ifdef HAVE_CONFIG_H
+    #include "config.h"
+#endif
+#include <cstdint>
+#include <fstream>
+#include <utility>
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+    #include <zlib.h>
+#endif
+#ifdef DEBUG
+    #include <iostream>
+#endif
+#include "infile.hpp"
+
+using ngpt::input_file;
+using ngpt::compression;
+
+namespace
+{
+/// Size of the chunks compressed files are read in.
+constexpr std::size_t CHUNK_SIZE { 1 << 16 };
+
+/// Unix compress (LZW) constants: first code width, clear code and the first
+/// free code in block mode.
+constexpr int  LZW_INIT_BITS { 9 };
+constexpr long LZW_CLEAR     { 256 };
+constexpr long LZW_FIRST     { 257 };
+
+/// A (seekable) stream buffer, reading off a block of memory it owns.
+class memory_buf : public std::streambuf
+{
+public:
+    /// The contents; call reset() after any change.
+    std::vector<char>& contents() noexcept { return _data; }
+
+    /// The contents.
+    const std::vector<char>& contents() const noexcept { return _data; }
+
+    /// Point the get area at the (whole) contents.
+    void reset() noexcept
+    {
+        char* b = _data.data();
+        this->setg(b, b, b + _data.size());
+    }
+
+protected:
+    pos_type
+    seekoff(off_type off, std::ios_base::seekdir dir,
+            std::ios_base::openmode which = std::ios_base::in) override
+    {
+        if ( !(which & std::ios_base::in) ) { return pos_type(off_type(-1)); }
+        off_type pos = off;
+        if ( dir == std::ios_base::cur ) {
+            pos += this->gptr() - this->eback();
+        } else if ( dir == std::ios_base::end ) {
+            pos += this->egptr() - this->eback();
+        }
+        if ( pos < 0 || pos > this->egptr() - this->eback() ) {
+            return pos_type(off_type(-1));
+        }
+        this->setg(this->eback(), this->eback() + pos, this->egptr());
+        return pos_type(pos);
+    }
+
+    pos_type
+    seekpos(pos_type pos,
+            std::ios_base::openmode which = std::ios_base::in) override
+    { return this->seekoff(off_type(pos), std::ios_base::beg, which); }
+
+private:
+    std::vector<char> _data; ///< The (decompressed) contents.
+};
+
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+/// Inflate a gzip stream (of any number of members), chunk by chunk.
+int
+_gunzip_(std::istream& fin, std::vector<char>& out)
+{
+    z_stream zs {};
+    if ( inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK ) { return 1; }
+
+    std::vector<unsigned char> in ( CHUNK_SIZE );
+    int status = Z_OK;
+    for (;;) {
+        if ( !zs.avail_in ) {
+            fin.read(reinterpret_cast<char*>(in.data()), CHUNK_SIZE);
+            zs.next_in  = in.data();
+            zs.avail_in = static_cast<uInt>( fin.gcount() );
+            if ( !zs.avail_in ) { break; }
+        }
+        std::size_t size = out.size();
+        out.resize( size + 4*CHUNK_SIZE );
+        zs.next_out  = reinterpret_cast<Bytef*>( out.data() + size );
+        zs.avail_out = static_cast<uInt>( 4*CHUNK_SIZE );
+        status = inflate(&zs, Z_NO_FLUSH);
+        out.resize( out.size() - zs.avail_out );
+        if ( status == Z_STREAM_END ) {
+            // more members may follow.
+            if ( !zs.avail_in
+                && fin.peek() == std::char_traits<char>::eof() ) {
+                break;
+            }
+            inflateReset(&zs);
+        } else if ( status != Z_OK && status != Z_BUF_ERROR ) {
+            break;
+        }
+    }
+
+    inflateEnd(&zs);
+    return status == Z_STREAM_END ? 0 : 1;
+}
+#endif
+
+/// Decode a Unix compress (LZW) stream, given in whole (including the 3-byte
+/// header). Codes are packed LSB-first, in groups of 8 codes; whenever the
+/// code width changes (or on a clear code), the rest of the current group is
+/// padding.
+int
+_unlzw_(const unsigned char* in, std::size_t n, std::vector<char>& out)
+{
+    if ( n < 3 || in[0] != 0x1f || in[1] != 0x9d ) { return 1; }
+    const int  maxbits    = in[2] & 0x1f;
+    const bool block_mode = in[2] & 0x80;
+    if ( maxbits < LZW_INIT_BITS || maxbits > 16 ) { return 1; }
+    const long maxmaxcode = 1L << maxbits;
+
+    std::vector<std::uint16_t> prefix ( maxmaxcode );
+    std::vector<unsigned char> suffix ( maxmaxcode );
+    std::vector<unsigned char> stack  ( maxmaxcode + 1 );
+    for (long i=0; i<256; ++i) { suffix[i] = static_cast<unsigned char>(i); }
+
+    const unsigned char* codes = in + 3;
+    const std::size_t    bytes = n - 3;
+    const std::size_t    total = bytes * 8;
+    std::size_t pos = 0, seg = 0;  // bit position; start of the code segment
+    int  n_bits   = LZW_INIT_BITS;
+    long maxcode  = (1L << n_bits) - 1;
+    long free_ent = block_mode ? LZW_FIRST : 256;
+    long oldcode  = -1;
+    unsigned char finchar = 0;
+
+    // skip to the end of the current group of 8 codes.
+    auto align = [&]() {
+        std::size_t group = static_cast<std::size_t>(n_bits) * 8;
+        pos = seg + ((pos - seg + group - 1) / group) * group;
+        seg = pos;
+    };
+
+    for (;;) {
+        if ( free_ent > maxcode ) {
+            align();
+            ++n_bits;
+            maxcode = (n_bits == maxbits) ? maxmaxcode : (1L << n_bits) - 1;
+        }
+        if ( pos + n_bits > total ) { break; }
+
+        // read the next code (at most 3 bytes).
+        std::size_t   byte = pos >> 3;
+        unsigned long word = codes[byte];
+        if ( byte+1 < bytes ) { word |= static_cast<unsigned long>(codes[byte+1]) << 8; }
+        if ( byte+2 < bytes ) { word |= static_cast<unsigned long>(codes[byte+2]) << 16; }
+        long code = static_cast<long>( (word >> (pos & 7)) & ((1UL << n_bits) - 1) );
+        pos += n_bits;
+
+        if ( oldcode == -1 ) {
+            if ( code >= 256 ) { return 1; }
+            finchar = static_cast<unsigned char>( code );
+            oldcode = code;
+            out.push_back( static_cast<char>(finchar) );
+            continue;
+        }
+        if ( code == LZW_CLEAR && block_mode ) {
+            align();
+            free_ent = LZW_FIRST - 1;
+            n_bits   = LZW_INIT_BITS;
+            maxcode  = (1L << n_bits) - 1;
+            continue;
+        }
+
+        // unwind the string of the code (reversed) onto the stack.
+        long incode = code;
+        std::size_t sp = 0;
+        if ( code >= free_ent ) {
+            if ( code > free_ent ) { return 1; }
+            stack[sp++] = finchar;
+            code = oldcode;
+        }
+        while ( code >= 256 ) {
+            stack[sp++] = suffix[code];
+            code = prefix[code];
+        }
+        finchar = suffix[code];
+        stack[sp++] = finchar;
+        while ( sp ) { out.push_back( static_cast<char>(stack[--sp]) ); }
+
+        if ( free_ent < maxmaxcode ) {
+            prefix[free_ent] = static_cast<std::uint16_t>( oldcode );
+            suffix[free_ent] = finchar;
+            ++free_ent;
+        }
+        oldcode = incode;
+    }
+
+    return 0;
+}
+}
+
+/// \returns compression::none if the file cannot be read (or is too short).
+compression
+ngpt::detect_compression(const char* filename)
+{
+    std::ifstream fin ( filename, std::ios_base::in | std::ios_base::binary );
+    unsigned char magic[2] = { 0, 0 };
+    if ( !fin.read(reinterpret_cast<char*>(magic), 2) || magic[0] != 0x1f ) {
+        return compression::none;
+    }
+    if ( magic[1] == 0x8b ) { return compression::gzip; }
+    if ( magic[1] == 0x9d ) { return compression::lzw;  }
+    return compression::none;
+}
+
+/**
+ *  \details The (whole) file is decompressed in-process, appending to out.
+ *           gzip streams are inflated (via zlib) chunk by chunk; Unix compress
+ *           streams are decoded by an LZW decoder of our own.
+ *
+ *  \returns An integer denoting the exit status; anything other than 0
+ *           denotes failure (e.g. invalid or truncated stream, or gzip input
+ *           with no zlib support).
+ */
+int
+ngpt::decompress(const char* filename, compression type, std::vector<char>& out)
+{
+    std::ifstream fin ( filename, std::ios_base::in | std::ios_base::binary );
+    if ( !fin.is_open() ) { return 1; }
+
+    if ( type == compression::gzip ) {
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+        return _gunzip_(fin, out);
+#else
+#ifdef DEBUG
+        std::cerr<<"\n[DEBUG] No zlib support; cannot read gzip file "<<filename;
+#endif
+        return 1;
+#endif
+    }
+
+    // read the whole (compressed or plain) file.
+    std::vector<char> raw;
+    std::vector<char> chunk ( CHUNK_SIZE );
+    while ( fin.read(chunk.data(), CHUNK_SIZE) || fin.gcount() ) {
+        raw.insert(raw.end(), chunk.data(), chunk.data() + fin.gcount());
+    }
+    if ( type == compression::none ) {
+        out.insert(out.end(), raw.cbegin(), raw.cend());
+        return 0;
+    }
+    out.reserve( out.size() + 4*raw.size() );
+    return _unlzw_(reinterpret_cast<const unsigned char*>(raw.data()),
+                   raw.size(), out);
+}
+
+/**
+ *  \details Plain files are opened (as with an std::ifstream). Compressed
+ *           files are decompressed in whole into memory, which the stream
+ *           then reads off.
+ */
+input_file::input_file(const char* filename, std::ios_base::openmode mode)
+    : std::istream(nullptr),
+      _buf(nullptr),
+      _compression(ngpt::detect_compression(filename))
+{
+    if ( _compression == compression::none ) {
+        std::unique_ptr<std::filebuf> fbuf ( new std::filebuf );
+        if ( fbuf->open(filename, mode | std::ios_base::in) ) {
+            _buf = std::move( fbuf );
+        }
+    } else {
+        std::unique_ptr<memory_buf> mbuf ( new memory_buf );
+        if ( !ngpt::decompress(filename, _compression, mbuf->contents()) ) {
+            mbuf->reset();
+            _buf = std::move( mbuf );
+        }
+#ifdef DEBUG
+        else {
+            std::cerr<<"\n[DEBUG] Failed to decompress file "<<filename;
+        }
+#endif
+    }
+    this->rdbuf( _buf.get() );
+}
+
+input_file::~input_file() noexcept {}
+
+input_file::input_file(input_file&& other)
+    : std::istream(std::move(other)),
+      _buf(std::move(other._buf)),
+      _compression(other._compression)
+{
+    this->attach();
+    other.attach();
+}
+
+input_file&
+input_file::operator=(input_file&& other)
+{
+    this->swap( other );
+    return *this;
+}
+
+void
+input_file::swap(input_file& other)
+{
+    std::istream::swap( other );
+    _buf.swap( other._buf );
+    std::swap( _compression, other._compression );
+    this->attach();
+    other.attach();
+}
+
+void
+input_file::attach()
+{
+    // rdbuf() resets the state (badbit if there is no buffer).
+    std::ios_base::iostate state = this->rdstate();
+    this->rdbuf( _buf.get() );
+    this->clear( state );
+}
+
+bool
+input_file::is_open() const noexcept
+{ return _buf != nullptr; }
+
+void
+input_file::close()
+{
+    this->rdbuf( nullptr );
+    _buf.reset();
+}
+
+const char*
+input_file::data() const noexcept
+{
+    if ( !_buf || _compression == compression::none ) { return nullptr; }
+    return static_cast<const memory_buf*>( _buf.get() )->contents().data();
+}
+
+std::size_t
+input_file::size() const noexcept
+{
+    if ( !_buf || _compression == compression::none ) { return 0; }
+    return static_cast<const memory_buf*>( _buf.get() )->contents().size();
+}
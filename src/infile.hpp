@@ -0,0 +1,123 @@
+#ifndef __NGPT_INFILE_HPP__
+#define __NGPT_INFILE_HPP__
+
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <vector>
+
+/**
+ * \file
+ *
+ * \version
+ *
+ * \author    xanthos@mail.ntua.gr <br>
+ *            danast@mail.ntua.gr
+ *
+ * \date
+ *
+ * \brief     An input file stream, transparently decompressing gzip and Unix
+ *            compress (.Z) files.
+ *
+ * \copyright Copyright © 2015 Dionysos Satellite Observatory, <br>
+ *            National Technical University of Athens. <br>
+ *            This work is free. You can redistribute it and/or modify it under
+ *            the terms of the Do What The Fuck You Want To Public License,
+ *            Version 2, as published by Sam Hocevar. See http://www.wtfpl.net/
+ *            for more details.
+ *
+ * <b><center><hr>
+ * National Technical University of Athens <br>
+ *      Dionysos Satellite Observatory     <br>
+ *        Higher Geodesy Laboratory        <br>
+ *      http://dionysos.survey.ntua.gr
+ * <hr></center></b>
+ *
+ */
+
+namespace ngpt
+{
+
+/// Compression of an (input) file, as detected off its first (magic) bytes.
+enum class compression : char {
+    none, ///< Plain file
+    gzip, ///< gzip (.gz), magic 0x1f 0x8b; needs zlib
+    lzw   ///< Unix compress (.Z), magic 0x1f 0x9d
+};
+
+/// Detect the compression of a file, off its magic bytes.
+compression detect_compression(const char* filename);
+
+/// Decompress a (whole) file of the given compression, appending to out.
+int decompress(const char* filename, compression type, std::vector<char>& out);
+
+/*
+ * \class   input_file
+ *
+ * \details A (seekable) input stream over a file, usable in place of an
+ *          std::ifstream. Plain files are read through a std::filebuf.
+ *          Compressed files (gzip or Unix compress, detected by their magic
+ *          bytes, not their extension) are decompressed in-process into
+ *          memory as the instance is constructed; the stream then reads (and
+ *          seeks) off the decompressed contents. No temporary file is ever
+ *          written.
+ *
+ * \note    gzip support depends on zlib (both the library and zlib.h) being
+ *          available at build time; Unix compress (LZW) decoding is always
+ *          available.
+ */
+class input_file : public std::istream
+{
+public:
+    /// Constructor from filename; on failure (cannot open or decompress the
+    /// file), the instance is not open (see is_open()).
+    explicit input_file(const char* filename,
+                        std::ios_base::openmode mode = std::ios_base::in);
+
+    /// Destructor.
+    ~input_file() noexcept;
+
+    /// Copy not allowed !
+    input_file(const input_file&) = delete;
+
+    /// Assignment not allowed !
+    input_file& operator=(const input_file&) = delete;
+
+    /// Move constructor.
+    input_file(input_file&&);
+
+    /// Move assignment operator.
+    input_file& operator=(input_file&&);
+
+    /// Swap with another instance (stream state and buffer).
+    void swap(input_file&);
+
+    /// Is the stream open (i.e. was the file opened/decompressed ok)?
+    bool is_open() const noexcept;
+
+    /// Close the stream (releasing any decompressed contents).
+    void close();
+
+    /// The compression of the underlying file.
+    compression compressed() const noexcept { return _compression; }
+
+    /// The (decompressed) contents of a compressed file, in memory; nullptr
+    /// for plain files.
+    const char* data() const noexcept;
+
+    /// Size of the (decompressed) contents in memory; 0 for plain files.
+    std::size_t size() const noexcept;
+
+private:
+    /// Re-attach the stream to _buf, keeping the stream state.
+    void attach();
+
+    std::unique_ptr<std::streambuf> _buf;  ///< A std::filebuf or an in-memory
+    ///< buffer (compressed files).
+    compression                     _compression; ///< Compression of the file.
+
+}; // end input_file
+
+} // end ngpt
+
+#endif
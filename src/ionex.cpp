@@ -4,8 +4,14 @@
 #include <stdexcept>
 #include <cstring>
 #include <algorithm>
+#include <limits>
 #include "ionex.hpp"
+#include "binfmt.hpp"
 #include "grid.hpp"
+#include "ionex_cursor.hpp"
+#include "mmfile.hpp"
+#include "i5decode.hpp"
+#include "bilinear.hpp"
 
 #ifdef DEBUG
     #include <iostream>
@@ -37,8 +43,29 @@ constexpr std::size_t MAX_TEC_PER_LINE { 16 };
 /// Max header lines.
 constexpr int MAX_HEADER_LINES { 1000 };
 
+/// First bytes of a binary (IONEX) cache file.
+constexpr char IONEX_CACHE_MAGIC[8] { 'N', 'G', 'P', 'T', 'I', 'N', 'X', 'C' };
+
+/// Version of the binary cache layout; bump on any change.
+constexpr std::uint32_t IONEX_CACHE_VERSION { 1 };
+
+/// Sections (i.e. epochs and cubes) of a binary cache file start at multiples
+/// of this (bytes).
+constexpr std::size_t IONEX_CACHE_ALIGN { 64 };
+
+/// Marks the end of a whole-grid region (see ionex::load_region()).
+constexpr std::size_t WHOLE_GRID { std::numeric_limits<std::size_t>::max() };
+
+/// Marks a map level with no missing values (see ionex::validity()).
+constexpr std::size_t NO_MASK { std::numeric_limits<std::size_t>::max() };
+
 /// ionex constructor
 ngpt::ionex::ionex(const char* filename)
+    : ionex(filename, true)
+{}
+
+/// ionex constructor; if index is false, the maps are not indexed.
+ngpt::ionex::ionex(const char* filename, bool index)
     : _filename(filename),
       _istream (filename, std::ios::in),
       _version (ionex_version::v10),
@@ -54,12 +81,29 @@ ngpt::ionex::ionex(const char* filename)
       _hgt1(0), _hgt2(0), _dhgt(0),
       _lat1(0), _lat2(0), _dlat(0),
       _lon1(0), _lon2(0), _dlon(0),
-      _exp(-1)
+      _exp(-1),
+      _cache(nullptr),
+      _region{0, WHOLE_GRID, 0, WHOLE_GRID},
+      _snapshot(std::make_shared<const map_snapshot>()),
+      _indexed(false)
 {
     if ( !_istream.is_open() ) {
         throw std::runtime_error 
             ("Cannot open ionex file: " + std::string(filename) );
     }
+
+    // a binary cache file? if so, map it and do nothing else (caches are
+    // never compressed).
+    char magic[sizeof(IONEX_CACHE_MAGIC)] = {};
+    _istream.read(magic, sizeof(magic));
+    if ( _istream.compressed() == compression::none
+        && _istream.gcount() == sizeof(magic)
+        && !std::memcmp(magic, IONEX_CACHE_MAGIC, sizeof(magic)) ) {
+        _istream.close();
+        this->read_cache();
+        return;
+    }
+    _istream.clear();
 #ifdef DEUG
     try {
         this->read_header();
@@ -69,6 +113,10 @@ ngpt::ionex::ionex(const char* filename)
 #endif
     if ( this->read_header() ) {
           if ( _istream.is_open() ) { _istream.close(); }
+    } else {
+        // publish the header fields, even if indexing fails.
+        this->publish( std::make_shared<map_snapshot>() );
+        if ( index ) { this->index_maps(); }
     }
 }
 
@@ -111,6 +159,107 @@ _read_ionex_datetime_(char* c, ionex::datetime_ms* d)
     }
 }
 
+/// [Help function] Get the next record (i.e. line) of a memory-mapped file,
+/// starting at cur. At exit, the record is [line, line+len), without the line
+/// terminator ("\n" or "\r\n"), and cur is set at the begining of the next
+/// record. Returns false if there are no more records.
+inline bool
+_next_record_(const char*& cur, const char* end,
+              const char*& line, std::size_t& len)
+noexcept
+{
+    if ( cur >= end ) { return false; }
+    const char* eol = static_cast<const char*>
+                        ( std::memchr(cur, '\n', end-cur) );
+    if ( !eol ) { eol = end; }
+    line = cur;
+    len  = eol - cur;
+    if ( len && line[len-1] == '\r' ) { --len; }
+    cur  = ( eol < end ) ? eol + 1 : end;
+    return true;
+}
+
+/// [Help function] Check if a record (of len chars) is labeled (at column 61)
+/// with the given label.
+inline bool
+_has_label_(const char* line, std::size_t len, const char* label,
+            std::size_t label_len)
+noexcept
+{ return len >= 60+label_len && !std::strncmp(line+60, label, label_len); }
+
+/// [Help function] Decode a right-justified, fixed-width integer field (e.g.
+/// I5, I6) in place, i.e. without the need of a null-terminated string.
+/// A return status other than 0 denotes an error (e.g. a blank field).
+inline int
+_read_fixed_int_(const char* c, std::size_t width, long& val)
+noexcept
+{
+    std::size_t i = 0;
+    while ( i < width && c[i] == ' ' ) { ++i; }
+    bool negative = ( i < width && c[i] == '-' );
+    if ( negative ) { ++i; }
+    if ( i == width ) { return 1; }
+    long v = 0;
+    for ( ; i < width; ++i ) {
+        unsigned digit = static_cast<unsigned char>(c[i]) - '0';
+        if ( digit > 9 ) { return 1; }
+        v = v*10 + digit;
+    }
+    val = negative ? -v : v;
+    return 0;
+}
+
+/// [Help function] Decode a fixed-width F<width>.1 field (e.g. a latitude) in
+/// place, to (integer) tenths; i.e. "  87.5" is decoded to 875.
+/// A return status other than 0 denotes an error.
+inline int
+_read_fixed_tenths_(const char* c, std::size_t width, long& tenths)
+noexcept
+{
+    std::size_t i = 0;
+    while ( i < width && c[i] == ' ' ) { ++i; }
+    bool negative = ( i < width && c[i] == '-' );
+    if ( negative ) { ++i; }
+    long v = 0;
+    for ( ; i < width && c[i] != '.'; ++i ) {
+        unsigned digit = static_cast<unsigned char>(c[i]) - '0';
+        if ( digit > 9 ) { return 1; }
+        v = v*10 + digit;
+    }
+    // we should now be at the '.' followed by exactly one decimal
+    if ( i+2 != width ) { return 1; }
+    unsigned digit = static_cast<unsigned char>(c[i+1]) - '0';
+    if ( digit > 9 ) { return 1; }
+    v = v*10 + digit;
+    tenths = negative ? -v : v;
+    return 0;
+}
+
+/// [Help function] Read an ionex datetime formated as 6I6, in place (see
+/// _read_ionex_datetime_). A return status other than 0 denotes an error.
+int
+_read_fixed_ionex_datetime_(const char* c, ionex::datetime_ms* d)
+{
+    long fields[6];
+    for (int i=0; i<6; ++i) {
+        if ( _read_fixed_int_(c+6*i, 6, fields[i]) ) { return 1; }
+    }
+    try {
+        ionex::datetime_ms newd (ngpt::year{static_cast<int>(fields[0])},
+                                 ngpt::month{static_cast<int>(fields[1])},
+                                 ngpt::day_of_month{static_cast<int>(fields[2])},
+                                 ngpt::milliseconds{
+                                  (  fields[3]*60L*60L
+                                   + fields[4]*60L
+                                   + fields[5]) *1000L}
+                                 );
+        *d = newd;
+        return 0;
+    } catch (std::out_of_range& e) {
+        return 1;
+    }
+}
+
 /* Read an ionex header.
  *
  * \warning In DEBUG mode this will throw in case of an error.
@@ -234,7 +383,7 @@ ionex::read_header()
         {
             *(line+6) = '\0';
             _map_dimension = std::strtol(line, &end, 10);
-            if ( _map_dimension != 2 ) {
+            if ( _map_dimension != 2 && _map_dimension != 3 ) {
 #ifdef DEBUG
                 std::cerr <<"\n[DEBUG] Oh shit! This map-dimension is not supported";
                 std::cerr <<"\n        Need to add code bitch!";
@@ -344,87 +493,160 @@ const noexcept
 std::size_t
 ionex::longtitude_lines()
 const noexcept
+{
+    std::size_t vals = this->longtitude_points();
+    return vals / MAX_TEC_PER_LINE + (vals % MAX_TEC_PER_LINE > 0);
+}
+
+/**  Compute how many (TEC) values are recorded in a const-latitude map.
+ * 
+ *   \warning This function uses the fact that the (longtitude) grid is given
+ *   with a precision of 1e-1 degrees.
+ */ 
+std::size_t
+ionex::longtitude_points()
+const noexcept
 {
     long lon1 = static_cast<long>(_lon1 * 100);
     long lon2 = static_cast<long>(_lon2 * 100);
     long dlon = static_cast<long>(_dlon * 100);
     long vals = (lon2 - lon1) / dlon + 1;
     assert( vals > 0 );
-    long rows = vals / MAX_TEC_PER_LINE + (vals % MAX_TEC_PER_LINE > 0);
-    return static_cast<std::size_t>( rows );
+    return static_cast<std::size_t>( vals );
+}
+
+/**  Compute the number of heights in every map; 1 for 2d maps.
+ *
+ *   \warning This function uses the fact that the (height) grid is given
+ *   with a precision of 1e-1 km.
+ */
+std::size_t
+ionex::height_levels()
+const noexcept
+{
+    if ( _map_dimension != 3 || _dhgt == 0 ) { return 1; }
+    long levels = std::lround((_hgt2 - _hgt1) / _dhgt) + 1;
+    assert( levels > 0 );
+    return static_cast<std::size_t>( levels );
 }
 
+namespace
+{
+/// The records starting and ending a map of each type; indexed by
+/// ionex::index_of(type).
+struct map_labels
+{
+    const char* start;
+    std::size_t start_len;
+    const char* end;
+    std::size_t end_len;
+};
+
+const map_labels MAP_LABELS[] = {
+    { "START OF TEC MAP",    16, "END OF TEC MAP",    14 },
+    { "START OF RMS MAP",    16, "END OF RMS MAP",    14 },
+    { "START OF HEIGHT MAP", 19, "END OF HEIGHT MAP", 17 }
+};
+
+/// [Help function] Is the record a "START OF TEC/RMS/HEIGHT MAP"? If so, set
+/// the map type.
+bool
+_map_start_(const char* line, std::size_t len, ionex::map_type& t) noexcept
+{
+    for (std::size_t i=0; i<sizeof(MAP_LABELS)/sizeof(MAP_LABELS[0]); ++i) {
+        if ( _has_label_(line, len, MAP_LABELS[i].start,
+                         MAP_LABELS[i].start_len) ) {
+            t = static_cast<ionex::map_type>(i);
+            return true;
+        }
+    }
+    return false;
+}
+}
+
+constexpr std::size_t ionex::MAP_TYPES;
+
 /**  Skip a whole map. The buffer should be placed in a position such that the
  *   first line to be read is: "LAT/LON1/LON2/H". After the function has
- *   returned, the buffer should be placed after the line: "END OF TEC MAP".
- *   The tec map is read, and absolutely nothing is done with it.
- *   By whole map, i mean all const-latitude maps for a given epoch.
+ *   returned, the buffer should be placed after the line: "END OF <type> MAP".
+ *   The map is read, and absolutely nothing is done with it (other than
+ *   validating the latitude and height of every const-latitude map).
+ *   By whole map, i mean all const-latitude maps (of all heights) for a given
+ *   epoch.
  *
  *   \returns An integer denoting the exit status; anything other than 0, 
  *            denotes failure.
  */
 int
-ionex::skip_tec_map()
+ionex::skip_map(map_type type)
 {
-    static char line [MAX_HEADER_CHARS];
+    char line [MAX_HEADER_CHARS];
     char* c;
-    ionex_grd_type lat = _lat1;
-    ionex_grd_type ltmp;
+    ionex_grd_type ltmp, htmp;
     // number of const-latitude lines.
     std::size_t num_of_tec_lines = this->longtitude_lines();
-    bool ascending ( _lat2 > _lat1 ? true : false );
+    // number of const-latitude maps.
+    std::size_t lat_maps = this->latitude_maps();
+    std::size_t levels   = this->height_levels();
+    const map_labels& labels = MAP_LABELS[index_of(type)];
     
-    while ( _istream.getline(line, MAX_HEADER_CHARS) ) {
-        // next line should be 'LAT/LON1/LON2/DLON/H'
-        if ( std::strncmp(line+60, "LAT/LON1/LON2/DLON/H", 20) ) {
+    for (std::size_t h=0; h<levels; ++h) {
+        ionex_grd_type hgt = _hgt1 + h*_dhgt;
+        ionex_grd_type lat = _lat1;
+        for (std::size_t m=0;
+             m<lat_maps && _istream.getline(line, MAX_HEADER_CHARS);
+             ++m) {
+            // next line should be 'LAT/LON1/LON2/DLON/H'
+            if ( std::strncmp(line+60, "LAT/LON1/LON2/DLON/H", 20) ) {
 #ifdef DEBUG
-            std::cerr<<"\n[DEBUG] Error reading TEC map 'LAT/LON1/LON2/DLON/H'";
-            std::cerr<<"\n        found line: " << line;
-            throw std::runtime_error
-            ("ionex::skip_tec_map() -> Invalid line");
+                std::cerr<<"\n[DEBUG] Error reading map 'LAT/LON1/LON2/DLON/H'";
+                std::cerr<<"\n        found line: " << line;
+                throw std::runtime_error
+                ("ionex::skip_map() -> Invalid line");
 #endif
-            return 1;
-        }
-        // read and validate the current latitude
-        ltmp = std::strtof(line+2, &c);
-        if ( (int)(ltmp*100) != (int)(lat*100) ) {
+                return 1;
+            }
+            // read and validate the current latitude and height
+            ltmp = std::strtof(line+2, &c);
+            htmp = std::strtof(line+26, &c);
+            if (   (int)(ltmp*100) != (int)(lat*100)
+                || std::lround(htmp*10) != std::lround(hgt*10) ) {
 #ifdef DEBUG
-            std::cerr<<"\n[DEBUG]What the fuck man! Read invalid latitude.";
-            std::cerr<<"\n       Expected: "<<lat<<", found: "<<ltmp;
-            throw std::runtime_error("ionex::skip_tec_map() -> Invalid latitude");
+                std::cerr<<"\n[DEBUG]What the fuck man! Read invalid lat/hgt.";
+                std::cerr<<"\n       Expected: "<<lat<<"/"<<hgt<<", found: "
+                         <<ltmp<<"/"<<htmp;
+                throw std::runtime_error("ionex::skip_map() -> Invalid latitude");
 #endif
-            return 1;
-        } else {
-        }
+                return 1;
+            }
 
-        // ok, now we should read these fucking TEC vals; format: I5 max 16 values
-        // per line.
-        for (std::size_t i=0; i<num_of_tec_lines; ++i) {
-            if ( !_istream.getline(line, MAX_HEADER_CHARS) ) {
+            // ok, now we should read these fucking vals; format: I5 max 16
+            // values per line.
+            // no need to copy the lines anywhere; just skip them.
+            for (std::size_t i=0; i<num_of_tec_lines; ++i) {
+                if ( !_istream.ignore(std::numeric_limits<std::streamsize>::max(),
+                                      '\n') ) {
 #ifdef DEBUG
-                std::cerr<<"\n[DEBUG] Fucking weird! Failed to read tec map!";
-                throw std::runtime_error("ionex::skip_tec_map() -> Invalid line");
+                    std::cerr<<"\n[DEBUG] Fucking weird! Failed to read map!";
+                    throw std::runtime_error("ionex::skip_map() -> Invalid line");
 #endif
-                return 1;
+                    return 1;
+                }
             }
-        }
 
-        // did we end yet (better compare ints than floats)?
-        lat += _dlat;
-        if ( ascending == ((long)(lat*100)>=(long)(_lat2*100)) ) {
-            break;
+            lat += _dlat;
         }
     }
 
-    // should now read 'END OF TEC MAP'
+    // should now read 'END OF <type> MAP'
     if (  !_istream.getline(line, MAX_HEADER_CHARS)
-        ||std::strncmp(line+60, "END OF TEC MAP", 14) )
+        ||std::strncmp(line+60, labels.end, labels.end_len) )
     {
 #ifdef DEBUG
-        std::cerr<<"\n[DEBUG] Expected \"END OF TEC MAP\" but found:";
+        std::cerr<<"\n[DEBUG] Expected \""<<labels.end<<"\" but found:";
         std::cerr<<"\n        "<<line;
         throw std::runtime_error
-            ("ionex::skip_tec_map() -> Invalid line");
+            ("ionex::skip_map() -> Invalid line");
 #endif
             return 1;
     }
@@ -433,37 +655,38 @@ ionex::skip_tec_map()
     return 0;
 }
 
-/** Read a TEC map for a given epoch. All values are going to be read into the
- *  vector tec_vals, at the order they are read. This means that the vector
- *  will be of the form (at exit):
+/** Read a map (of any type) for a given epoch. All values are going to be
+ *  read into the array vals, at the order they are read. This means that the
+ *  array will be of the form (at exit):
 \verbatim
-    vec[0]   tec value at -> lat1, lon1
-    vec[1]   tec value at -> lat1, lon1+dlon
-    vec[2]   tec value at -> lat1, lon1+2*dlon
+    vals[0]   value at -> hgt1, lat1, lon1
+    vals[1]   value at -> hgt1, lat1, lon1+dlon
+    vals[2]   value at -> hgt1, lat1, lon1+2*dlon
     ...
-    vec[n]   tec value at -> lat1+dlat,   lon1
-    vec[n+1] tec value at -> lat1+2*dlat, lon1+dlon
+    vals[n]   value at -> hgt1, lat1+dlat,   lon1
+    vals[n+1] value at -> hgt1, lat1+dlat, lon1+dlon
+    ...
+    vals[k]   value at -> hgt1+dhgt, lat1, lon1
     ...
 \endverbatim
- *  The function will stop after rading the line: 'END OF TEC MAP'.
+ *  The function will stop after rading the line: 'END OF <type> MAP'.
  *
- *  \param[in] pcv_vals An int vector of size large enough to hold all tec
- *             values to be read from the map.
+ *  \param[in] type The type of the map (only used to validate the end record).
+ *  \param[in] vals An array large enough to hold all values of the map (i.e.
+ *             map_size()).
  *
  *  \returns An integer denoting the exit status; everything other than 0,
  *           denotes an error.
  *
  *  \warning -# The buffer should be placed in a position such that the next line
  *           to be read is "LAT/LON1/LON2/DLON/H".
- *           -# The size of the vector should be large enough to hold the read
- *           values. The size of the vector will not be modified at any way.
- *           -# Note that the get the actual TEC values from the values stored
- *           in the vector, you will need to use the IONEX's exponent.
+ *           -# Note that the get the actual values from the values stored
+ *           in the array, you will need to use the IONEX's exponent.
  */
 int
-ionex::read_tec_map(std::vector<int>& pcv_vals)
+ionex::read_map(map_type type, ionex_raw_type* vals)
 {
-    static char line[MAX_HEADER_CHARS];
+    char line[MAX_HEADER_CHARS];
 
     // stream should definitely be open!
     // TODO move this somewhere else. don't fucking need to always check.
@@ -471,30 +694,48 @@ ionex::read_tec_map(std::vector<int>& pcv_vals)
     
     std::size_t index = 0;
     
-    // how many consti-latitude maps should we read ?
+    // how many consti-latitude maps should we read (per height) ?
     std::size_t lat_maps  (this->latitude_maps() );
-    // each const-latitude map has how many tec lines ?
+    // each const-latitude map has how many lines ?
     std::size_t lon_lines (this->longtitude_lines() );
+    std::size_t levels    (this->height_levels() );
+    const map_labels& labels = MAP_LABELS[index_of(type)];
 
     // reset errno
     int prev_errno = errno;
     errno = 0;
 
-    for (std::size_t i=0; i<lat_maps; ++i) {
-        if ( this->read_latitude_map(lon_lines, pcv_vals, index) ) {
-            errno = prev_errno;
-            return 1;
+    for (std::size_t h=0; h<levels; ++h) {
+        for (std::size_t i=0; i<lat_maps; ++i) {
+            // outside the region; skip the 'LAT/LON1/LON2/DLON/H' line and
+            // all value lines.
+            if ( !this->in_region_band(i) ) {
+                for (std::size_t l=0; l<=lon_lines; ++l) {
+                    if ( !_istream.ignore(std::numeric_limits<std::streamsize>::max(),
+                                          '\n') ) {
+                        errno = prev_errno;
+                        return 1;
+                    }
+                }
+                index += this->longtitude_points();
+                continue;
+            }
+            if ( this->read_latitude_map(lon_lines, vals, index,
+                                         _hgt1 + h*_dhgt) ) {
+                errno = prev_errno;
+                return 1;
+            }
         }
     }
     
-    // should now read 'END OF TEC MAP'
+    // should now read 'END OF <type> MAP'
     if ( ! _istream.getline(line, MAX_HEADER_CHARS)
-        || std::strncmp(line+60, "END OF TEC MAP", 14) ) {
+        || std::strncmp(line+60, labels.end, labels.end_len) ) {
 #ifdef DEBUG
-        std::cerr<<"\n[DEBUG] Expected \"END OF TEC MAP\" but found:";
+        std::cerr<<"\n[DEBUG] Expected \""<<labels.end<<"\" but found:";
         std::cerr<<"\n        "<<line;
         throw std::runtime_error
-            ("ionex::read_tec_map() -> Invalid line");
+            ("ionex::read_map() -> Invalid line");
 #endif
             errno = prev_errno;
             return 1;
@@ -503,22 +744,24 @@ ionex::read_tec_map(std::vector<int>& pcv_vals)
     return 0;
 }
 
-/** Read a TEC map (for a given latitude) off from the stream and store the
- *  values in the vec vector, starting at vec[index]. The function will modify
- *  the index value, such that at return it will denote the last index inserted
- *  into the vector plus one.
+/** Read a map (for a given latitude and height) off from the stream and store
+ *  the values in the vals array, starting at vals[index]. The function will
+ *  modify the index value, such that at return it will denote the last index
+ *  inserted into the array plus one.
  *
  *  \param[in] num_of_tec_lines The number of lines to read off from a const
  *                              latitude map.
- *  \param[in] vec              The (int) vector where read values are stored.
+ *  \param[in] vals             The array where read values are stored.
  *                              This function will start storing values at
- *                              vec[index].
- *  \param[in] index            Where to start storing tec values within the
- *                              input vec vector.
+ *                              vals[index].
+ *  \param[in] index            Where to start storing values within the
+ *                              input vals array.
  *                              At exit, this will be set to the first non-set
  *                              element (i.e. if index was 0 at input and the
  *                              function reads and assigns 10 elements, index
  *                              at output will be 10).
+ *  \param[in] hgt              The height this const-latitude map should be
+ *                              recorded for.
  * 
  *  \warning -# The buffer should be placed in a position such that the next line
  *           to be read is "LAT/LON1/LON2/DLON/H".
@@ -529,14 +772,14 @@ ionex::read_tec_map(std::vector<int>& pcv_vals)
  */ 
 int
 ionex::read_latitude_map(std::size_t num_of_tec_lines,
-                         std::vector<int>& vec,
-                         std::size_t& index)
+                         ionex_raw_type* vals,
+                         std::size_t& index,
+                         ionex_grd_type hgt)
 {
-    static char line [MAX_HEADER_CHARS];
-    datetime_ms d;
+    char line [MAX_HEADER_CHARS];
     char* start, *end;
-    ionex_grd_type lat, lon1, lon2, dlon, hgt;
-    long lval;
+    ionex_grd_type lat, lon1, lon2, dlon, h;
+    std::size_t left = this->longtitude_points();
     int  prev_errno = errno;
     errno = 0;
     
@@ -546,7 +789,7 @@ ionex::read_latitude_map(std::size_t num_of_tec_lines,
     {
         errno = prev_errno;
 #ifdef DEBUG
-        std::cerr<<"\n[DEBUG] Error reading TEC map 'LAT/LON1/LON2/DLON/H'";
+        std::cerr<<"\n[DEBUG] Error reading map 'LAT/LON1/LON2/DLON/H'";
         std::cerr<<"\n        found line: " << line;
         throw std::runtime_error
         ("ionex::read_map() -> Invalid line");
@@ -563,203 +806,1006 @@ ionex::read_latitude_map(std::size_t num_of_tec_lines,
     start += 6;
     dlon = std::strtof(start, &end);
     start += 6;
-    hgt  = std::strtof(start, &end);
+    h    = std::strtof(start, &end);
 #ifdef DEBUG
-    if ( lon1!=_lon1 || lon2!=_lon2 || dlon!=_dlon || hgt != _hgt1 ) {
+    if ( lon1!=_lon1 || lon2!=_lon2 || dlon!=_dlon
+        || std::lround(h*10) != std::lround(hgt*10) ) {
         errno = prev_errno;
         std::cerr << "\n[DEBUG] Oh Fuck! this longtitude seems corrupt!";
         std::cerr << "\n        line: " << line;
         std::string lat_str = std::to_string(lat);
         throw std::runtime_error("ionex::read_map() -> Invalid line ("+lat_str+")");
     }
+#else
+    (void)lat; (void)lon1; (void)lon2; (void)dlon; (void)h; (void)hgt;
 #endif
 
-    // ok, now we should read these fucking TEC vals; format: I5 max 16 values
-    // per line.
+    // ok, now we should read these fucking vals; format: I5 max 16 values
+    // per line. Decode them right into place (lines outside the region are
+    // skipped).
     for (std::size_t i=0; i<num_of_tec_lines; ++i) {
+        std::size_t n = std::min(left, MAX_TEC_PER_LINE);
+        if ( !this->in_region_line(i) ) {
+            if ( !_istream.ignore(std::numeric_limits<std::streamsize>::max(),
+                                  '\n') ) {
+                errno = prev_errno;
+                return 1;
+            }
+            index += n;
+            left  -= n;
+            continue;
+        }
         if ( !_istream.getline(line, MAX_HEADER_CHARS) ) {
             errno = prev_errno;
 #ifdef DEBUG
-            std::cerr<<"\n[DEBUG] Fucking weird! Failed to read tec map!";
+            std::cerr<<"\n[DEBUG] Fucking weird! Failed to read map!";
+            throw std::runtime_error("ionex::read_map() -> Invalid line");
+#endif
+            return 1;
+        }
+        if ( ngpt::decode_i5_line(line, std::strlen(line), n, vals+index) ) {
+            errno = prev_errno;
+#ifdef DEBUG
+            std::cerr<<"\n[DEBUG] Fuck! Reading map values failed!";
             throw std::runtime_error("ionex::read_map() -> Invalid line");
 #endif
             return 1;
         }
-        start = end = line;
-        for (lval = std::strtol(start, &end, 10);
-             start != end;
-             lval = std::strtol(start, &end, 10) )
+        index += n;
+        left  -= n;
+    }
+
+    // all done probably correctly.
+    errno = prev_errno;
+    return 0;
+}
+
+/** Build the map index, i.e. record the position (within the file) of every
+ *  map, of any type (i.e. of every "START OF TEC/RMS/HEIGHT MAP" record) and
+ *  the epoch of every TEC map (the "EPOCH OF CURRENT MAP" following it). The
+ *  file body is read once, without decoding any value; after that, any map
+ *  can be reached with a single seek (see seek_map()).
+ *  The file must hold exactly "# OF MAPS IN FILE" TEC maps; RMS and height
+ *  maps are optional, but if present they must be recorded for the same
+ *  epochs as the TEC maps.
+ *
+ *  \returns An integer denoting the exit status; anything other than 0 
+ *           denotes failure. In this case the index is left empty.
+ */
+int
+ionex::index_maps()
+{
+    auto snap = std::make_shared<map_snapshot>();
+    std::vector<datetime_ms> epochs [MAP_TYPES];
+
+    if ( this->scan_maps(_end_of_head, snap->offsets, epochs)
+        || this->check_maps(snap->offsets, epochs) ) {
+        return 1;
+    }
+
+    snap->epochs = std::move( epochs[index_of(map_type::tec)] );
+    this->publish( std::move(snap) );
+    _indexed = true;
+    return 0;
+}
+
+/** Set the fields of a new snapshot that follow off the header and publish
+ *  it, i.e. atomically replace the instance's snapshot. Readers holding the
+ *  previous snapshot keep using it; it is freed once the last one drops it.
+ */
+void
+ionex::publish(std::shared_ptr<map_snapshot> snap)
+{
+    snap->last_epoch = _last_epoch;
+    snap->map_size   = this->map_size();
+    snap->levels     = this->height_levels();
+    snap->lon_points = this->longtitude_points();
+    std::copy(_region, _region+4, snap->region);
+    std::atomic_store( &_snapshot,
+                       std::shared_ptr<const map_snapshot>(std::move(snap)) );
+}
+
+/** Walk the file from the given position on, until 'END OF FILE' (or the
+ *  actual end of file), recording the offset and epoch of every map; these are
+ *  appended to the given (per-type) vectors.
+ *
+ *  \returns An integer denoting the exit status; anything other than 0
+ *           denotes failure.
+ */
+int
+ionex::scan_maps(pos_type from, std::vector<pos_type>* offsets,
+                 std::vector<datetime_ms>* epochs)
+{
+    char line[MAX_HEADER_CHARS];
+    datetime_ms cur_dt;
+    pos_type pos;
+    map_type type = map_type::tec;
+
+    _istream.seekg(from, std::ios::beg);
+
+    // read on until 'END OF FILE' (or the actual end of file).
+    while ( (pos = _istream.tellg()) >= 0
+            && _istream.getline(line, MAX_HEADER_CHARS) ) {
+        std::size_t len = std::strlen(line);
+        if ( _has_label_(line, len, "END OF FILE", 11) ) { break; }
+        if ( !_map_start_(line, len, type)
+            || !_istream.getline(line, MAX_HEADER_CHARS)
+            || std::strncmp(line+60, "EPOCH OF CURRENT MAP", 20) 
+            || _read_ionex_datetime_(line, &cur_dt)
+            || this->skip_map(type) )
         {
-            vec[index] = static_cast<int>( lval );
-            ++index;
-            start = end;
+#ifdef DEBUG
+            std::cerr<<"\n[DEBUG] Failed indexing map nr "
+                     <<offsets[index_of(type)].size()+1;
+            throw std::runtime_error
+                ("ionex::index_maps() -> failed reading maps.");
+#endif
+            _istream.clear();
+            return 1;
         }
+        offsets[index_of(type)].push_back( pos );
+        epochs [index_of(type)].push_back( cur_dt );
     }
+    _istream.clear();
+    return 0;
+}
 
-    // check for transformation errors!
-    if ( errno ) {
-        errno = prev_errno;
+/** There must be as many TEC maps as stated in the header; RMS and height
+ *  maps are optional, but if present they must be recorded for the same
+ *  epochs as the TEC maps.
+ *
+ *  \returns An integer denoting the exit status; anything other than 0
+ *           denotes failure.
+ */
+int
+ionex::check_maps(const std::vector<pos_type>* offsets,
+                  const std::vector<datetime_ms>* epochs)
+const
+{
+    const auto& tec_epochs = epochs[index_of(map_type::tec)];
+    for (std::size_t t=0; t<MAP_TYPES; ++t) {
+        if (  (t == index_of(map_type::tec) || !offsets[t].empty())
+            && ( offsets[t].size() != _maps_in_file
+                || !std::equal(epochs[t].cbegin(), epochs[t].cend(),
+                               tec_epochs.cbegin()) ) )
+        {
 #ifdef DEBUG
-        std::cerr<<"\n[DEBUG] Fuck! Reading tec values failed!";
-        throw std::runtime_error("ionex::read_map() -> Invalid line");
+            std::cerr<<"\n[DEBUG] Expected "<<_maps_in_file<<" "
+                     <<MAP_LABELS[t].start+9<<"s, found "<<offsets[t].size();
+            throw std::runtime_error
+                ("ionex::index_maps() -> invalid number of maps.");
+#endif
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/// All maps indexed in the snapshot, sorted by their position in the file;
+/// reading them in this order means reading the file sequentially.
+std::vector<std::pair<ionex::map_type, std::size_t>>
+ionex::maps_in_file_order(const map_snapshot& snap)
+const
+{
+    std::vector<std::pair<map_type, std::size_t>> maps;
+    for (std::size_t t=0; t<MAP_TYPES; ++t) {
+        for (std::size_t i=0; i<snap.offsets[t].size(); ++i) {
+            maps.emplace_back( static_cast<map_type>(t), i );
+        }
+    }
+    std::sort(maps.begin(), maps.end(),
+        [&snap](const std::pair<map_type, std::size_t>& a,
+                const std::pair<map_type, std::size_t>& b)
+        { return snap.offsets[index_of(a.first)][a.second]
+               < snap.offsets[index_of(b.first)][b.second]; });
+    return maps;
+}
+
+/** Position the stream at the begining of the map of the given type, with
+ *  index map_num (as recorded in the map index). The "START OF <type> MAP" and
+ *  "EPOCH OF CURRENT MAP" records are read (and validated), so that at exit
+ *  the next line to be read is "LAT/LON1/LON2/DLON/H". If the stream is
+ *  already at the map (e.g. when reading maps sequentially), no seek is
+ *  performed.
+ *
+ *  \returns An integer denoting the exit status; anything other than 0 
+ *           denotes failure.
+ */
+int
+ionex::seek_map(const map_snapshot& snap, map_type type, std::size_t map_num)
+{
+    char line[MAX_HEADER_CHARS];
+    datetime_ms cur_dt;
+    const auto& offsets = snap.offsets[index_of(type)];
+    const map_labels& labels = MAP_LABELS[index_of(type)];
+
+    if ( map_num >= offsets.size() ) { return 1; }
+
+    _istream.clear();
+    if ( _istream.tellg() != offsets[map_num] ) {
+        _istream.seekg(offsets[map_num], std::ios::beg);
+    }
+    if ( !_istream.getline(line, MAX_HEADER_CHARS)
+        || std::strncmp(line+60, labels.start, labels.start_len)
+        || !_istream.getline(line, MAX_HEADER_CHARS)
+        || std::strncmp(line+60, "EPOCH OF CURRENT MAP", 20) 
+        || _read_ionex_datetime_(line, &cur_dt)
+        || !(cur_dt == snap.epochs[map_num]) )
+    {
+#ifdef DEBUG
+        std::cerr<<"\n[DEBUG] Map nr "<<map_num<<" not found at indexed position.";
+        std::cerr<<"\n        "<<line;
+        throw std::runtime_error
+            ("ionex::seek_map() -> Invalid line!");
 #endif
         return 1;
     }
+    return 0;
+}
 
-    // all done probably correctly.
+/** Decode all maps recorded in the instance into memory. The maps of each type
+ *  (TEC and, if present, RMS and height) are stored in a contiguous cube of
+ *  raw values, i.e. cubes[type][epoch][hgt][lat][lon] (published as a new
+ *  snapshot, see map_snapshot). All maps are visited
+ *  in the order they are recorded, so the file is read in a single sequential
+ *  pass whatever the types it holds. To get the actual values, the instance's
+ *  exponent must be used.
+ *  After a successful call, all queries are served off the cubes, i.e. the
+ *  file is never parsed again. Calling the function on an already loaded
+ *  instance does nothing.
+ *
+ *  \returns An integer denoting the exit status; anything other than 0
+ *           denotes failure (e.g. the maps could not be indexed at
+ *           construction, as for a truncated file). In this case, the
+ *           instance is left unloaded.
+ *
+ *  \warning Raw values must fit in an ionex_raw_type (int16); this holds
+ *           for all IGS products (max value 9999 marking missing values).
+ */
+int
+ionex::load(reader_backend backend)
+{
+    const auto cur = this->snapshot();
+    if ( cur->is_loaded() && !cur->is_partial() ) { return 0; }
+
+    // (re)load the whole grid.
+    _region[0] = _region[2] = 0;
+    _region[1] = _region[3] = WHOLE_GRID;
+    if ( this->decode_maps(backend) ) {
+        // back to the region of the maps still published.
+        std::copy(cur->region, cur->region+4, _region);
+        return 1;
+    }
+    return 0;
+}
+
+/** Decode all maps (within the region set) into the cubes; see load() and
+ *  load_region().
+ */
+int
+ionex::decode_maps(reader_backend backend)
+{
+
+    // if the header was not read ok, the stream is closed.
+    if ( !_istream.is_open() ) { return 1; }
+
+    // the index must hold all (TEC) maps in the file; else indexing failed
+    // (e.g. a truncated file) and there is nothing (sound) to decode.
+    const auto cur = this->snapshot();
+    if (   !_indexed
+        || cur->offsets[index_of(map_type::tec)].size() != _maps_in_file ) {
+#ifdef DEBUG
+        std::cerr<<"\n[DEBUG] The maps of "<<_filename<<" are not indexed.";
+#endif
+        return 1;
+    }
+    std::vector<ionex_raw_type> cubes[MAP_TYPES];
+
+    if ( backend == reader_backend::mmap ) {
+        if ( this->load_mapped(*cur, cubes) ) { return 1; }
+    } else {
+        const std::size_t msize = this->map_size();
+        const ionex_raw_type fill = ( _region[1] != WHOLE_GRID )
+                                  ? IONEX_NO_VALUE : 0;
+        for (std::size_t t=0; t<MAP_TYPES; ++t) {
+            cubes[t].assign( cur->offsets[t].size() * msize, fill );
+        }
+        for (const auto& m : this->maps_in_file_order(*cur)) {
+            ionex_raw_type* out = cubes[index_of(m.first)].data()
+                                + m.second * msize;
+            if ( this->seek_map(*cur, m.first, m.second)
+                || this->read_map(m.first, out) )
+            {
+#ifdef DEBUG
+                std::cerr<<"\n[DEBUG] Failed reading map nr "<<m.second;
+                throw std::runtime_error
+                    ("ionex::load() -> failed reading maps.");
+#endif
+                _istream.clear();
+                return 1;
+            }
+        }
+    }
+
+    // same index, new maps.
+    auto snap = std::make_shared<map_snapshot>();
+    snap->epochs = cur->epochs;
+    for (std::size_t t=0; t<MAP_TYPES; ++t) {
+        snap->offsets[t] = cur->offsets[t];
+        snap->cubes[t] = std::move( cubes[t] );
+        snap->data[t] = snap->cubes[t].empty() ? nullptr : snap->cubes[t].data();
+    }
+    this->index_validity( *snap );
+    this->publish( std::move(snap) );
     return 0;
 }
 
-/** Extract TEC values for a given list of points, for all epochs included in 
- *  the IONEX instance, within the interval [from, to]; or all epochs if from
- *  and to are NULL. For example, if points holds (p1, p2, ..., pn2), then
- *  (on exit), the tec_vals will be formed as:
- *  tec_vals[0][0] -> tec at point p0, at epoch epoch_vector[0]
- *  tec_vals[0][1] -> tec at point p0, at epoch epoch_vector[1]
- *  ...
- *  tec_vals[0][m] -> tec at point p0, at epoch epoch_vector[m]
- *  tec_vals[1][0] -> tec at point p1, at epoch epoch_vector[0]
- *  tec_vals[1][1] -> tec at point p1, at epoch epoch_vector[1]
- *  ...
- *  tec_vals[1][m] -> tec at point p1, at epoch epoch_vector[m]
- *  ....
+/** Decode only the part of the maps needed to interpolate at the given points,
+ *  i.e. the const-latitude maps (bands) and the (16-value) lines spanned by
+ *  the grid cells of the points; bands and lines outside this region are
+ *  skipped unparsed (with either backend). All other values of the cubes are
+ *  set to 9999. For 3d maps, the region applies to every height level.
+ *  Calling the function on an instance already loaded for a region covering
+ *  the points (or for the whole grid) does nothing.
  *
- *  \param[in] points A vector of coordinates of type (longtitude, latitude)
- *                    in (decimal) degrees (two decimal places are considered)
- *  \param[in] epoch_vector This vector will contain (at exit) the epochs for
- *                    which the function computed TEC values.
- *  \param[in] tec_vals A vector of vectors of ints! For each point in points,
- *                    there will be a corresponding vector of ints in tec_vals
- *                    holding tec values at epoch_vector epochs.
- *  \returns          A vector of int vectors; for each point given, the function
- *                    will create for a vector of tec values for each epoch in the
- *                    epoch_vector
- *  \warning          All (input) vectors should be large enough to handle the
- *                    values assigned to them. Watch for junk if you pass vectors
- *                    of size larger that the number of epochs collected.
- * 
+ *  \returns An integer denoting the exit status; anything other than 0
+ *           denotes failure (e.g. a point is outside the grid). In this case,
+ *           the instance is left as it was.
+ *
+ *  \note    Partial instances cannot be written to a cache (see
+ *           write_cache()); interpolating at points outside the region throws.
  */
 int
-ionex::get_tec_at(const std::vector<std::pair<ionex_grd_type,ionex_grd_type>>& points,
-                std::vector<datetime_ms>& epoch_vector,
-                std::vector<std::vector<int>>& tec_vals,
-                datetime_ms* from,
-                datetime_ms* to
-                )
-{
-    // for every point we want, we must find an index for it (within the grid)
-    // so that we can extract it's value. Let's make a 2D grid. For ease, let's
-    // set the grid points to long (instead of ints) so that e.g. lat=37.5
-    // lon=23.7 will be 3750 and 2370; i.e. use of factor of 100.
-    int factor (100);
-#ifdef DEBUG
-    typedef ngpt::grid_skeleton<long, true, Grid_Dimension::TwoDim> gstype;
-    gstype grid(_lon1*factor, _lon2*factor, _dlon*factor,
-                _lat1*factor, _lat2*factor, _dlat*factor);
-#else
-    typedef grid_skeleton<long, false, Grid_Dimension::TwoDim> gstype;
-    gstype grid(_lon1*factor, _lon2*factor, _dlon*factor,
-                _lat1*factor, _lat2*factor, _dlat*factor);
+ionex::load_region(
+    const std::vector<std::pair<ionex_grd_type,ionex_grd_type>>& points,
+    reader_backend backend)
+{
+    // if the header was not read ok, the stream is closed.
+    if ( !_istream.is_open() || points.empty() ) { return 1; }
+
+    const std::size_t lon_pts = this->longtitude_points();
+    bilinear_batch stencil (_lon1, _dlon, lon_pts,
+                            _lat1, _dlat, this->latitude_maps());
+    std::vector<double> lon, lat;
+    lon.reserve( points.size() );
+    lat.reserve( points.size() );
+    for (const auto& p : points) {
+        lon.push_back( p.first );
+        lat.push_back( p.second );
+    }
+    if ( stencil.set_points(lon.data(), lat.data(), points.size()) ) {
+#ifdef DEBUG
+        std::cerr<<"\n[DEBUG] Region point outside the grid.";
+        throw std::runtime_error("ionex::load_region() -> point outside grid.");
 #endif
+        return 1;
+    }
 
-    if ( !from ) from = &this->_first_epoch;
-    if ( !to   ) to   = &this->_last_epoch;
+    // (inclusive) node range of all cells.
+    const auto cur = this->snapshot();
+    std::size_t region[4] { WHOLE_GRID, 0, WHOLE_GRID, 0 };
+    bool covered = cur->is_loaded();
+    for (std::size_t i=0; i<points.size(); ++i) {
+        std::size_t cell = stencil.cell_index(i);
+        covered = covered && cur->covers_cell(cell);
+        region[0] = std::min(region[0], cell / lon_pts);
+        region[1] = std::max(region[1], cell / lon_pts + 1);
+        region[2] = std::min(region[2], cell % lon_pts);
+        region[3] = std::max(region[3], cell % lon_pts + 1);
+    }
+    if ( covered ) { return 0; }
 
-    // for each point in the vector, we are going to need the surounding nodes 
-    // (so that we extract these values and interpolate).
-    typedef gstype::node gnode;
-    typedef std::tuple<gnode, gnode, gnode, gnode> cell;
-    std::vector<cell> cells;
-    cells.reserve( points.size() );
-    for ( auto const& i : points ) {
-        cells.push_back(grid.neighbor_nodes(i.first*factor, i.second*factor));
+    std::copy(region, region+4, _region);
+    if ( this->decode_maps(backend) ) {
+        // back to the region of the maps still published.
+        std::copy(cur->region, cur->region+4, _region);
+        return 1;
     }
+    return 0;
+}
 
-    // get me a vector large enough to hold a whole map
-    std::vector<int> tec_map (grid.size(), 0);
+/** Same as above, the region being the box with the given latitude and
+ *  longtitude limits (degrees); the box must lie within the grid.
+ */
+int
+ionex::load_region(ionex_grd_type lat_min, ionex_grd_type lat_max,
+                   ionex_grd_type lon_min, ionex_grd_type lon_max,
+                   reader_backend backend)
+{
+    return this->load_region({ {lon_min, lat_min}, {lon_min, lat_max},
+                               {lon_max, lat_min}, {lon_max, lat_max} },
+                             backend);
+}
 
-    // go to 'END OF HEADER'
-    char line[MAX_HEADER_CHARS];
-    _istream.seekg(_end_of_head, std::ios::beg);
-    std::size_t map_num = 0;
-    char* c;
-    //std::size_t eph_index = 0;
-    
-    if ( !_istream.getline(line, MAX_HEADER_CHARS) ) {
+/** Re-read the header of the file and, if it now records more maps, index and
+ *  (if the instance is loaded) decode only the new ones. This is meant for
+ *  products that are appended to, or rewritten, as new maps are published
+ *  (e.g. rapid/real-time GIMs): the file is re-opened (so a file replaced by
+ *  a new one is also picked up), the header is checked to describe the same
+ *  maps (grid, exponent, first epoch, interval) and the file is scanned from
+ *  the end of the last known TEC map on. All maps already known (and decoded)
+ *  are kept as they are; RMS/height maps, recorded after the TEC maps, are
+ *  re-indexed and only the new ones are decoded.
+ *  The new index and maps are built into a new snapshot (the known maps and
+ *  their validity masks copied off the current one), which is published only
+ *  on success, i.e. on failure the instance stays exactly as it was. Const
+ *  queries may run on other threads meanwhile; each reads the snapshot it
+ *  started off, which stays alive for as long as it is held. Cursors and
+ *  slant_tec engines constructed before the call keep their snapshot (i.e.
+ *  never see the new maps); those constructed after it see the new maps.
+ *
+ *  \returns An integer denoting the exit status; anything other than 0
+ *           denotes failure (e.g. the header now describes different maps,
+ *           or the known maps have changed). In this case, construct a new
+ *           instance instead.
+ *
+ *  \throw   std::runtime_error if the file cannot be (re-)opened.
+ *
+ *  \warning Cached (binary) instances cannot be refreshed. Calls changing
+ *           the instance (e.g. refresh() and load()) must not run
+ *           concurrently with each other.
+ */
+int
+ionex::refresh(std::size_t* new_maps)
+{
+    if ( new_maps ) { *new_maps = 0; }
+    const std::size_t tec = index_of(map_type::tec);
+    const auto cur = this->snapshot();
+    if ( this->is_cached() || cur->offsets[tec].empty() ) { return 1; }
+
+    // the header must describe the same maps (only more of them).
+    ionex fresh ( _filename.c_str(), false );
+    if (   !fresh._istream.is_open()
+        || fresh.is_cached()
+        || fresh._end_of_head   != _end_of_head
+        || !(fresh._first_epoch == _first_epoch)
+        || fresh._interval      != _interval
+        || fresh._map_dimension != _map_dimension
+        || fresh._exp           != _exp
+        || fresh.latitude_grid()   != this->latitude_grid()
+        || fresh.longtitude_grid() != this->longtitude_grid()
+        || fresh.height_grid()     != this->height_grid()
+        || fresh._maps_in_file  < _maps_in_file )
+    {
 #ifdef DEBUG
-        std::cerr<<"\n[DEBUG] WTF? Failed to read input line!";
-        throw std::runtime_error
-            ("ionex::get_tec_at() -> Invalid line!");
+        std::cerr<<"\n[DEBUG] The header of "<<_filename<<" has changed.";
 #endif
         return 1;
     }
+    if ( fresh._maps_in_file == _maps_in_file ) { return 0; }
 
-    datetime_ms cur_dt = _first_epoch;
-    
-    while ( map_num < _maps_in_file
-            && _istream
-            && !std::strncmp(line+60, "START OF TEC MAP", 16) ) {
+    // the last known TEC map must be where (and as) it was.
+    char line[MAX_HEADER_CHARS];
+    datetime_ms cur_dt;
+    map_type type = map_type::rms;
+    fresh._istream.seekg(cur->offsets[tec].back(), std::ios::beg);
+    if (   !fresh._istream.getline(line, MAX_HEADER_CHARS)
+        || !_map_start_(line, std::strlen(line), type)
+        || type != map_type::tec
+        || !fresh._istream.getline(line, MAX_HEADER_CHARS)
+        || std::strncmp(line+60, "EPOCH OF CURRENT MAP", 20)
+        || _read_ionex_datetime_(line, &cur_dt)
+        || !(cur_dt == cur->epochs.back())
+        || fresh.skip_map(map_type::tec) )
+    {
+        fresh._istream.clear();
+        return 1;
+    }
 
-        *(line+6) = '\0';
-        assert( static_cast<long>(map_num+1) == std::strtol(line, &c, 10) );
-        if ( ! _istream.getline(line, MAX_HEADER_CHARS)
-            || std::strncmp(line+60, "EPOCH OF CURRENT MAP", 20) 
-            || _read_ionex_datetime_(line, &cur_dt) )
+    // scan on from there, into a new snapshot; any RMS/height maps (recorded
+    // after the TEC maps) are re-indexed.
+    auto snap = std::make_shared<map_snapshot>();
+    std::vector<datetime_ms> epochs [MAP_TYPES];
+    snap->offsets[tec] = cur->offsets[tec];
+    epochs[tec] = cur->epochs;
+    if (   fresh.scan_maps(fresh._istream.tellg(), snap->offsets, epochs)
+        || fresh.check_maps(snap->offsets, epochs) ) {
+        return 1;
+    }
+    snap->epochs = std::move( epochs[tec] );
+
+    // decode the new maps (if loaded), off the fresh stream; the known ones
+    // (and their validity masks) are copied.
+    if ( cur->is_loaded() ) {
+        const std::size_t msize = this->map_size();
+        const ionex_raw_type fill = cur->is_partial() ? IONEX_NO_VALUE : 0;
+        std::copy(cur->region, cur->region+4, fresh._region);
+        for (std::size_t t=0; t<MAP_TYPES; ++t) {
+            const std::size_t nmaps = snap->offsets[t].size();
+            if ( !nmaps ) { continue; }
+            const std::size_t known = cur->cubes[t].size() / msize;
+            auto& cube = snap->cubes[t];
+            cube.reserve( nmaps * msize );
+            cube.assign( cur->cubes[t].cbegin(), cur->cubes[t].cend() );
+            cube.resize( nmaps * msize, fill );
+            snap->data[t]     = cube.data();
+            snap->valid[t]    = cur->valid[t];
+            snap->valid_at[t] = cur->valid_at[t];
+            for (std::size_t i=known; i<nmaps; ++i) {
+                if (   fresh.seek_map(*snap, static_cast<map_type>(t), i)
+                    || fresh.read_map(static_cast<map_type>(t),
+                                      cube.data() + i*msize) ) {
+                    fresh._istream.clear();
+                    return 1;
+                }
+            }
+        }
+        this->index_validity( *snap );
+    }
+
+    // all done; publish the new maps.
+    if ( new_maps ) { *new_maps = snap->epochs.size() - cur->epochs.size(); }
+    _istream.swap( fresh._istream );
+    _maps_in_file = fresh._maps_in_file;
+    _last_epoch   = fresh._last_epoch;
+    this->publish( std::move(snap) );
+    return 0;
+}
+
+/**
+ *  \details Every level of every loaded map is scanned once; only levels
+ *           holding missing values get a bitmask, so that queries off complete
+ *           maps (the usual case) need not check validity at all. Levels
+ *           already indexed in the snapshot (i.e. copied off a previous one,
+ *           see refresh()) are kept as they are.
+ */
+void
+ionex::index_validity(map_snapshot& snap)
+const
+{
+    const std::size_t lsize  = this->latitude_maps()*this->longtitude_points();
+    const std::size_t words  = (lsize + 63) / 64;
+    const std::size_t levels = snap.epochs.size() * this->height_levels();
+    std::vector<std::uint64_t> bits ( words );
+
+    for (std::size_t t=0; t<MAP_TYPES; ++t) {
+        if ( !snap.data[t] ) {
+            snap.valid[t].clear();
+            snap.valid_at[t].clear();
+            continue;
+        }
+        std::size_t l = snap.valid_at[t].size();
+        snap.valid_at[t].resize( levels, NO_MASK );
+        for (; l<levels; ++l) {
+            if ( ngpt::validity_bits(snap.data[t] + l*lsize, lsize,
+                                     bits.data()) ) {
+                snap.valid_at[t][l] = snap.valid[t].size();
+                snap.valid[t].insert(snap.valid[t].end(), bits.cbegin(),
+                                     bits.cend());
+            }
+        }
+    }
+}
+
+const std::uint64_t*
+ionex::map_snapshot::validity(map_type t, std::size_t i, std::size_t level)
+const noexcept
+{
+    const std::size_t k = index_of( t );
+    const std::size_t at = valid_at[k][i*levels + level];
+    return at == NO_MASK ? nullptr : valid[k].data() + at;
+}
+
+bool
+ionex::is_partial()
+const noexcept
+{
+    return std::atomic_load(&_snapshot)->is_partial();
+}
+
+/// \note Holds for any cell of an instance loaded for the whole grid.
+bool
+ionex::covers_cell(std::size_t index)
+const noexcept
+{
+    return std::atomic_load(&_snapshot)->covers_cell(index);
+}
+
+bool
+ionex::map_snapshot::is_partial()
+const noexcept
+{
+    return region[1] != WHOLE_GRID;
+}
+
+bool
+ionex::map_snapshot::covers_cell(std::size_t index)
+const noexcept
+{
+    const std::size_t band = index / lon_points;
+    const std::size_t col  = index % lon_points;
+    return  band >= region[0] && band+1 <= region[1]
+        &&  col  >= region[2] && col+1  <= region[3];
+}
+
+bool
+ionex::in_region_band(std::size_t band)
+const noexcept
+{
+    return band >= _region[0] && band <= _region[1];
+}
+
+bool
+ionex::in_region_line(std::size_t line)
+const noexcept
+{
+    return    line >= _region[2] / MAX_TEC_PER_LINE
+           && line <= _region[3] / MAX_TEC_PER_LINE;
+}
+
+/** Decode all (indexed) maps of the instance into the given cubes (one per
+ *  map type), using a memory-mapped view of the file. The records are walked
+ *  in place, i.e. no line is ever copied and the instance's stream is not
+ *  touched; the fixed-width fields are decoded directly off the mapped memory.
+ *  The resulting cubes are exactly the same as the ones produced by reading
+ *  the maps through the stream (see load()). For compressed files, the
+ *  (already decompressed) contents held by the stream are walked instead.
+ *
+ *  \returns An integer denoting the exit status; anything other than 0 
+ *           denotes failure.
+ */
+int
+ionex::load_mapped(const map_snapshot& snap,
+                   std::vector<ionex_raw_type>* cubes)
+const
+{
+    // the map index should hold all (TEC) maps in the file.
+    if ( snap.offsets[index_of(map_type::tec)].size() != _maps_in_file ) {
+        return 1;
+    }
+
+    // compressed files are already (decompressed) in memory; else map it.
+    std::unique_ptr<ngpt::mapped_file> mfile;
+    const char* buf_begin = _istream.data();
+    const char* buf_end   = buf_begin + _istream.size();
+    if ( !buf_begin ) {
+        mfile.reset( new ngpt::mapped_file(_filename.c_str()) );
+        buf_begin = mfile->data();
+        buf_end   = mfile->end();
+    }
+
+    const std::size_t levels    = this->height_levels();
+    const std::size_t lat_maps  = this->latitude_maps();
+    const std::size_t lon_lines = this->longtitude_lines();
+    const std::size_t lon_pts   = this->longtitude_points();
+    const std::size_t msize     = this->map_size();
+    const long        lat1      = std::lround(_lat1 * 10);
+    const long        dlat      = std::lround(_dlat * 10);
+    const long        hgt1      = std::lround(_hgt1 * 10);
+    const long        dhgt      = std::lround(_dhgt * 10);
+
+    const ionex_raw_type fill = ( _region[1] != WHOLE_GRID )
+                              ? IONEX_NO_VALUE : 0;
+    for (std::size_t t=0; t<MAP_TYPES; ++t) {
+        cubes[t].assign( snap.offsets[t].size() * msize, fill );
+    }
+
+    const char* line;
+    std::size_t len;
+    long        val, hval;
+    datetime_ms cur_dt;
+
+    for (const auto& m : this->maps_in_file_order(snap)) {
+        const map_labels& labels = MAP_LABELS[index_of(m.first)];
+        std::streamoff offset = snap.offsets[index_of(m.first)][m.second];
+        if ( offset < 0 || offset >= buf_end - buf_begin ) {
+            return 1;
+        }
+        const char* cur = buf_begin + offset;
+        ionex_raw_type* out = cubes[index_of(m.first)].data() + m.second*msize;
+
+        // 'START OF <type> MAP' and 'EPOCH OF CURRENT MAP'
+        if ( !_next_record_(cur, buf_end, line, len)
+            || !_has_label_(line, len, labels.start, labels.start_len)
+            || !_next_record_(cur, buf_end, line, len)
+            || !_has_label_(line, len, "EPOCH OF CURRENT MAP", 20)
+            || _read_fixed_ionex_datetime_(line, &cur_dt)
+            || !(cur_dt == snap.epochs[m.second]) )
         {
 #ifdef DEBUG
-            std::cerr<<"\n[DEBUG] Expected line \"EPOCH OF CURRENT MAP\", found:";
-            std::cerr<<"\n        "<<line;
+            std::cerr<<"\n[DEBUG] Map nr "<<m.second<<" not found at indexed position.";
             throw std::runtime_error
-                ("ionex::get_tec_at() -> Invalid line!");
+                ("ionex::load_mapped() -> Invalid line!");
 #endif
             return 1;
         }
 
-        if ( cur_dt >= *from && cur_dt <= *to ) {
-            // read the map into memmory
-            if ( this->read_tec_map(tec_map) ) {
+        for (std::size_t h=0; h<levels; ++h) {
+            for (std::size_t b=0; b<lat_maps; ++b) {
+                // outside the region; skip the whole const-latitude map.
+                if ( !this->in_region_band(b) ) {
+                    for (std::size_t l=0; l<=lon_lines; ++l) {
+                        if ( !_next_record_(cur, buf_end, line, len) ) {
+                            return 1;
+                        }
+                    }
+                    out += lon_pts;
+                    continue;
+                }
+                // next line should be 'LAT/LON1/LON2/DLON/H'; check the
+                // latitude and height
+                if ( !_next_record_(cur, buf_end, line, len)
+                    || !_has_label_(line, len, "LAT/LON1/LON2/DLON/H", 20)
+                    || _read_fixed_tenths_(line+2, 6, val)
+                    || val != lat1 + static_cast<long>(b)*dlat
+                    || _read_fixed_tenths_(line+26, 6, hval)
+                    || hval != hgt1 + static_cast<long>(h)*dhgt )
+                {
 #ifdef DEBUG
-                std::cerr<<"\n[DEBUG] Failed reading map nr "<<map_num;
-                throw std::runtime_error
-                    ("ionex::get_tec_at() -> failed reading maps.");
+                    std::cerr<<"\n[DEBUG] Error reading map 'LAT/LON1/LON2/DLON/H'";
+                    throw std::runtime_error
+                        ("ionex::load_mapped() -> Invalid line");
 #endif
-                return 1;
+                    return 1;
+                }
+                // values; format: I5 max 16 values per line.
+                std::size_t left = lon_pts;
+                for (std::size_t l=0; l<lon_lines; ++l) {
+                    std::size_t n = std::min(left, MAX_TEC_PER_LINE);
+                    if ( !_next_record_(cur, buf_end, line, len)
+                        || (   this->in_region_line(l)
+                            && ngpt::decode_i5_line(line, len, n, out) ) ) {
+#ifdef DEBUG
+                        std::cerr<<"\n[DEBUG] Fuck! Reading map values failed!";
+                        throw std::runtime_error
+                            ("ionex::load_mapped() -> Invalid line");
+#endif
+                        return 1;
+                    }
+                    out  += n;
+                    left -= n;
+                }
             }
+        }
 
-            // ok. we got the map and we need to extract the cells for all points
-            // index; points to current point
-            std::size_t j     = 0; // point index
-            for (const auto& p : points) {
-                tec_vals[j].emplace_back( grid.bilinear_interpolation<int>(
-                                            p.first,
-                                            p.second,
-                                            cells[j],
-                                            tec_map.data())
-                                        );
-                ++j;
-            }
-            epoch_vector.emplace_back( cur_dt );
-            //++eph_index;
-        } else {
-            if ( skip_tec_map() ) {
+        // should now read 'END OF <type> MAP'
+        if ( !_next_record_(cur, buf_end, line, len)
+            || !_has_label_(line, len, labels.end, labels.end_len) )
+        {
 #ifdef DEBUG
-                std::cerr<<"\n[DEBUG] Failed skipping map nr "<<map_num;
-                throw std::runtime_error
-                    ("ionex::get_tec_at() -> failed reading maps.");
+            std::cerr<<"\n[DEBUG] Expected \""<<labels.end<<"\"";
+            throw std::runtime_error
+                ("ionex::load_mapped() -> Invalid line");
 #endif
-                return 1;
-            }
+            return 1;
         }
-        _istream.getline(line, MAX_HEADER_CHARS);
-        ++map_num;
     }
 
-    // if everything went as planned, we should have read all maps in file.
-    return !(map_num == _maps_in_file);
+    return 0;
+}
+
+namespace
+{
+/// The header of a binary (IONEX) cache file. The file layout is:
+/// header, epochs (as int64 MJD/millisec pairs) and one int16 cube per map
+/// type held, each at an offset aligned to IONEX_CACHE_ALIGN bytes. All
+/// values are stored in the byte order of the host that wrote the file.
+struct ionex_cache_header
+{
+    char          magic[8];      ///< IONEX_CACHE_MAGIC
+    std::uint32_t version;       ///< IONEX_CACHE_VERSION
+    std::uint32_t byte_order;    ///< 0x01020304, as written
+    std::int32_t  exponent;
+    std::int32_t  interval;
+    std::int32_t  map_dimension;
+    std::int32_t  reserved;
+    std::uint64_t maps;          ///< Number of maps (per type)
+    std::uint64_t map_size;      ///< Values per map
+    float         hgt[3], lat[3], lon[3]; ///< Grids; from, to, step
+    float         base_radius;
+    float         min_elevation;
+    std::int64_t  first_epoch[2]; ///< Header first epoch; MJD, millisec
+    std::int64_t  last_epoch[2];  ///< Header last epoch; MJD, millisec
+    std::uint64_t epochs_offset;  ///< Offset of the map epochs
+    std::uint64_t cube_offset[3]; ///< Offset of each cube; 0 if none
+    std::uint64_t file_size;      ///< Size of the whole file (bytes)
+};
+
+/// Largest grid value (degrees or km) accepted off a cache header.
+constexpr float IONEX_CACHE_MAX_GRID { 1e5f };
+
+/// Number of nodes on a (lat/lon) grid axis of a cache header, computed as
+/// ionex::latitude_maps() does; 0 if the axis is not valid.
+std::uint64_t
+_cache_axis_nodes_(const float* axis) noexcept
+{
+    for (int i=0; i<3; ++i) {
+        if ( !(std::abs(axis[i]) <= IONEX_CACHE_MAX_GRID) ) { return 0; }
+    }
+    long from = static_cast<long>(axis[0] * 100);
+    long to   = static_cast<long>(axis[1] * 100);
+    long step = static_cast<long>(axis[2] * 100);
+    if ( !step ) { return 0; }
+    long nodes = (to - from) / step + 1;
+    return nodes > 0 ? static_cast<std::uint64_t>( nodes ) : 0;
+}
+
+/// Values per map off the grids of a cache header, computed as
+/// ionex::map_size() does; 0 if the grids are not valid. Checked before any
+/// field is assigned off the header.
+std::uint64_t
+_cache_map_size_(const ionex_cache_header& hdr) noexcept
+{
+    std::uint64_t levels = 1;
+    if ( hdr.map_dimension == 3 && hdr.hgt[2] != 0 ) {
+        const float span = (hdr.hgt[1] - hdr.hgt[0]) / hdr.hgt[2];
+        if ( !(span >= 0 && span <= IONEX_CACHE_MAX_GRID) ) { return 0; }
+        levels = std::lround( span ) + 1;
+    }
+    const std::uint64_t lats = _cache_axis_nodes_( hdr.lat );
+    const std::uint64_t lons = _cache_axis_nodes_( hdr.lon );
+    const std::uint64_t max  = std::numeric_limits<std::uint64_t>::max();
+    if ( !lats || !lons || lats > max / lons || lats*lons > max / levels ) {
+        return 0;
+    }
+    return levels * lats * lons;
+}
 }
 
-/** Parse the epooch-related arguments as given to the ionex::interpolate
- *  function. The possible options are:
+/** Write the instance to a binary cache file, i.e. all header fields needed
+ *  for queries, the map epochs and the (raw) maps of all types, in a layout
+ *  that can be memory-mapped and used in place (see ionex_cache_header).
+ *  An ionex constructed off the cache file is loaded, and serves exactly the
+ *  same results as this instance.
+ *
+ *  \returns An integer denoting the exit status; anything other than 0
+ *           denotes failure (e.g. the instance is not loaded).
+ */
+int
+ionex::write_cache(const char* filename)
+const
+{
+    const auto snap = this->snapshot();
+    if ( !snap->is_loaded() || snap->is_partial() ) { return 1; }
+
+    const std::size_t nmaps = snap->epochs.size();
+    const std::size_t msize = this->map_size();
+
+    ionex_cache_header hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic, IONEX_CACHE_MAGIC, sizeof(hdr.magic));
+    hdr.version       = IONEX_CACHE_VERSION;
+    hdr.byte_order    = 0x01020304;
+    hdr.exponent      = _exp;
+    hdr.interval      = _interval;
+    hdr.map_dimension = _map_dimension;
+    hdr.maps          = nmaps;
+    hdr.map_size      = msize;
+    hdr.hgt[0] = _hgt1; hdr.hgt[1] = _hgt2; hdr.hgt[2] = _dhgt;
+    hdr.lat[0] = _lat1; hdr.lat[1] = _lat2; hdr.lat[2] = _dlat;
+    hdr.lon[0] = _lon1; hdr.lon[1] = _lon2; hdr.lon[2] = _dlon;
+    hdr.base_radius   = _base_radius;
+    hdr.min_elevation = _min_elevation;
+    binfmt_details::split_epoch(_first_epoch, hdr.first_epoch);
+    binfmt_details::split_epoch(snap->last_epoch, hdr.last_epoch);
+
+    std::uint64_t offset = binfmt_details::align( sizeof(hdr),
+                                                 IONEX_CACHE_ALIGN );
+    hdr.epochs_offset = offset;
+    offset += nmaps * 2 * sizeof(std::int64_t);
+    for (std::size_t t=0; t<MAP_TYPES; ++t) {
+        if ( !snap->data[t] ) { continue; }
+        offset = binfmt_details::align( offset, IONEX_CACHE_ALIGN );
+        hdr.cube_offset[t] = offset;
+        offset += nmaps * msize * sizeof(ionex_raw_type);
+    }
+    hdr.file_size = offset;
+
+    std::ofstream fout ( filename, std::ios::out | std::ios::binary
+                                   | std::ios::trunc );
+    if ( !fout.is_open() ) { return 1; }
+
+    const char zeros[IONEX_CACHE_ALIGN] = {};
+    auto pad_to = [&](std::uint64_t off) {
+        std::uint64_t pos = static_cast<std::uint64_t>( fout.tellp() );
+        fout.write(zeros, static_cast<std::streamsize>(off - pos));
+    };
+
+    fout.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    pad_to( hdr.epochs_offset );
+    std::int64_t ep[2];
+    for (const auto& e : snap->epochs) {
+        binfmt_details::split_epoch(e, ep);
+        fout.write(reinterpret_cast<const char*>(ep), sizeof(ep));
+    }
+    for (std::size_t t=0; t<MAP_TYPES; ++t) {
+        if ( !snap->data[t] ) { continue; }
+        pad_to( hdr.cube_offset[t] );
+        fout.write(reinterpret_cast<const char*>(snap->data[t]),
+                   static_cast<std::streamsize>(nmaps * msize
+                                                * sizeof(ionex_raw_type)));
+    }
+
+    return fout.good() ? 0 : 1;
+}
+
+/** Map the (binary cache) file of the instance and assign all fields off its
+ *  header; the epochs are copied, while the maps are used in place, off the
+ *  mapping (i.e. the instance is loaded). Before any field is assigned, the
+ *  grids are checked against the map size and every count and offset against
+ *  the file size (with no overflow), so that no access can go past the
+ *  mapping.
+ *
+ *  \returns An integer denoting the exit status; anything other than 0
+ *           denotes failure. In this case, the instance is left unloaded.
+ */
+int
+ionex::read_cache()
+{
+    std::shared_ptr<mapped_file> mfile ( new mapped_file(_filename.c_str()) );
+
+    ionex_cache_header hdr;
+    bool ok = mfile->size() >= sizeof(hdr);
+    if ( ok ) {
+        std::memcpy(&hdr, mfile->data(), sizeof(hdr));
+        // count records of size bytes fit at offset (no overflow).
+        auto fits = [&hdr](std::uint64_t offset, std::uint64_t count,
+                           std::uint64_t bytes) {
+            return offset % IONEX_CACHE_ALIGN == 0
+                && offset >= sizeof(hdr)
+                && offset <= hdr.file_size
+                && count <= (hdr.file_size - offset) / bytes;
+        };
+        ok =  hdr.version    == IONEX_CACHE_VERSION
+           && hdr.byte_order == 0x01020304
+           && hdr.file_size  == mfile->size()
+           && hdr.maps > 0
+           && fits(hdr.epochs_offset, hdr.maps, 2*sizeof(std::int64_t))
+           && hdr.map_size == _cache_map_size_(hdr)
+           && hdr.map_size <= hdr.file_size / sizeof(ionex_raw_type)
+           && hdr.cube_offset[index_of(map_type::tec)];
+        for (std::size_t t=0; ok && t<MAP_TYPES; ++t) {
+            ok = !hdr.cube_offset[t]
+              || fits(hdr.cube_offset[t], hdr.maps,
+                      hdr.map_size * sizeof(ionex_raw_type));
+        }
+    }
+    if ( !ok ) {
+#ifdef DEBUG
+        std::cerr<<"\n[DEBUG] Invalid (or incompatible) cache file "<<_filename;
+        throw std::runtime_error
+            ("ionex::read_cache() -> Invalid cache file.");
+#endif
+        return 1;
+    }
+
+    _exp           = hdr.exponent;
+    _interval      = hdr.interval;
+    _map_dimension = hdr.map_dimension;
+    _maps_in_file  = hdr.maps;
+    _hgt1 = hdr.hgt[0]; _hgt2 = hdr.hgt[1]; _dhgt = hdr.hgt[2];
+    _lat1 = hdr.lat[0]; _lat2 = hdr.lat[1]; _dlat = hdr.lat[2];
+    _lon1 = hdr.lon[0]; _lon2 = hdr.lon[1]; _dlon = hdr.lon[2];
+    _base_radius   = hdr.base_radius;
+    _min_elevation = hdr.min_elevation;
+    _first_epoch   = binfmt_details::join_epoch(hdr.first_epoch);
+    _last_epoch    = binfmt_details::join_epoch(hdr.last_epoch);
+
+    auto snap = std::make_shared<map_snapshot>();
+    std::int64_t ep[2];
+    snap->epochs.reserve( hdr.maps );
+    const char* eptr = mfile->data() + hdr.epochs_offset;
+    for (std::size_t i=0; i<hdr.maps; ++i) {
+        std::memcpy(ep, eptr + i*sizeof(ep), sizeof(ep));
+        snap->epochs.push_back( binfmt_details::join_epoch(ep) );
+    }
+
+    for (std::size_t t=0; t<MAP_TYPES; ++t) {
+        snap->data[t] = hdr.cube_offset[t]
+            ? reinterpret_cast<const ionex_raw_type*>
+                (mfile->data() + hdr.cube_offset[t])
+            : nullptr;
+    }
+    snap->cache = mfile;
+    _cache = std::move( mfile );
+    this->index_validity( *snap );
+    this->publish( std::move(snap) );
+    return 0;
+}
+
+/** Parse the epooch-related arguments as given to an interpolate() function
+ *  (e.g. ionex::interpolate), where first and last are the first and last
+ *  epochs of the available maps. The possible options are:
  *  -# If the epochs vector has size other than 0, then these epochs are used;
  *  ifrom is set to the first epoch in the epochs vector and to is set to the
  *  last
@@ -769,6 +1815,7 @@ ionex::get_tec_at(const std::vector<std::pair<ionex_grd_type,ionex_grd_type>>& p
  *      - if interval is <= 0, then all maps in the interval [from, to] are used
  *  In case the epochs vector is empty and the interval is set to 0, then the
  *  epochs vector will be returned empty, and should be filled with all epochs.
+ *  At exit, from and to always point to valid epochs.
  *  In all other cases, the epochs vector (at exit) should contain all epochs
  *  be extracted in the interval [first_epoch_in_file, last_epoch_in_file].
  *
@@ -778,16 +1825,18 @@ ionex::get_tec_at(const std::vector<std::pair<ionex_grd_type,ionex_grd_type>>& p
  *      -# >0 : error
  */
 int
-ionex::parse_epoch_arguments(std::vector<datetime_ms>& epochs,
-                             datetime_ms* from,
-                             datetime_ms* to,
-                             int& interval)
+ngpt::resolve_interpolation_epochs(std::vector<ionex::datetime_ms>& epochs,
+                                   ionex::datetime_ms*& from,
+                                   ionex::datetime_ms*& to,
+                                   int interval,
+                                   ionex::datetime_ms* first,
+                                   ionex::datetime_ms* last)
 {
     if ( epochs.empty() ) {
-        if ( !from ) { from = &this->_first_epoch; }
-        if ( !to   ) { to   = &this->_last_epoch;  }
+        if ( !from ) { from = first; }
+        if ( !to   ) { to   = last;  }
         if ( interval > 0 ) {
-            for (datetime_ms tmp = *from; tmp <= *to;
+            for (ionex::datetime_ms tmp = *from; tmp <= *to;
                                     tmp.add_seconds( interval*1000L ) ) {
                 epochs.push_back( tmp );
             }
@@ -803,6 +1852,150 @@ ionex::parse_epoch_arguments(std::vector<datetime_ms>& epochs,
     return 0;
 }
 
+/// \details Branch-free; 64 values per word.
+bool
+ngpt::validity_bits(const ionex_raw_type* values, std::size_t n,
+                    std::uint64_t* words) noexcept
+{
+    std::uint64_t missing = 0;
+    for (std::size_t w=0; w*64<n; ++w) {
+        const std::size_t     m = std::min<std::size_t>( 64, n - w*64 );
+        const ionex_raw_type* v = values + w*64;
+        std::uint64_t bits = 0;
+        for (std::size_t b=0; b<m; ++b) {
+            bits |= static_cast<std::uint64_t>( v[b] != IONEX_NO_VALUE ) << b;
+        }
+        missing |= bits ^ ( m == 64 ? ~std::uint64_t(0)
+                                    : (std::uint64_t(1) << m) - 1 );
+        words[w] = bits;
+    }
+    return missing != 0;
+}
+
+/// \details No branching per point; with both values valid, the result
+///          is (up to rounding) the plain linear interpolation.
+void
+ngpt::blend_maps(const map_bracket& b, const double* vi, const double* vj,
+                 std::size_t n, double* out) noexcept
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for (std::size_t p=0; p<n; ++p) {
+        const bool   oki = ( vi[p] == vi[p] ), okj = ( vj[p] == vj[p] );
+        const double ai  = oki ? b.wi : 0e0,    aj  = okj ? b.wj : 0e0;
+        const double v   = ai * ( oki ? vi[p] : 0e0 )
+                         + aj * ( okj ? vj[p] : 0e0 );
+        const double ws  = ai + aj;
+        out[p] = ws > 0e0 ? v / ws : nan;
+    }
+}
+
+/**
+ *  \details The step is checked against every pair of consecutive maps (not
+ *           just taken off the "INTERVAL" header field), so that files with
+ *           missing maps and collections with gaps between files fall back
+ *           to searching.
+ */
+long
+ngpt::uniform_map_step(const std::vector<ionex::datetime_ms>& map_epochs)
+noexcept
+{
+    if ( map_epochs.size() < 2 ) { return 0; }
+    const long step = map_epochs[1].delta_sec(map_epochs[0]).as_underlying_type();
+    if ( step <= 0 ) { return 0; }
+    for (std::size_t k=2; k<map_epochs.size(); ++k) {
+        if ( map_epochs[k].delta_sec(map_epochs[k-1]).as_underlying_type()
+             != step ) {
+            return 0;
+        }
+    }
+    return step;
+}
+
+/**
+ *  \details With a (non-zero) step, the map indexes and the weights are
+ *           computed off the (integer) milliseconds since the first map; the
+ *           weights are exactly those of the search path.
+ */
+ngpt::map_bracket
+ngpt::bracket_epoch(const std::vector<ionex::datetime_ms>& map_epochs,
+                    long step, const ionex::datetime_ms& t) noexcept
+{
+    const std::size_t nmaps = map_epochs.size();
+    map_bracket b { 0, 0, 1e0, 0e0 };
+
+    if ( step > 0 ) {
+        const long d = t.delta_sec(map_epochs[0]).as_underlying_type();
+        if ( d < 0 ) { return b; }
+        const std::size_t k = static_cast<std::size_t>( d / step );
+        if ( k >= nmaps - 1 ) {
+            b.i = b.j = nmaps - 1;
+            return b;
+        }
+        const long r = d - static_cast<long>( k ) * step;
+        b.i  = k;
+        b.j  = k + 1;
+        b.wj = static_cast<double>( r ) / static_cast<double>( step );
+        b.wi = static_cast<double>( step - r ) / static_cast<double>( step );
+        return b;
+    }
+
+    const std::size_t after = std::distance(map_epochs.cbegin(),
+        std::upper_bound(map_epochs.cbegin(), map_epochs.cend(), t));
+    if ( after == 0 ) { return b; }
+    if ( after == nmaps ) {
+        b.i = b.j = nmaps - 1;
+        return b;
+    }
+    b.i = after - 1;
+    b.j = after;
+    const double dt = static_cast<double>( map_epochs[b.j].delta_sec(map_epochs[b.i]).as_underlying_type() );
+    b.wj = static_cast<double>( t.delta_sec(map_epochs[b.i]).as_underlying_type() ) / dt;
+    b.wi = static_cast<double>( map_epochs[b.j].delta_sec(t).as_underlying_type() ) / dt;
+    return b;
+}
+
+namespace
+{
+/// Implementation of ionex::interpolate(); I is either ionex (maps may be
+/// streamed off the file) or const ionex (maps must be loaded).
+template<typename I>
+std::vector<std::vector<double>>
+_interpolate_(I& inx,
+              const std::vector<std::pair<ionex_grd_type,ionex_grd_type>>& points,
+              std::vector<ionex::datetime_ms>& epochs,
+              ionex::datetime_ms* ifrom,
+              ionex::datetime_ms* ito,
+              int interval,
+              ionex::map_type type,
+              std::size_t level)
+{
+    ionex::datetime_ms first { inx.first_epoch() };
+    ionex::datetime_ms last  { inx.last_epoch()  };
+    int status = ngpt::resolve_interpolation_epochs(epochs, ifrom, ito,
+                                                    interval, &first, &last);
+    if ( status > 0 ) {
+#ifdef DEBUG
+        std::cerr<<"\n[DEBUG] Failed to resolve interpolation epochs.";
+#endif
+        throw std::runtime_error
+            ("ionex::interpolate() -> failed to resolve epochs.");
+    }
+
+    // no interpolation in time needed; use all maps within [from, to]. The
+    // cursor pins its own snapshot; any later one holds these maps too.
+    const auto snap = inx.snapshot();
+    const auto& map_epochs = snap->epochs;
+    if ( status < 0 ) {
+        epochs.assign(
+            std::lower_bound(map_epochs.cbegin(), map_epochs.cend(), *ifrom),
+            std::upper_bound(map_epochs.cbegin(), map_epochs.cend(), *ito));
+    }
+
+    ngpt::ionex_cursor cursor ( inx, points, epochs, type, level );
+    return ngpt::collect_rows( cursor, epochs.size() );
+}
+}
+
 /**
  *  \param[in] ifrom  Starting epoch; if not set it will be equal to the first
  *                    epoch in the IONEX file. If it is prior to the first epoch
@@ -813,112 +2006,56 @@ ionex::parse_epoch_arguments(std::vector<datetime_ms>& epochs,
  *  \param[in] interval The time step with which to extract the TEC values. If
  *                    set to '0', it will be set equal to the interval in the
  *                    IONEX file. The value denotes (integer) seconds.
+ *  \param[in] type   The type of maps to interpolate (TEC, RMS or height).
+ *  \param[in] level  The height level (index into the height grid) to use;
+ *                    always 0 for 2d maps.
+ *
+ *  \throw   std::runtime_error if the epochs cannot be resolved, if the file
+ *           holds no maps of the given type, if the level is out of range or
+ *           if any point is outside the grid.
+ *
+ *  \note    This is a wrapper around an ionex_cursor, collecting all results
+ *           in memory. For long (high-rate) series, use the cursor directly.
+ *           Missing (9999) map values are left out of the interpolation (see
+ *           ionex_cursor::next()); values with no valid neighbours are NaN.
  */
 std::vector<std::vector<double>>
 ionex::interpolate(const std::vector<std::pair<ionex_grd_type,ionex_grd_type>>& points,
                    std::vector<datetime_ms>& epochs,
                    datetime_ms* ifrom,
                    datetime_ms* ito,
-                   int interval
+                   int interval,
+                   map_type type,
+                   std::size_t level
                   )
 {
-    int status = this->parse_epoch_arguments(epochs, ifrom, ito, interval);
-    if ( status > 0 ) {
-#ifdef DEBUG
-        std::cerr<<"\n[DEBUG] Failed to resolve interpolation epochs.";
-#endif
-        throw std::runtime_error
-            ("ionex::interpolate() -> failed to resolve epochs.");
-    }
-
-    // we must provide an epoch vector
-    // this vector, will hold all epochs recorded in the IONEX file.
-    std::vector<datetime_ms> epoch_vector_1;
-    epoch_vector_1.reserve( this->_maps_in_file );
-
-    // we must also provide a vector of vectors, where
-    // vec[i][j] is the tec value for station #i at epoch #j
-    std::vector<std::vector<int>> tec_vals_1 ( points.size() );
-    for (std::size_t i=0; i<tec_vals_1.size(); ++i) {
-        tec_vals_1[i].reserve( epoch_vector_1.capacity() );
-    }
+    return _interpolate_(*this, points, epochs, ifrom, ito, interval, type,
+                         level);
+}
 
-    // get the tec/epoch values that are recorded in the IONEX file, for
-    // the points in the list; if we are going to interpolate, it's better to
-    // collect tec priori to a after the first/last dates.
-    datetime_ms __from { *ifrom };
-    datetime_ms __to   { *ito   };
-    if ( status == 0 ) {
-        long __two_hours = 1000L * 2 * 3600L;
-        __from.remove_seconds( __two_hours );
-        __to.add_seconds( __two_hours );
-    }
-    if ( this->get_tec_at(points, epoch_vector_1, tec_vals_1, &__from, &__to) ) {
-#ifdef DEBUG
-        std::cerr<<"\n[DEBUG] Failed to read te/epochs from IONEX.";
-#endif
+/**
+ *  \details Same as above, for a loaded instance. The instance is only read,
+ *           so any number of threads can call this concurrently on the same
+ *           (shared) instance, with no locking.
+ *
+ *  \throw   std::runtime_error if the instance is not loaded; else, same as
+ *           above.
+ */
+std::vector<std::vector<double>>
+ionex::interpolate(const std::vector<std::pair<ionex_grd_type,ionex_grd_type>>& points,
+                   std::vector<datetime_ms>& epochs,
+                   datetime_ms* ifrom,
+                   datetime_ms* ito,
+                   int interval,
+                   map_type type,
+                   std::size_t level
+                  )
+const
+{
+    if ( !this->is_loaded() ) {
         throw std::runtime_error
-            ("ionex::interpolate() -> failed to read tecs/epochs.");
-    }
-
-    // Sweet! If status < 0, then no interpolation is needed
-    if ( status < 0 ) {
-        epochs = std::move(epoch_vector_1);
-        std::vector<std::vector<double>> tecs ( tec_vals_1.size(),
-                                    std::vector<double>(epochs.size()) );
-        for (std::size_t i=0; i<tec_vals_1.size(); ++i) {
-            std::transform(tec_vals_1[i].cbegin(),
-                           tec_vals_1[i].cend(),
-                           tecs[i].begin(),
-                           [&](int t){ return static_cast<double>(t) *
-                            static_cast<double>(std::pow(10, this->_exp)); }
-                          );
-        }
-        return tecs;
-    }
-    
-    // we need to interpolate in time! We need to find the TEC values for
-    // all epochs in the epochs vector.
-    // a new vector of vectors to hold the interpolated TEC values (per station)
-    std::vector<std::vector<double>> tec_vals_2 ( points.size(),
-                                  std::vector<double>(epochs.capacity(), 9999) );
-
-    // remove garbabe values(dates) from the end of epoch_vector_1
-    auto time_prev = epoch_vector_1.cbegin();
-    auto time_next = time_prev;
-    std::size_t i(0), j(0), k(0);
-    double coefi, coefj;
-    for (auto cur_time  = epochs.cbegin(); cur_time < epochs.cend(); ++cur_time ) {
-
-        time_next = std::upper_bound(epoch_vector_1.cbegin(),
-                                     epoch_vector_1.cend(),
-                                     *cur_time);
-        if ( time_next == epoch_vector_1.cend() ) {
-            time_next = time_prev + 1;
-        } else {
-            time_prev = time_next - 1;
-        }
-
-        i = std::distance(epoch_vector_1.cbegin(), time_prev);
-        j = std::distance(epoch_vector_1.cbegin(), time_next);
-
-        k = std::distance(epochs.cbegin(), cur_time);
-        if ( time_prev != time_next ) {
-            auto s1 = static_cast<double>( time_next->delta_sec(*cur_time).as_underlying_type() );
-            auto s2 = static_cast<double>( time_next->delta_sec(*time_prev).as_underlying_type() );
-            coefi = s1/s2;
-            s1 = static_cast<double>( cur_time->delta_sec(*time_prev).as_underlying_type() );
-            s2 = static_cast<double>( time_next->delta_sec(*time_prev).as_underlying_type() );
-            coefj = s1/s2;
-        } else {
-            coefi = 1.0f;
-            coefj = 0.0f;
-        } // FIXME missing values 99999 !!!!!!!!!!!!!!!!!
-        for ( std::size_t point=0 ; point<points.size() ; ++point ) {
-            tec_vals_2[point][k] = coefi*tec_vals_1[point][i] 
-                                 + coefj*tec_vals_1[point][j];
-        }
+            ("ionex::interpolate() -> instance not loaded.");
     }
-
-    return tec_vals_2;
+    return _interpolate_(*this, points, epochs, ifrom, ito, interval, type,
+                         level);
 }
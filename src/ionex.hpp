@@ -4,7 +4,11 @@
 #include <fstream>
 #include <vector>
 #include <tuple>
+#include <cstdint>
+#include <memory>
 #include "datetime_v2.hpp"
+#include "mmfile.hpp"
+#include "infile.hpp"
 
 /**
  * \file
@@ -42,6 +46,10 @@ namespace ngpt
 /// The type we store ionex grid values in.
 using ionex_grd_type = float;
 
+/// The type we store raw (i.e. not scaled by the exponent) TEC values in,
+/// when the TEC maps are decoded into memory (see ionex::load()).
+using ionex_raw_type = std::int16_t;
+
 /*
  * \class ionex
  *
@@ -71,12 +79,35 @@ using ionex_grd_type = float;
  *          IONEX files with a precision of 1e-1 degrees. Various functions use
  *          this fact to turn the (float/double) grid values to (int/long).
  *          Should this change, we're fucked!
+ *
+ * \note    An instance can also be constructed off a binary cache file (see
+ *          write_cache()); the file type is detected at construction. Cached
+ *          instances are memory-mapped and always loaded, i.e. they serve the
+ *          same queries with no parsing at all.
+ *
+ * \note    Queries off a non-loaded instance read through its stream, so an
+ *          instance can then serve one thread at a time. Once loaded (or
+ *          cached), all const queries (including cursors over a const
+ *          instance) can run concurrently, on any number of threads, with no
+ *          locking.
+ *
+ *          The maps (index, epochs, decoded values, the region they cover
+ *          and validity masks) are held in an immutable map_snapshot. Any call that changes them
+ *          (load(), load_region(), refresh()) builds a new snapshot and
+ *          publishes it atomically. Const queries may therefore run while
+ *          another thread refreshes the instance. A query (or cursor, or
+ *          slant_tec engine) pins the snapshot it starts off, so the maps it
+ *          reads are never freed under it; it sees maps published later only
+ *          if constructed after them.
  */
 class ionex
 {
     /// Let's not write this more than once.
     typedef std::ifstream::pos_type pos_type;
 
+    /// Number of map types.
+    static constexpr std::size_t MAP_TYPES { 3 };
+
 public:
     /// This is the datetime resolution for ionex dates
     typedef ngpt::datev2<ngpt::milliseconds> datetime_ms;
@@ -84,7 +115,89 @@ public:
     /// Valid IONEX versions.
     enum class ionex_version : char { v10 };
 
-    /// Constructor from filename.
+    /// How to read the TEC maps off from the file when loading (see load()).
+    enum class reader_backend : char {
+        stream, ///< Line by line, through the instance's input stream.
+        mmap    ///< Walk the (memory-mapped) records in place; no copies.
+    };
+
+    /// The kinds of maps an IONEX file may hold (\cite inx1). RMS and height
+    /// maps, if present, are recorded for the same epochs as the TEC maps.
+    enum class map_type : char {
+        tec,   ///< TEC maps ("START OF TEC MAP")
+        rms,   ///< RMS (of TEC) maps ("START OF RMS MAP")
+        height ///< Height maps ("START OF HEIGHT MAP")
+    };
+
+    /// The (indexed and, if loaded, decoded) maps of an instance, as published
+    /// at construction or by load(), load_region() and refresh(). Never
+    /// modified once published; holding one keeps its maps alive, whatever
+    /// the instance does meanwhile.
+    struct map_snapshot
+    {
+        map_snapshot() = default;
+
+        /// Copy not allowed ! (data points into cubes).
+        map_snapshot(const map_snapshot&) = delete;
+
+        /// Assignment not allowed !
+        map_snapshot& operator=(const map_snapshot&) = delete;
+
+        /// Is any map decoded (or mapped off a binary cache)?
+        bool is_loaded() const noexcept
+        { return data[index_of(map_type::tec)] != nullptr; }
+
+        /// Are there maps of the given type (see ionex::has_maps())?
+        bool has_maps(map_type t) const noexcept
+        {
+            return !offsets[index_of(t)].empty()
+                || data[index_of(t)] != nullptr;
+        }
+
+        /// Have only part of the maps been decoded (see ionex::is_partial())?
+        bool is_partial() const noexcept;
+
+        /// Is the grid cell within the decoded maps (see ionex::covers_cell())?
+        bool covers_cell(std::size_t index) const noexcept;
+
+        /// Raw values of the i-th map of the given type (see ionex::map()).
+        const ionex_raw_type* map(map_type t, std::size_t i) const noexcept
+        { return data[index_of(t)] + i*map_size; }
+
+        /// Validity bitmask of a map level (see ionex::validity()).
+        const std::uint64_t*
+        validity(map_type t, std::size_t i, std::size_t level = 0)
+        const noexcept;
+
+        datetime_ms              last_epoch; ///< "EPOCH OF LAST MAP", off the
+        ///< header the maps were indexed off.
+        std::size_t              map_size { 0 }; ///< Raw values per map.
+        std::size_t              levels   { 1 }; ///< Height levels per map.
+        std::size_t              lon_points { 0 }; ///< Values per latitude
+        ///< band.
+        std::size_t              region[4] {}; ///< Region the maps were
+        ///< decoded for, as (inclusive) node indexes (see ionex::_region).
+        std::vector<pos_type>    offsets[MAP_TYPES]; ///< Position of every
+        ///< "START OF TEC/RMS/HEIGHT MAP" record in the file, per type.
+        std::vector<datetime_ms> epochs; ///< Epoch of every TEC map.
+        std::vector<ionex_raw_type> cubes[MAP_TYPES]; ///< Decoded maps per
+        ///< type; stored as [epoch][hgt][lat][lon]. Empty if not loaded (or no
+        ///< maps of this type) or cached.
+        const ionex_raw_type* data[MAP_TYPES] { nullptr, nullptr, nullptr };
+        ///< Start of the maps of each type, off cubes or the cache file;
+        ///< nullptr if not loaded.
+        std::shared_ptr<mapped_file> cache; ///< The (mapped) binary cache file
+        ///< data points into, if cached.
+        std::vector<std::uint64_t> valid[MAP_TYPES]; ///< Validity bitmasks of
+        ///< the loaded map levels holding missing values, per type.
+        std::vector<std::size_t>   valid_at[MAP_TYPES]; ///< Offset (in words)
+        ///< of every loaded map level's bitmask in valid; NO_MASK if no value
+        ///< of the level is missing.
+    };
+
+    /// Constructor from filename; either an IONEX (text) file, possibly gzip
+    /// or Unix compress(ed) (see input_file), or a binary cache file (see
+    /// write_cache()).
     ionex(const char*);
 
     /// Destructor (closing the file is not mandatory, but nevertheless)
@@ -108,7 +221,8 @@ public:
 
     datetime_ms first_epoch() const noexcept { return this->_first_epoch; }
     
-    datetime_ms last_epoch() const noexcept { return this->_last_epoch; }
+    datetime_ms last_epoch() const noexcept
+    { return std::atomic_load(&_snapshot)->last_epoch; }
 
     std::tuple<ionex_grd_type, ionex_grd_type, ionex_grd_type> latitude_grid()
     const noexcept
@@ -117,41 +231,196 @@ public:
     std::tuple<ionex_grd_type, ionex_grd_type, ionex_grd_type> longtitude_grid()
     const noexcept
     { return std::make_tuple(_lon1, _lon2, _dlon); }
+
+    /// The height grid; for 2d maps, hgt1 = hgt2 and dhgt = 0.
+    std::tuple<ionex_grd_type, ionex_grd_type, ionex_grd_type> height_grid()
+    const noexcept
+    { return std::make_tuple(_hgt1, _hgt2, _dhgt); }
+
+    /// Mean earth radius (km), i.e. the radius the map heights refer to.
+    float base_radius() const noexcept { return _base_radius; }
+
+    /// Number of heights (i.e. 1 for 2d maps) in every map.
+    std::size_t height_levels() const noexcept;
+
+    /// Number of (raw) values in every map (all heights).
+    std::size_t map_size() const noexcept
+    { return height_levels()*latitude_maps()*longtitude_points(); }
+
+    /// The exponent; TEC values are (raw value) * 10^exponent
+    int exponent() const noexcept { return _exp; }
+
+    /// Decode all maps (TEC, and RMS/height if present) of the file into
+    /// memory, in one pass over the file. After a successful call, all queries
+    /// (i.e. interpolate()) are served off the in-memory cubes and the file is
+    /// never parsed again. Both backends produce exactly the same cubes.
+    int load(reader_backend backend = reader_backend::stream);
+
+    /// Same as load(), but only decode the part of the maps covering the
+    /// given box (degrees); all other values are set to 9999 (i.e. missing).
+    /// Queries for points outside the region throw.
+    int load_region(ionex_grd_type lat_min, ionex_grd_type lat_max,
+                    ionex_grd_type lon_min, ionex_grd_type lon_max,
+                    reader_backend backend = reader_backend::stream);
+
+    /// Same as above, the region being the grid cells of the given points.
+    int load_region(
+        const std::vector<std::pair<ionex_grd_type,ionex_grd_type>>& points,
+        reader_backend backend = reader_backend::stream);
+
+    /// Re-check the header of a growing (e.g. rapid or real-time) product and
+    /// index (and, if loaded, decode) only the maps recorded since the
+    /// instance was constructed or last refreshed; the result is published as
+    /// a new snapshot. If new_maps is given, it is set to the number of new
+    /// maps (per type).
+    int refresh(std::size_t* new_maps = nullptr);
+
+    /// Have only part of the maps been decoded (via load_region())?
+    bool is_partial() const noexcept;
+
+    /// Is the grid cell, with lower-left node at the given (flat, [lat][lon])
+    /// index, within the decoded maps?
+    bool covers_cell(std::size_t index) const noexcept;
+
+    /// Have the maps been decoded into memory (via load()), or mapped off a
+    /// binary cache?
+    bool is_loaded() const noexcept
+    { return std::atomic_load(&_snapshot)->is_loaded(); }
+
+    /// Is the instance backed by a (memory-mapped) binary cache file?
+    bool is_cached() const noexcept { return _cache != nullptr; }
+
+    /// Does the file hold maps of the given type? (TEC maps are mandatory).
+    bool has_maps(map_type t) const noexcept
+    { return std::atomic_load(&_snapshot)->has_maps(t); }
+
+    /// The maps as currently published; they stay valid (and unchanged) for
+    /// as long as the returned pointer is held.
+    std::shared_ptr<const map_snapshot> snapshot() const noexcept
+    { return std::atomic_load(&_snapshot); }
+
+    /// Write the (loaded) instance to a binary cache file; constructing an
+    /// ionex off this file gives an identical (loaded) instance.
+    int write_cache(const char*) const;
+
+    /// Epochs of all TEC maps recorded in the file (as currently indexed).
+    /// \warning The reference (as those returned by map() and validity()) is
+    ///          off the current snapshot, i.e. valid until the instance
+    ///          publishes new maps; to read while another thread may do so,
+    ///          hold a snapshot() instead.
+    const std::vector<datetime_ms>& map_epochs() const noexcept
+    { return std::atomic_load(&_snapshot)->epochs; }
+
+    /// Raw values of the i-th loaded map of the given type, stored as
+    /// [hgt][lat][lon] (i.e. in the order they are recorded in the file).
+    /// \warning No range check is performed; the instance must be loaded and
+    ///          hold maps of this type. See also map_epochs().
+    const ionex_raw_type* map(map_type t, std::size_t i) const noexcept
+    { return std::atomic_load(&_snapshot)->map(t, i); }
+
+    /// Raw TEC values of the i-th loaded map (see map()).
+    const ionex_raw_type* tec_map(std::size_t i) const noexcept
+    { return map(map_type::tec, i); }
+
+    /// Validity bitmask of a height level of the i-th loaded map of the given
+    /// type: bit k (i.e. bit k%64 of word k/64) is set if the k-th value of
+    /// the level ([lat][lon]) is not missing (9999). Returns nullptr if no
+    /// value of the level is missing.
+    /// \warning No range check is performed (see map()).
+    const std::uint64_t*
+    validity(map_type t, std::size_t i, std::size_t level = 0) const noexcept
+    { return std::atomic_load(&_snapshot)->validity(t, i, level); }
   
+    /// Interpolate values of the given map type (default TEC) at the given
+    /// height level (index into the height grid; 0 for 2d maps).
     std::vector<std::vector<double>>
     interpolate(
         const std::vector<std::pair<ionex_grd_type,ionex_grd_type>>& points,
         std::vector<datetime_ms>& epochs,
         datetime_ms* ifrom = nullptr,
         datetime_ms* ito = nullptr,
-        int interval = 0
+        int interval = 0,
+        map_type type = map_type::tec,
+        std::size_t level = 0
     );
 
+    /// Same as above, for a loaded instance; the instance is not modified, so
+    /// many threads may query one (shared) instance concurrently.
+    std::vector<std::vector<double>>
+    interpolate(
+        const std::vector<std::pair<ionex_grd_type,ionex_grd_type>>& points,
+        std::vector<datetime_ms>& epochs,
+        datetime_ms* ifrom = nullptr,
+        datetime_ms* ito = nullptr,
+        int interval = 0,
+        map_type type = map_type::tec,
+        std::size_t level = 0
+    ) const;
+
 private:
+    /// Cursors (and climatology reductions) stream maps off the file.
+    friend class ionex_cursor;
+    friend class ionex_climatology;
+
     /// Read the instance header, and assign (most of) the fields.
     int read_header();
 
-    /// Read all TEC maps and (spatial) interpolate for a given vector of
-    /// points
-    int get_tec_at(
-            const std::vector<std::pair<ionex_grd_type,ionex_grd_type>>&,
-            std::vector<datetime_ms>&,
-            std::vector<std::vector<int>>&,
-            datetime_ms *from = nullptr,
-            datetime_ms *to = nullptr
-    );
+    /// Map a binary cache file and assign all fields off it.
+    int read_cache();
+
+    /// Index of a map type (in the per-type member arrays).
+    static constexpr std::size_t index_of(map_type t) noexcept
+    { return static_cast<std::size_t>(t); }
+
+    // Constructor; if index is false, only the header is read (or the cache
+    // file is mapped).
+    ionex(const char*, bool index);
+
+    // Publish a new snapshot of the maps (see map_snapshot).
+    void publish(std::shared_ptr<map_snapshot>);
 
-    /// This is a help function for parsing datetime arguments to the
-    /// interpolation function.
-    int parse_epoch_arguments(std::vector<datetime_ms>&,
-                              datetime_ms*, datetime_ms*, int&);
+    // Build the map index (offset of every map, of any type, in the file).
+    int index_maps();
 
-    // Read a TEC map for a constant epoch
-    int read_tec_map(std::vector<int>&);
-    int skip_tec_map();
+    // Index all maps from the given position on (appending to the per-type
+    // offsets and epochs).
+    int scan_maps(pos_type, std::vector<pos_type>*, std::vector<datetime_ms>*);
+
+    // Check the (per-type) number and epochs of indexed maps against the
+    // header.
+    int check_maps(const std::vector<pos_type>*,
+                   const std::vector<datetime_ms>*) const;
+
+    // All indexed maps (type and index), in the order they are recorded.
+    std::vector<std::pair<map_type, std::size_t>>
+    maps_in_file_order(const map_snapshot&) const;
+
+    // Position the stream at the begining of an (indexed) map.
+    int seek_map(const map_snapshot&, map_type, std::size_t);
+
+    // Build the validity bitmasks of all loaded maps (see validity()).
+    void index_validity(map_snapshot&) const;
+
+    // Decode all (indexed) maps off from the memory-mapped file.
+    int load_mapped(const map_snapshot&, std::vector<ionex_raw_type>*) const;
+
+    // Read (or skip) a whole map (all heights) for a constant epoch
+    int read_map(map_type, ionex_raw_type*);
+    int skip_map(map_type);
 
     // Read an individual map
-    int read_latitude_map(std::size_t, std::vector<int>&, std::size_t&);
+    int read_latitude_map(std::size_t, ionex_raw_type*, std::size_t&,
+                          ionex_grd_type);
+
+    // Decode all maps (within the region set) into the cubes.
+    int decode_maps(reader_backend);
+
+    // Is the const-latitude map (band) within the region to decode?
+    bool in_region_band(std::size_t) const noexcept;
+
+    // Is the (16-value) line of a const-latitude map within the region to
+    // decode?
+    bool in_region_line(std::size_t) const noexcept;
 
     // Compute how many (const) latitude maps there exist for each height.
     std::size_t latitude_maps() const noexcept;
@@ -160,13 +429,18 @@ private:
     // latitude map.
     std::size_t longtitude_lines() const noexcept;
 
+    // Compute how many (TEC) values there exist for a single const-latitude
+    // map.
+    std::size_t longtitude_points() const noexcept;
+
     std::string      _filename;      ///< The name of the antex file.
-    std::ifstream    _istream;       ///< The infput (file) stream.
+    input_file       _istream;       ///< The infput (file) stream.
     ionex_version    _version;       ///< Ionex  version (1.0).
     pos_type         _end_of_head;   ///< Mark the 'END OF HEADER' field.
     //ngpt::time_scale _time_scale;    ///< The timescale
     datetime_ms      _first_epoch;   ///< Epoch of first TEC map (UT)
-    datetime_ms      _last_epoch;    ///< Epoch of first TEC map (UT)
+    datetime_ms      _last_epoch;    ///< Epoch of last TEC map (UT), as
+    ///< last read off the header; queries use the published copy.
     int              _interval;      ///< Time interval between maps in integer
     ///< seconds. If 0, interval may vary.
     std::size_t      _maps_in_file;  ///< Total number of TEC/RMS/HGT maps
@@ -180,9 +454,63 @@ private:
     ionex_grd_type   _lon1, _lon2, _dlon; ///< the longtitude grid; from _lon1 to
     ///< _lon2 with increment _dlon
     int              _exp;         ///< the exponent; default = -1
+    std::shared_ptr<mapped_file> _cache; ///< The (mapped) binary cache file,
+    ///< if the instance is cached.
+    std::size_t      _region[4];   ///< Region to decode, as (inclusive) node
+    ///< indexes: first/last latitude band, first/last longtitude. The whole
+    ///< grid by default. Only used while decoding; queries use the region
+    ///< of the published snapshot.
+    std::shared_ptr<const map_snapshot> _snapshot; ///< The published maps;
+    ///< only ever accessed through std::atomic_load/std::atomic_store.
+    bool             _indexed;     ///< Have all maps of the file been indexed
+    ///< (see index_maps())? If not, the maps cannot be loaded.
 
 }; // end ionex
 
+/// Resolve the epoch-related arguments of an interpolate() call, given the
+/// first and last epoch of the available maps.
+int
+resolve_interpolation_epochs(std::vector<ionex::datetime_ms>& epochs,
+                             ionex::datetime_ms*& from,
+                             ionex::datetime_ms*& to,
+                             int interval,
+                             ionex::datetime_ms* first,
+                             ionex::datetime_ms* last);
+
+/// Set the validity bits (see ionex::validity()) of n raw values, into
+/// (n+63)/64 words; returns true if any of the values is missing.
+bool
+validity_bits(const ionex_raw_type* values, std::size_t n,
+              std::uint64_t* words) noexcept;
+
+/// The (two) maps bracketing an epoch and their weights for linear
+/// interpolation in time; i == j (and wj == 0) off the span of the maps.
+struct map_bracket
+{
+    std::size_t i, j;   ///< Indexes of the earlier/later map.
+    double      wi, wj; ///< Weights of the earlier/later map.
+};
+
+/// The (constant) step in milliseconds between consecutive map epochs, or 0
+/// if the maps are not evenly spaced (or are less than two).
+long
+uniform_map_step(const std::vector<ionex::datetime_ms>& map_epochs) noexcept;
+
+/// Find the maps bracketing epoch t, given the map epochs (non-empty) and
+/// their step as returned by uniform_map_step(). For evenly spaced maps this
+/// is O(1) (no search); else a binary search.
+map_bracket
+bracket_epoch(const std::vector<ionex::datetime_ms>& map_epochs, long step,
+              const ionex::datetime_ms& t) noexcept;
+
+/// Interpolate in time between the values (at n points) vi and vj off the
+/// two maps of a bracket, into out. Missing values (NaN) are left out, the
+/// weights being renormalized over the valid ones; points missing off both
+/// maps get a NaN.
+void
+blend_maps(const map_bracket& b, const double* vi, const double* vj,
+           std::size_t n, double* out) noexcept;
+
 } // end ngpt
 
 #endif
@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#ifdef DEBUG
+    #include <iostream>
+#endif
+#include "ionex_climatology.hpp"
+#include "i5decode.hpp"
+#include "parallel.hpp"
+
+using ngpt::ionex;
+using ngpt::ionex_climatology;
+
+namespace
+{
+/// The accumulators of one file: statistics and histograms per cell.
+struct accumulator
+{
+    std::vector<ngpt::running_stats> stats;
+    std::vector<std::uint32_t>       hist;
+    std::size_t                      maps { 0 };
+};
+
+/// What is needed (off the header) to reduce a file.
+struct file_info
+{
+    std::string         name;
+    ionex::datetime_ms  first, last;
+    std::tuple<ngpt::ionex_grd_type,ngpt::ionex_grd_type,ngpt::ionex_grd_type>
+                        lat, lon, hgt;
+};
+}
+
+/**
+ *  \details First, the headers of all files are read (concurrently) and the
+ *           files are sorted by their first epoch; maps of a file with epochs
+ *           up to the last epoch of any previous file are then skipped. Next,
+ *           the files are reduced concurrently (one job per file): every job
+ *           streams the maps of its file into an accumulator of its own and
+ *           then, once all previous files are merged, merges it into the
+ *           results. Since files are handed out in order, a job only waits
+ *           for jobs already running, and there are never more accumulators
+ *           than threads; since the (floating point) merges are done in file
+ *           order, the results do not depend on scheduling or on the number
+ *           of threads.
+ */
+ionex_climatology::ionex_climatology(const std::vector<std::string>& files,
+                                     ionex::map_type type,
+                                     std::size_t level,
+                                     double hist_min,
+                                     double hist_max,
+                                     std::size_t bins,
+                                     unsigned threads)
+    : _maps(0),
+      _hist_min(hist_min),
+      _bin(bins ? (hist_max - hist_min) / static_cast<double>(bins) : 0e0),
+      _bins(bins)
+{
+    if ( files.empty() ) {
+        throw std::runtime_error
+            ("ionex_climatology::ionex_climatology() -> No files given.");
+    }
+    if ( !bins || !(hist_max > hist_min) ) {
+        throw std::runtime_error
+            ("ionex_climatology::ionex_climatology() -> Invalid histogram.");
+    }
+
+    // read all headers (only).
+    std::vector<file_info> info ( files.size() );
+    ngpt::parallel_for(files.size(), [&](std::size_t i) {
+        ionex inx ( files[i].c_str(), false );
+        info[i] = file_info { files[i], inx.first_epoch(), inx.last_epoch(),
+                              inx.latitude_grid(), inx.longtitude_grid(),
+                              inx.height_grid() };
+    }, threads);
+    std::sort(info.begin(), info.end(),
+              [](const file_info& a, const file_info& b)
+              { return a.first < b.first; });
+
+    // all files must be on the same grid
+    for (const auto& f : info) {
+        if (   f.lat != info.front().lat || f.lon != info.front().lon
+            || f.hgt != info.front().hgt )
+        {
+#ifdef DEBUG
+            std::cerr<<"\n[DEBUG] File "<<f.name<<" is not on the same"
+                     <<" grid as "<<info.front().name;
+#endif
+            throw std::runtime_error
+                ("ionex_climatology::ionex_climatology() -> Incompatible grids.");
+        }
+    }
+    _lat_grid = info.front().lat;
+    _lon_grid = info.front().lon;
+    auto nodes = [](const std::tuple<ionex_grd_type,ionex_grd_type,
+                                     ionex_grd_type>& axis) {
+        return static_cast<std::size_t>( std::lround(
+            (std::get<1>(axis)-std::get<0>(axis)) / std::get<2>(axis) ) + 1 );
+    };
+    const std::size_t ncells = nodes(_lat_grid) * nodes(_lon_grid);
+
+    // maps up to the last epoch of any previous file are skipped.
+    std::vector<ionex::datetime_ms> cutoff ( info.size() );
+    for (std::size_t f=1; f<info.size(); ++f) {
+        cutoff[f] = ( f > 1 && info[f-1].last < cutoff[f-1] )
+                  ? cutoff[f-1]
+                  : info[f-1].last;
+    }
+
+    // the results; partial (per file) accumulators are merged in file order.
+    _stats.resize( ncells );
+    _hist.assign( ncells * bins, 0 );
+    std::size_t next_merge = 0;
+    bool failed = false;
+    std::mutex merge_mtx;
+    std::condition_variable merge_cv;
+    auto fail = [&]() {
+        std::lock_guard<std::mutex> lock ( merge_mtx );
+        failed = true;
+        merge_cv.notify_all();
+    };
+
+    // reduce every file, map by map.
+    ngpt::parallel_for(info.size(), [&](std::size_t f) {
+        accumulator acc;
+        try {
+            ionex inx ( info[f].name.c_str() );
+            if ( !inx._indexed ) {
+                throw std::runtime_error
+                    ("ionex_climatology::ionex_climatology() -> Failed indexing "
+                     "maps of " + info[f].name);
+            }
+            if ( !inx.has_maps(type) || level >= inx.height_levels() ) {
+                throw std::runtime_error
+                    ("ionex_climatology::ionex_climatology() -> No such maps in "
+                     + info[f].name);
+            }
+            if ( inx.map_size() != ncells * inx.height_levels() ) {
+                throw std::runtime_error
+                    ("ionex_climatology::ionex_climatology() -> Invalid maps in "
+                     + info[f].name);
+            }
+            const double scale = std::pow(10e0, static_cast<double>(inx.exponent()));
+            const double top   = static_cast<double>( bins - 1 );
+            const std::size_t hoff = level * ncells;
+            std::vector<ionex_raw_type> buf;
+            if ( !inx.is_loaded() ) { buf.resize( inx.map_size() ); }
+
+            acc.stats.resize( ncells );
+            acc.hist.assign( ncells * bins, 0 );
+            const auto snap = inx.snapshot();
+            const auto& epochs = snap->epochs;
+            for (std::size_t m=0; m<epochs.size(); ++m) {
+                if ( f && !(cutoff[f] < epochs[m]) ) { continue; }
+                const ionex_raw_type* map;
+                if ( snap->is_loaded() ) {
+                    map = snap->map(type, m);
+                } else {
+                    if (   inx.seek_map(*snap, type, m)
+                        || inx.read_map(type, buf.data()) ) {
+                        throw std::runtime_error
+                            ("ionex_climatology::ionex_climatology() -> Failed "
+                             "reading maps of " + info[f].name);
+                    }
+                    map = buf.data();
+                }
+                map += hoff;
+                for (std::size_t k=0; k<ncells; ++k) {
+                    if ( map[k] == ngpt::IONEX_NO_VALUE ) { continue; }
+                    const double x = map[k] * scale;
+                    acc.stats[k].add( x );
+                    double b = std::floor( (x - _hist_min) / _bin );
+                    b = std::min( std::max(b, 0e0), top );
+                    ++acc.hist[k*bins + static_cast<std::size_t>(b)];
+                }
+                ++acc.maps;
+            }
+        } catch (...) {
+            fail();
+            throw;
+        }
+
+        // wait for all previous files to be merged (or for any job to fail).
+        std::unique_lock<std::mutex> lock ( merge_mtx );
+        merge_cv.wait( lock, [&]() { return next_merge == f || failed; } );
+        if ( failed ) { return; }
+        for (std::size_t k=0; k<ncells; ++k) { _stats[k].merge( acc.stats[k] ); }
+        std::transform(_hist.begin(), _hist.end(), acc.hist.cbegin(),
+                       _hist.begin(), std::plus<std::uint32_t>());
+        _maps += acc.maps;
+        ++next_merge;
+        merge_cv.notify_all();
+    }, threads);
+
+    if ( !_maps ) {
+        throw std::runtime_error
+            ("ionex_climatology::ionex_climatology() -> No maps found.");
+    }
+}
+
+/**
+ *  \details The percentile is found off the cumulative counts of the bins and
+ *           interpolated linearly within its bin; the result is clamped to the
+ *           min/max values of the cell.
+ */
+double
+ionex_climatology::percentile(std::size_t i, double p)
+const noexcept
+{
+    const running_stats& s = _stats[i];
+    if ( !s.count() ) { return std::numeric_limits<double>::quiet_NaN(); }
+
+    const double target = std::min( std::max(p, 0e0), 100e0 ) / 100e0
+                        * static_cast<double>( s.count() );
+    const std::uint32_t* h = _hist.data() + i*_bins;
+    double cum = 0e0, x = s.max();
+    for (std::size_t b=0; b<_bins; ++b) {
+        if ( h[b] && cum + h[b] >= target ) {
+            x = _hist_min + _bin * ( b + (target - cum) / h[b] );
+            break;
+        }
+        cum += h[b];
+    }
+    return std::min( std::max(x, s.min()), s.max() );
+}
+
+std::vector<double>
+ionex_climatology::mean_map()
+const
+{
+    std::vector<double> m ( _stats.size() );
+    for (std::size_t i=0; i<m.size(); ++i) { m[i] = _stats[i].mean(); }
+    return m;
+}
+
+std::vector<double>
+ionex_climatology::stddev_map()
+const
+{
+    std::vector<double> m ( _stats.size() );
+    for (std::size_t i=0; i<m.size(); ++i) { m[i] = _stats[i].stddev(); }
+    return m;
+}
+
+std::vector<double>
+ionex_climatology::min_map()
+const
+{
+    std::vector<double> m ( _stats.size() );
+    for (std::size_t i=0; i<m.size(); ++i) { m[i] = _stats[i].min(); }
+    return m;
+}
+
+std::vector<double>
+ionex_climatology::max_map()
+const
+{
+    std::vector<double> m ( _stats.size() );
+    for (std::size_t i=0; i<m.size(); ++i) { m[i] = _stats[i].max(); }
+    return m;
+}
+
+std::vector<double>
+ionex_climatology::percentile_map(double p)
+const
+{
+    std::vector<double> m ( _stats.size() );
+    for (std::size_t i=0; i<m.size(); ++i) { m[i] = this->percentile(i, p); }
+    return m;
+}
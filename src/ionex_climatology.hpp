@@ -0,0 +1,139 @@
+#ifndef __IONEX_CLIMATOLOGY_NGPT_
+#define __IONEX_CLIMATOLOGY_NGPT_
+
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "ionex.hpp"
+#include "running_stats.hpp"
+
+/**
+ * \file
+ *
+ * \version
+ *
+ * \author    xanthos@mail.ntua.gr <br>
+ *            danast@mail.ntua.gr
+ *
+ * \date
+ *
+ * \brief     Per grid cell statistics (climatology) of the maps of any number
+ *            of IONEX files.
+ *
+ * \copyright Copyright © 2015 Dionysos Satellite Observatory, <br>
+ *            National Technical University of Athens. <br>
+ *            This work is free. You can redistribute it and/or modify it under
+ *            the terms of the Do What The Fuck You Want To Public License,
+ *            Version 2, as published by Sam Hocevar. See http://www.wtfpl.net/
+ *            for more details.
+ *
+ * <b><center><hr>
+ * National Technical University of Athens <br>
+ *      Dionysos Satellite Observatory     <br>
+ *        Higher Geodesy Laboratory        <br>
+ *      http://dionysos.survey.ntua.gr
+ * <hr></center></b>
+ *
+ */
+
+namespace ngpt
+{
+
+/*
+ * \class   ionex_climatology
+ *
+ * \details Statistics of the values at every node (cell) of the grid, over
+ *          all maps of a set of IONEX files (e.g. months of daily files), all
+ *          on the same grid: count, mean, standard deviation, rms, min and
+ *          max (see running_stats), and percentiles off a histogram (of fixed
+ *          bins) per cell.
+ *
+ *          The files are reduced concurrently, on a pool of threads: each
+ *          thread streams the maps of one file at a time (map by map, off the
+ *          file) into accumulators of its own, which are then merged into the
+ *          results in file order. Hence memory depends on the grid size and
+ *          the number of threads, not on the number of maps; the time series
+ *          is never held in memory. The results are reproducible (bit for
+ *          bit), whatever the number of threads.
+ *
+ *          A map sharing its epoch with a map of a previous (in time) file,
+ *          e.g. the midnight map of daily files, is only used once. Missing
+ *          (9999) values are left out. Results are stored as the maps are,
+ *          i.e. [lat][lon] (for the height level used).
+ *
+ * \throw   The constructor throws std::runtime_error if the list is empty, if
+ *          any file cannot be read, if the files are not on the same grid, or
+ *          if they hold no maps of the given type/level.
+ */
+class ionex_climatology
+{
+public:
+    /// Constructor from a list of files; reduces the maps of the given type
+    /// at the given height level. Percentiles come off histograms of bins
+    /// bins in [hist_min, hist_max) (values off the range are counted in the
+    /// first/last bin); threads is the max number of threads to use (0 means
+    /// one per hardware thread).
+    explicit ionex_climatology(const std::vector<std::string>& files,
+                               ionex::map_type type = ionex::map_type::tec,
+                               std::size_t level = 0,
+                               double hist_min = 0e0,
+                               double hist_max = 256e0,
+                               std::size_t bins = 512,
+                               unsigned threads = 0);
+
+    /// Number of cells (i.e. grid nodes) of a map.
+    std::size_t cells() const noexcept { return _stats.size(); }
+
+    /// Number of (distinct) maps reduced.
+    std::size_t maps() const noexcept { return _maps; }
+
+    std::tuple<ionex_grd_type, ionex_grd_type, ionex_grd_type> latitude_grid()
+    const noexcept
+    { return _lat_grid; }
+
+    std::tuple<ionex_grd_type, ionex_grd_type, ionex_grd_type> longtitude_grid()
+    const noexcept
+    { return _lon_grid; }
+
+    /// Statistics of the i-th cell.
+    const running_stats& cell(std::size_t i) const noexcept
+    { return _stats[i]; }
+
+    /// The p-th percentile (p in [0, 100]) of the i-th cell, interpolated
+    /// within the histogram bins; NaN if the cell holds no values.
+    double percentile(std::size_t i, double p) const noexcept;
+
+    /// Map of the mean values.
+    std::vector<double> mean_map() const;
+
+    /// Map of the standard deviations.
+    std::vector<double> stddev_map() const;
+
+    /// Map of the min values.
+    std::vector<double> min_map() const;
+
+    /// Map of the max values.
+    std::vector<double> max_map() const;
+
+    /// Map of the p-th percentiles (p in [0, 100]).
+    std::vector<double> percentile_map(double p) const;
+
+private:
+    std::tuple<ionex_grd_type,ionex_grd_type,ionex_grd_type> _lat_grid; ///<
+    ///< The latitude grid.
+    std::tuple<ionex_grd_type,ionex_grd_type,ionex_grd_type> _lon_grid; ///<
+    ///< The longtitude grid.
+    std::size_t                _maps;     ///< Number of maps reduced.
+    double                     _hist_min; ///< Start of the first bin.
+    double                     _bin;      ///< Bin width.
+    std::size_t                _bins;     ///< Bins per cell.
+    std::vector<running_stats> _stats;    ///< Statistics per cell.
+    std::vector<std::uint32_t> _hist;     ///< Histograms, per cell
+    ///< ([cell][bin]).
+
+}; // end ionex_climatology
+
+} // end ngpt
+
+#endif
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#ifdef DEBUG
+    #include <iostream>
+#endif
+#include "ionex_collection.hpp"
+#include "ionex_cursor.hpp"
+#include "parallel.hpp"
+
+using ngpt::ionex;
+using ngpt::ionex_collection;
+
+/**
+ *  \details All files are constructed and loaded concurrently (one job per
+ *           file). The loaded files are then sorted by their first epoch and
+ *           their maps are chained into one time axis, skipping any map with
+ *           the same epoch as the last map of the previous file.
+ *
+ *  \throw   std::runtime_error if the list is empty, if any file fails to
+ *           load, if the files are not on the same grid or if they overlap
+ *           in time.
+ */
+ionex_collection::ionex_collection(const std::vector<std::string>& files,
+                                   unsigned threads)
+{
+    if ( files.empty() ) {
+        throw std::runtime_error
+            ("ionex_collection::ionex_collection() -> No files given.");
+    }
+
+    // parse and load all files; each job fills its own slot.
+    _files.resize( files.size() );
+    ngpt::parallel_for(files.size(), [&](std::size_t i) {
+        std::unique_ptr<ionex> inx ( new ionex(files[i].c_str()) );
+        if ( inx->load() ) {
+            throw std::runtime_error
+                ("ionex_collection::ionex_collection() -> Failed to load file "
+                 + files[i]);
+        }
+        _files[i] = std::move( inx );
+    }, threads);
+
+    std::sort(_files.begin(), _files.end(),
+              [](const std::unique_ptr<ionex>& a, const std::unique_ptr<ionex>& b)
+              { return a->first_epoch() < b->first_epoch(); });
+
+    // all files must be on the same grid
+    for (const auto& inx : _files) {
+        if (   inx->latitude_grid()   != _files.front()->latitude_grid()
+            || inx->longtitude_grid() != _files.front()->longtitude_grid()
+            || inx->height_grid()     != _files.front()->height_grid() )
+        {
+#ifdef DEBUG
+            std::cerr<<"\n[DEBUG] File "<<inx->filename()<<" is not on the same"
+                     <<" grid as "<<_files.front()->filename();
+#endif
+            throw std::runtime_error
+                ("ionex_collection::ionex_collection() -> Incompatible grids.");
+        }
+    }
+
+    // chain the maps into one time axis.
+    for (const auto& inx : _files) {
+        const double scale = std::pow(10e0, static_cast<double>(inx->exponent()));
+        const auto&  epochs = inx->map_epochs();
+        for (std::size_t i=0; i<epochs.size(); ++i) {
+            if ( !_map_epochs.empty() ) {
+                if ( epochs[i] == _map_epochs.back() ) { continue; }
+                if ( epochs[i] <  _map_epochs.back() ) {
+#ifdef DEBUG
+                    std::cerr<<"\n[DEBUG] File "<<inx->filename()
+                             <<" overlaps with previous file(s).";
+#endif
+                    throw std::runtime_error
+                        ("ionex_collection::ionex_collection() -> Overlapping files.");
+                }
+            }
+            _map_epochs.push_back( epochs[i] );
+            _map_src.emplace_back( inx.get(), i );
+            _scales.push_back( scale );
+        }
+    }
+
+    if ( _map_epochs.empty() ) {
+        throw std::runtime_error
+            ("ionex_collection::ionex_collection() -> No maps found.");
+    }
+}
+
+/**
+ *  \details See ionex::interpolate(); the maps used are those of all files in
+ *           the collection. Each map is scaled by the exponent of the file it
+ *           comes from.
+ *
+ *  \throw   std::runtime_error if the epochs cannot be resolved or if any
+ *           point is outside the grid.
+ *
+ *  \note    This is a wrapper around an ionex_cursor, collecting all results
+ *           in memory. For long (high-rate) series, use the cursor directly.
+ */
+std::vector<std::vector<double>>
+ionex_collection::interpolate(
+    const std::vector<std::pair<ionex_grd_type,ionex_grd_type>>& points,
+    std::vector<datetime_ms>& epochs,
+    datetime_ms* ifrom,
+    datetime_ms* ito,
+    int interval,
+    ionex::map_type type,
+    std::size_t level)
+const
+{
+    datetime_ms first { this->first_epoch() };
+    datetime_ms last  { this->last_epoch()  };
+    int status = ngpt::resolve_interpolation_epochs(epochs, ifrom, ito,
+                                                    interval, &first, &last);
+    if ( status > 0 ) {
+        throw std::runtime_error
+            ("ionex_collection::interpolate() -> failed to resolve epochs.");
+    }
+
+    // no interpolation in time needed; use all maps within [from, to].
+    if ( status < 0 ) {
+        epochs.assign(
+            std::lower_bound(_map_epochs.cbegin(), _map_epochs.cend(), *ifrom),
+            std::upper_bound(_map_epochs.cbegin(), _map_epochs.cend(), *ito));
+    }
+
+    ionex_cursor cursor ( *this, points, epochs, type, level );
+    return ngpt::collect_rows( cursor, epochs.size() );
+}
@@ -0,0 +1,125 @@
+#ifndef __IONEX_COLLECTION_NGPT_
+#define __IONEX_COLLECTION_NGPT_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "ionex.hpp"
+
+/**
+ * \file
+ *
+ * \version
+ *
+ * \author    xanthos@mail.ntua.gr <br>
+ *            danast@mail.ntua.gr
+ *
+ * \date
+ *
+ * \brief     A (multi-day) collection of IONEX files, seen as one time series.
+ *
+ * \copyright Copyright © 2015 Dionysos Satellite Observatory, <br>
+ *            National Technical University of Athens. <br>
+ *            This work is free. You can redistribute it and/or modify it under
+ *            the terms of the Do What The Fuck You Want To Public License,
+ *            Version 2, as published by Sam Hocevar. See http://www.wtfpl.net/
+ *            for more details.
+ *
+ * <b><center><hr>
+ * National Technical University of Athens <br>
+ *      Dionysos Satellite Observatory     <br>
+ *        Higher Geodesy Laboratory        <br>
+ *      http://dionysos.survey.ntua.gr
+ * <hr></center></b>
+ *
+ */
+
+namespace ngpt
+{
+
+/*
+ * \class   ionex_collection
+ *
+ * \details A set of IONEX files (e.g. daily files), all on the same grid,
+ *          presented as one continuous time series of TEC maps. The files are
+ *          parsed and loaded (see ionex::load()) concurrently, on a pool of
+ *          threads. The maps are ordered chronologically; a map sharing its
+ *          epoch with a map of the previous file (e.g. the midnight map,
+ *          recorded as the last map of a day and the first of the next) is
+ *          only used once (the one from the earlier file is kept).
+ *
+ * \throw   The constructor throws std::runtime_error if any file cannot be
+ *          read, if the files are not on the same grid, or if they overlap.
+ */
+class ionex_collection
+{
+public:
+    /// The datetime resolution (same as ionex)
+    typedef ionex::datetime_ms datetime_ms;
+
+    /// Constructor from a list of files; threads is the max number of threads
+    /// to use when loading (0 means one per hardware thread).
+    explicit ionex_collection(const std::vector<std::string>& files,
+                              unsigned threads = 0);
+
+    /// Number of files in the collection.
+    std::size_t size() const noexcept { return _files.size(); }
+
+    /// The i-th file (in chronological order).
+    const ionex& file(std::size_t i) const noexcept { return *_files[i]; }
+
+    /// Epoch of the first map in the collection.
+    datetime_ms first_epoch() const noexcept { return _map_epochs.front(); }
+
+    /// Epoch of the last map in the collection.
+    datetime_ms last_epoch() const noexcept { return _map_epochs.back(); }
+
+    /// Epochs of all (distinct) maps in the collection.
+    const std::vector<datetime_ms>& map_epochs() const noexcept
+    { return _map_epochs; }
+
+    std::tuple<ionex_grd_type, ionex_grd_type, ionex_grd_type> latitude_grid()
+    const noexcept
+    { return _files.front()->latitude_grid(); }
+
+    std::tuple<ionex_grd_type, ionex_grd_type, ionex_grd_type> longtitude_grid()
+    const noexcept
+    { return _files.front()->longtitude_grid(); }
+
+    std::tuple<ionex_grd_type, ionex_grd_type, ionex_grd_type> height_grid()
+    const noexcept
+    { return _files.front()->height_grid(); }
+
+    /// Interpolate (TEC, RMS or height) values for a list of points; the
+    /// arguments and results are the same as in ionex::interpolate(), only
+    /// epochs may span any number of files. Collections are immutable once
+    /// constructed, so this can be called concurrently from many threads.
+    std::vector<std::vector<double>>
+    interpolate(
+        const std::vector<std::pair<ionex_grd_type,ionex_grd_type>>& points,
+        std::vector<datetime_ms>& epochs,
+        datetime_ms* ifrom = nullptr,
+        datetime_ms* ito = nullptr,
+        int interval = 0,
+        ionex::map_type type = ionex::map_type::tec,
+        std::size_t level = 0
+    ) const;
+
+private:
+    /// Cursors (and slant TEC engines) read the (loaded) maps directly.
+    friend class ionex_cursor;
+    friend class slant_tec;
+
+    std::vector<std::unique_ptr<ionex>> _files; ///< Loaded files, in
+    ///< chronological order.
+    std::vector<datetime_ms>           _map_epochs; ///< Epoch of every map.
+    std::vector<std::pair<const ionex*, std::size_t>> _map_src; ///< File and
+    ///< map index of every map (any map type is read off the same index).
+    std::vector<double>                _scales; ///< Scale factor (10^exponent)
+    ///< of every map.
+
+}; // end ionex_collection
+
+} // end ngpt
+
+#endif
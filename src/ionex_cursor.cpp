@@ -0,0 +1,361 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include "ionex_cursor.hpp"
+#include "ionex_collection.hpp"
+
+using ngpt::ionex;
+using ngpt::ionex_cursor;
+
+namespace
+{
+/// Marks an empty row slot.
+constexpr std::size_t NO_MAP { std::numeric_limits<std::size_t>::max() };
+
+/// Number of nodes on a grid axis, given as (from, to, step).
+std::size_t
+_axis_nodes_(const std::tuple<ngpt::ionex_grd_type,ngpt::ionex_grd_type,
+                              ngpt::ionex_grd_type>& axis)
+{
+    return std::lround( (std::get<1>(axis)-std::get<0>(axis))
+                       / std::get<2>(axis) ) + 1;
+}
+
+/// Check that (a snapshot of the maps of) a file holds maps of the given type
+/// and height level.
+void
+_check_maps_(const ionex& inx, const ionex::map_snapshot& snap,
+             ionex::map_type type, std::size_t level)
+{
+    if ( !snap.has_maps(type) || level >= inx.height_levels() ) {
+        throw std::runtime_error
+            ("ionex_cursor::ionex_cursor() -> no such maps in "
+             + inx.filename());
+    }
+}
+
+/// Check that all points can be interpolated off (a snapshot of the maps of)
+/// a (partially) loaded file.
+void
+_check_region_(const ionex::map_snapshot& snap,
+               const ngpt::bilinear_batch& stencil)
+{
+    if ( !snap.is_loaded() ) { return; }
+    for (std::size_t i=0; i<stencil.size(); ++i) {
+        if ( !snap.covers_cell(stencil.cell_index(i)) ) {
+            throw std::runtime_error
+                ("ionex_cursor::ionex_cursor() -> point outside loaded region.");
+        }
+    }
+}
+}
+
+/// Map reader for an ionex instance; off the cube if loaded, else off the
+/// file (map by map). Either way, off the snapshot of the maps at
+/// construction.
+ionex_cursor::ionex_cursor(ionex& inx, const std::vector<point_type>& points,
+                           datetime_ms from, datetime_ms to, int interval,
+                           ionex::map_type type, std::size_t level)
+    : _stencil(0e0, 0e0, 0, 0e0, 0e0, 0),
+      _snapshot(inx.snapshot()),
+      _map_epochs(&_snapshot->epochs),
+      _epochs(nullptr)
+{
+    _check_maps_(inx, *_snapshot, type, level);
+    this->init(inx.longtitude_grid(), inx.latitude_grid(), points);
+    _check_region_(*_snapshot, _stencil);
+    const double scale = std::pow(10e0, static_cast<double>(inx.exponent()));
+    // offset of the height level within a map
+    const std::size_t hoff = level * _stencil.grid_size();
+    _reader = [this, &inx, scale, type, level, hoff](std::size_t m,
+                                                      double* row) {
+        const std::uint64_t* valid;
+        if ( _snapshot->is_loaded() ) {
+            valid = _snapshot->validity(type, m, level);
+            _stencil.apply( _snapshot->map(type, m) + hoff, valid, row );
+        } else {
+            _map_buf.resize( inx.map_size() );
+            if (   inx.seek_map(*_snapshot, type, m)
+                || inx.read_map(type, _map_buf.data()) ) {
+                inx._istream.clear();
+                throw std::runtime_error
+                    ("ionex_cursor::next() -> failed reading maps.");
+            }
+            const std::size_t gsize = _stencil.grid_size();
+            _mask_buf.resize( (gsize + 63) / 64 );
+            valid = ngpt::validity_bits(_map_buf.data() + hoff, gsize,
+                                        _mask_buf.data())
+                  ? _mask_buf.data()
+                  : nullptr;
+            _stencil.apply( _map_buf.data() + hoff, valid, row );
+        }
+        std::transform(row, row+_stencil.size(), row,
+                       [scale](double t){ return t * scale; });
+        return valid != nullptr;
+    };
+    this->set_epochs(from, to, interval);
+}
+
+ionex_cursor::ionex_cursor(ionex& inx, const std::vector<point_type>& points,
+                           const std::vector<datetime_ms>& epochs,
+                           ionex::map_type type, std::size_t level)
+    : ionex_cursor(inx, points, datetime_ms{}, datetime_ms{}, 0, type, level)
+{
+    _mode   = epoch_mode::list;
+    _epochs = &epochs;
+    _index  = 0;
+    _end    = epochs.size();
+}
+
+/// Map reader for a (loaded) const ionex; off the cube (of the snapshot at
+/// construction) only.
+ionex_cursor::ionex_cursor(const ionex& inx,
+                           const std::vector<point_type>& points,
+                           datetime_ms from, datetime_ms to, int interval,
+                           ionex::map_type type, std::size_t level)
+    : _stencil(0e0, 0e0, 0, 0e0, 0e0, 0),
+      _snapshot(inx.snapshot()),
+      _map_epochs(&_snapshot->epochs),
+      _epochs(nullptr)
+{
+    if ( !_snapshot->is_loaded() ) {
+        throw std::runtime_error
+            ("ionex_cursor::ionex_cursor() -> ionex instance not loaded.");
+    }
+    _check_maps_(inx, *_snapshot, type, level);
+    this->init(inx.longtitude_grid(), inx.latitude_grid(), points);
+    _check_region_(*_snapshot, _stencil);
+    const double scale = std::pow(10e0, static_cast<double>(inx.exponent()));
+    const std::size_t hoff = level * _stencil.grid_size();
+    _reader = [this, scale, type, level, hoff](std::size_t m, double* row) {
+        const std::uint64_t* valid = _snapshot->validity(type, m, level);
+        _stencil.apply( _snapshot->map(type, m) + hoff, valid, row );
+        std::transform(row, row+_stencil.size(), row,
+                       [scale](double t){ return t * scale; });
+        return valid != nullptr;
+    };
+    this->set_epochs(from, to, interval);
+}
+
+ionex_cursor::ionex_cursor(const ionex& inx,
+                           const std::vector<point_type>& points,
+                           const std::vector<datetime_ms>& epochs,
+                           ionex::map_type type, std::size_t level)
+    : ionex_cursor(inx, points, datetime_ms{}, datetime_ms{}, 0, type, level)
+{
+    _mode   = epoch_mode::list;
+    _epochs = &epochs;
+    _index  = 0;
+    _end    = epochs.size();
+}
+
+/// Map reader for an ionex collection; maps are always loaded.
+ionex_cursor::ionex_cursor(const ionex_collection& inxs,
+                           const std::vector<point_type>& points,
+                           datetime_ms from, datetime_ms to, int interval,
+                           ionex::map_type type, std::size_t level)
+    : _stencil(0e0, 0e0, 0, 0e0, 0e0, 0),
+      _map_epochs(&inxs.map_epochs()),
+      _epochs(nullptr)
+{
+    for (std::size_t i=0; i<inxs.size(); ++i) {
+        _check_maps_(inxs.file(i), *inxs.file(i).snapshot(), type, level);
+    }
+    this->init(inxs.longtitude_grid(), inxs.latitude_grid(), points);
+    const std::size_t hoff = level * _stencil.grid_size();
+    _reader = [this, &inxs, type, level, hoff](std::size_t m, double* row) {
+        const auto& src = inxs._map_src[m];
+        const std::uint64_t* valid = src.first->validity(type, src.second,
+                                                         level);
+        _stencil.apply( src.first->map(type, src.second) + hoff, valid, row );
+        const double scale = inxs._scales[m];
+        std::transform(row, row+_stencil.size(), row,
+                       [scale](double t){ return t * scale; });
+        return valid != nullptr;
+    };
+    this->set_epochs(from, to, interval);
+}
+
+ionex_cursor::ionex_cursor(const ionex_collection& inxs,
+                           const std::vector<point_type>& points,
+                           const std::vector<datetime_ms>& epochs,
+                           ionex::map_type type, std::size_t level)
+    : ionex_cursor(inxs, points, datetime_ms{}, datetime_ms{}, 0, type, level)
+{
+    _mode   = epoch_mode::list;
+    _epochs = &epochs;
+    _index  = 0;
+    _end    = epochs.size();
+}
+
+/// \throw std::runtime_error if any point is outside the grid.
+void
+ionex_cursor::init(
+    const std::tuple<ionex_grd_type,ionex_grd_type,ionex_grd_type>& lon_grid,
+    const std::tuple<ionex_grd_type,ionex_grd_type,ionex_grd_type>& lat_grid,
+    const std::vector<point_type>& points)
+{
+    _stencil = bilinear_batch(std::get<0>(lon_grid), std::get<2>(lon_grid),
+                              _axis_nodes_(lon_grid),
+                              std::get<0>(lat_grid), std::get<2>(lat_grid),
+                              _axis_nodes_(lat_grid));
+
+    const std::size_t npts = points.size();
+    std::vector<double> lons ( npts ), lats ( npts );
+    for (std::size_t i=0; i<npts; ++i) {
+        lons[i] = points[i].first;
+        lats[i] = points[i].second;
+    }
+    if ( _stencil.set_points(lons.data(), lats.data(), npts) ) {
+        throw std::runtime_error
+            ("ionex_cursor::ionex_cursor() -> point outside grid.");
+    }
+
+    _after       = 0;
+    _map_step    = ngpt::uniform_map_step( *_map_epochs );
+    _slot_map[0] = _slot_map[1] = NO_MAP;
+    _slot_gaps[0] = _slot_gaps[1] = false;
+    _rows[0].resize( npts );
+    _rows[1].resize( npts );
+}
+
+void
+ionex_cursor::set_epochs(datetime_ms from, datetime_ms to, int interval)
+{
+    _cur  = from;
+    _to   = to;
+    _step = 1000L * interval;
+    if ( interval > 0 ) {
+        _mode = epoch_mode::step;
+    } else {
+        _mode  = epoch_mode::maps;
+        _index = std::distance(_map_epochs->cbegin(),
+                   std::lower_bound(_map_epochs->cbegin(), _map_epochs->cend(),
+                                    from));
+        _end   = std::distance(_map_epochs->cbegin(),
+                   std::upper_bound(_map_epochs->cbegin(), _map_epochs->cend(),
+                                    to));
+        if ( _end < _index ) { _end = _index; }
+    }
+}
+
+bool
+ionex_cursor::next_epoch(datetime_ms& t) noexcept
+{
+    switch ( _mode ) {
+        case epoch_mode::step:
+            if ( _cur > _to ) { return false; }
+            t = _cur;
+            _cur.add_seconds( _step );
+            return true;
+        case epoch_mode::maps:
+            if ( _index >= _end ) { return false; }
+            t = (*_map_epochs)[_index++];
+            return true;
+        case epoch_mode::list:
+            if ( _index >= _end ) { return false; }
+            t = (*_epochs)[_index++];
+            return true;
+    }
+    return false;
+}
+
+int
+ionex_cursor::row_of(std::size_t m, std::size_t keep)
+{
+    if ( _slot_map[0] == m ) { return 0; }
+    if ( _slot_map[1] == m ) { return 1; }
+    // never replace the map to keep; else replace an empty slot or the slot
+    // holding the earlier map (maps are mostly visited in chronological
+    // order).
+    int slot = ( _slot_map[0] == keep   ) ? 1
+             : ( _slot_map[1] == keep   ) ? 0
+             : ( _slot_map[0] == NO_MAP ) ? 0
+             : ( _slot_map[1] == NO_MAP ) ? 1
+             : ( _slot_map[0] < _slot_map[1] ? 0 : 1 );
+    _slot_map[slot]  = NO_MAP; // in case the reader throws
+    _slot_gaps[slot] = _reader( m, _rows[slot].data() );
+    _slot_map[slot]  = m;
+    return slot;
+}
+
+/**
+ *  \details If the maps are evenly spaced, the maps bracketing the epoch (and
+ *           their weights) are computed directly (see bracket_epoch()). Else
+ *           they are found by moving forward from the previous epoch's maps;
+ *           only if the epochs go backwards is the map index searched.
+ */
+bool
+ionex_cursor::next(datetime_ms& epoch, double* out)
+{
+    datetime_ms t;
+    if ( !this->next_epoch(t) ) { return false; }
+
+    const auto& me = *_map_epochs;
+    const std::size_t nmaps = me.size();
+    if ( !nmaps ) {
+        throw std::runtime_error("ionex_cursor::next() -> no maps.");
+    }
+
+    map_bracket b;
+    if ( _map_step ) {
+        b = ngpt::bracket_epoch( me, _map_step, t );
+    } else {
+        // _after: index of the first map with epoch > t
+        if ( _after > 0 && t < me[_after-1] ) {
+            _after = std::distance(me.cbegin(),
+                                   std::upper_bound(me.cbegin(), me.cend(), t));
+        } else {
+            while ( _after < nmaps && !(t < me[_after]) ) { ++_after; }
+        }
+        if ( _after == 0 || _after == nmaps ) {
+            b.i = b.j = ( _after == 0 ) ? 0 : nmaps - 1;
+        } else {
+            b.i = _after - 1;
+            b.j = _after;
+            double dt = static_cast<double>( me[b.j].delta_sec(me[b.i]).as_underlying_type() );
+            b.wj = static_cast<double>( t.delta_sec(me[b.i]).as_underlying_type() ) / dt;
+            b.wi = static_cast<double>( me[b.j].delta_sec(t).as_underlying_type() ) / dt;
+        }
+    }
+
+    const std::size_t npts = _stencil.size();
+    if ( b.i == b.j ) {
+        const double* row = _rows[ this->row_of(b.i, NO_MAP) ].data();
+        std::copy(row, row+npts, out);
+    } else {
+        const int si = this->row_of( b.i, NO_MAP );
+        const int sj = this->row_of( b.j, b.i );
+        const double* rowi = _rows[si].data();
+        const double* rowj = _rows[sj].data();
+        if ( _slot_gaps[si] || _slot_gaps[sj] ) {
+            ngpt::blend_maps( b, rowi, rowj, npts, out );
+        } else {
+            const double wi = b.wi, wj = b.wj;
+            for (std::size_t p=0; p<npts; ++p) {
+                out[p] = wi*rowi[p] + wj*rowj[p];
+            }
+        }
+    }
+
+    epoch = t;
+    return true;
+}
+
+std::vector<std::vector<double>>
+ngpt::collect_rows(ionex_cursor& cursor, std::size_t nepochs)
+{
+    const std::size_t npts = cursor.points();
+    std::vector<std::vector<double>> vals ( npts,
+                                            std::vector<double>(nepochs) );
+    std::vector<double> row ( npts );
+    std::size_t j = 0;
+    cursor.for_each(row.data(), [&](const ionex::datetime_ms&, const double* r) {
+        if ( j >= nepochs ) { return false; }
+        for (std::size_t i=0; i<npts; ++i) { vals[i][j] = r[i]; }
+        ++j;
+        return true;
+    });
+    return vals;
+}
@@ -0,0 +1,216 @@
+#ifndef __IONEX_CURSOR_NGPT_
+#define __IONEX_CURSOR_NGPT_
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "ionex.hpp"
+#include "bilinear.hpp"
+
+/**
+ * \file
+ *
+ * \version
+ *
+ * \author    xanthos@mail.ntua.gr <br>
+ *            danast@mail.ntua.gr
+ *
+ * \date
+ *
+ * \brief     Streaming (epoch by epoch) interpolation of IONEX TEC maps.
+ *
+ * \copyright Copyright © 2015 Dionysos Satellite Observatory, <br>
+ *            National Technical University of Athens. <br>
+ *            This work is free. You can redistribute it and/or modify it under
+ *            the terms of the Do What The Fuck You Want To Public License,
+ *            Version 2, as published by Sam Hocevar. See http://www.wtfpl.net/
+ *            for more details.
+ *
+ * <b><center><hr>
+ * National Technical University of Athens <br>
+ *      Dionysos Satellite Observatory     <br>
+ *        Higher Geodesy Laboratory        <br>
+ *      http://dionysos.survey.ntua.gr
+ * <hr></center></b>
+ *
+ */
+
+namespace ngpt
+{
+
+class ionex_collection;
+
+/*
+ * \class   ionex_cursor
+ *
+ * \details A cursor over the (output) epochs of a TEC interpolation. Each call
+ *          to next() computes the TEC values of all points at the next epoch,
+ *          (bilinear in space, linear in time) into a caller-supplied buffer.
+ *          Only the (spatially interpolated) rows of the two maps bracketing
+ *          the current epoch are kept; maps are read (off the file or the
+ *          loaded cube) only when the cursor moves past them. Hence, memory
+ *          does not depend on the number of output epochs.
+ *
+ *          The output epochs can be:
+ *          - from, from+interval, ... up to to (interval > 0, in seconds),
+ *          - the map epochs within [from, to] (interval = 0), or
+ *          - a given vector of epochs.
+ *          Epochs outside the maps get the values of the first/last map.
+ *
+ *          By default, TEC maps are interpolated; any other map type held in
+ *          the source (RMS, height) can be used instead. For 3d maps, a
+ *          single height level (index into the height grid) is interpolated.
+ *
+ * \warning The source (ionex or ionex_collection) and any epoch vector given
+ *          must outlive the cursor. A cursor over a (non-loaded) ionex reads
+ *          through the instance's stream, so only one such cursor should be
+ *          used at a time. Cursors over loaded (const) sources only read the
+ *          maps; any number of them can run concurrently. A cursor itself
+ *          must not be shared between threads.
+ *
+ * \note    A cursor over an ionex reads the maps published when it was
+ *          constructed (see ionex::map_snapshot), holding them alive; maps
+ *          published later on (e.g. by ionex::refresh()) are not seen.
+ */
+class ionex_cursor
+{
+public:
+    typedef ionex::datetime_ms datetime_ms;
+    typedef std::pair<ionex_grd_type,ionex_grd_type> point_type;
+
+    /// Cursor over an ionex file; epochs from, from+interval, ... to (or map
+    /// epochs within [from, to] if interval is 0).
+    ionex_cursor(ionex& inx, const std::vector<point_type>& points,
+                 datetime_ms from, datetime_ms to, int interval = 0,
+                 ionex::map_type type = ionex::map_type::tec,
+                 std::size_t level = 0);
+
+    /// Cursor over an ionex file, for the given epochs.
+    ionex_cursor(ionex& inx, const std::vector<point_type>& points,
+                 const std::vector<datetime_ms>& epochs,
+                 ionex::map_type type = ionex::map_type::tec,
+                 std::size_t level = 0);
+
+    /// Cursor over a (loaded) ionex file; as above, only the instance is never
+    /// modified, so cursors over one shared instance can run concurrently.
+    /// \throw std::runtime_error if the instance is not loaded.
+    ionex_cursor(const ionex& inx, const std::vector<point_type>& points,
+                 datetime_ms from, datetime_ms to, int interval = 0,
+                 ionex::map_type type = ionex::map_type::tec,
+                 std::size_t level = 0);
+
+    /// Cursor over a (loaded) ionex file, for the given epochs.
+    ionex_cursor(const ionex& inx, const std::vector<point_type>& points,
+                 const std::vector<datetime_ms>& epochs,
+                 ionex::map_type type = ionex::map_type::tec,
+                 std::size_t level = 0);
+
+    /// Cursor over an ionex collection; epochs from, from+interval, ... to (or
+    /// map epochs within [from, to] if interval is 0).
+    ionex_cursor(const ionex_collection& inxs,
+                 const std::vector<point_type>& points,
+                 datetime_ms from, datetime_ms to, int interval = 0,
+                 ionex::map_type type = ionex::map_type::tec,
+                 std::size_t level = 0);
+
+    /// Cursor over an ionex collection, for the given epochs.
+    ionex_cursor(const ionex_collection& inxs,
+                 const std::vector<point_type>& points,
+                 const std::vector<datetime_ms>& epochs,
+                 ionex::map_type type = ionex::map_type::tec,
+                 std::size_t level = 0);
+
+    /// Copy not allowed !
+    ionex_cursor(const ionex_cursor&) = delete;
+
+    /// Assignment not allowed !
+    ionex_cursor& operator=(const ionex_cursor&) = delete;
+
+    /// Number of points (i.e. values per epoch).
+    std::size_t points() const noexcept { return _stencil.size(); }
+
+    /// Compute the values (e.g. TECU) of all points at the next epoch, into
+    /// out (which must hold at least points() values). Missing (9999) map
+    /// values are left out, the weights being renormalized over the valid
+    /// ones (in space and time); values with no valid neighbour are NaN.
+    /// Returns false (and leaves out untouched) when there are no more epochs.
+    /// \throw std::runtime_error if a map cannot be read.
+    bool next(datetime_ms& epoch, double* out);
+
+    /// Call f(epoch, values) for every (remaining) epoch, using buf (of at
+    /// least points() values) as the row buffer; stop if f returns false.
+    /// Returns the number of epochs emitted.
+    template<typename F>
+    std::size_t
+    for_each(double* buf, F&& f)
+    {
+        std::size_t n = 0;
+        datetime_ms t;
+        while ( this->next(t, buf) ) {
+            ++n;
+            if ( !f(static_cast<const datetime_ms&>(t),
+                    static_cast<const double*>(buf)) ) { break; }
+        }
+        return n;
+    }
+
+private:
+    /// How the output epochs are produced.
+    enum class epoch_mode : char { step, maps, list };
+
+    /// Reads (and spatially interpolates) map i into a row (already scaled);
+    /// returns true if the map (level) holds missing values.
+    typedef std::function<bool(std::size_t, double*)> map_reader;
+
+    /// Set the grid and points; called by all constructors.
+    void init(const std::tuple<ionex_grd_type,ionex_grd_type,ionex_grd_type>&,
+              const std::tuple<ionex_grd_type,ionex_grd_type,ionex_grd_type>&,
+              const std::vector<point_type>&);
+
+    /// Set the output epochs (step/maps mode).
+    void set_epochs(datetime_ms, datetime_ms, int);
+
+    /// Get the next output epoch; false if no more.
+    bool next_epoch(datetime_ms&) noexcept;
+
+    /// Make sure the given map is held in one of the two row slots (without
+    /// replacing the slot holding map keep); returns the slot.
+    int row_of(std::size_t m, std::size_t keep);
+
+    bilinear_batch                  _stencil;    ///< Cell indexes/weights.
+    map_reader                      _reader;     ///< Source of maps.
+    std::shared_ptr<const ionex::map_snapshot> _snapshot; ///< Maps of the
+    ///< instance, as of construction; null for collections.
+    const std::vector<datetime_ms>* _map_epochs; ///< Epochs of the maps.
+    epoch_mode                      _mode;       ///< Output epochs mode.
+    datetime_ms                     _cur, _to;   ///< Next/last output epoch
+    ///< (step mode).
+    long                            _step;       ///< Step (step mode; ms).
+    std::size_t                     _index;      ///< Next output index (maps
+    ///< and list mode).
+    std::size_t                     _end;        ///< End index (maps/list).
+    const std::vector<datetime_ms>* _epochs;     ///< Output epochs (list).
+    std::size_t                     _after;      ///< Index of the first map
+    ///< past the current epoch (maps not evenly spaced).
+    long                            _map_step;   ///< Step between the maps
+    ///< (ms), or 0 if not evenly spaced.
+    std::size_t                     _slot_map[2]; ///< Map held in each slot.
+    bool                            _slot_gaps[2]; ///< Does the map held in
+    ///< each slot have missing values?
+    std::vector<double>             _rows[2];     ///< The two slots.
+    std::vector<ionex_raw_type>     _map_buf;     ///< Raw map (when streaming
+    ///< off a file).
+    std::vector<std::uint64_t>      _mask_buf;    ///< Validity bitmask of
+    ///< _map_buf (at the level used).
+
+}; // end ionex_cursor
+
+/// Drain a cursor (expected to produce nepochs epochs) into a vector of
+/// vectors, where vec[i][j] is the value at point i at the j-th epoch; this
+/// is the result layout of ionex::interpolate().
+std::vector<std::vector<double>>
+collect_rows(ionex_cursor& cursor, std::size_t nepochs);
+
+} // end ngpt
+
+#endif
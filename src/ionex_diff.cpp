@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <stdexcept>
+#include "ionex_diff.hpp"
+
+using ngpt::ionex_diff;
+
+ionex_diff::ionex_diff(ionex_cursor& reference, ionex_cursor& product)
+    : _reference(reference),
+      _product(product),
+      _ref(reference.points()),
+      _cells(reference.points()),
+      _epochs(0)
+{
+    if ( product.points() != reference.points() ) {
+        throw std::runtime_error
+            ("ionex_diff::ionex_diff() -> cursors of different points.");
+    }
+}
+
+/**
+ *  \details Both cursors are moved to their next epoch; the (product) row is
+ *           computed in place in diff and the reference row is subtracted.
+ */
+bool
+ionex_diff::next(datetime_ms& epoch, double* diff)
+{
+    datetime_ms tr, tp;
+    const bool more_ref = _reference.next(tr, _ref.data());
+    const bool more_prd = _product.next(tp, diff);
+    if ( !more_ref && !more_prd ) { return false; }
+    if ( more_ref != more_prd || !(tr == tp) ) {
+        throw std::runtime_error
+            ("ionex_diff::next() -> cursors of different epochs.");
+    }
+
+    const std::size_t n = _ref.size();
+    const double* ref = _ref.data();
+    for (std::size_t i=0; i<n; ++i) { diff[i] -= ref[i]; }
+    for (std::size_t i=0; i<n; ++i) {
+        _cells[i].add( diff[i] );
+        _total.add( diff[i] );
+    }
+
+    ++_epochs;
+    epoch = tr;
+    return true;
+}
+
+/**
+ *  \details With interval <= 0, the epochs of the reference maps are used;
+ *           the product maps are then interpolated (in time) at these epochs.
+ *           The result is empty if the products (and [from, to]) do not
+ *           overlap.
+ */
+std::vector<ionex_diff::datetime_ms>
+ionex_diff::align_epochs(const std::vector<datetime_ms>& reference_maps,
+                         const std::vector<datetime_ms>& product_maps,
+                         datetime_ms from, datetime_ms to, int interval)
+{
+    std::vector<datetime_ms> epochs;
+    if ( reference_maps.empty() || product_maps.empty() ) { return epochs; }
+
+    // the common span
+    if ( from < reference_maps.front() ) { from = reference_maps.front(); }
+    if ( from < product_maps.front()   ) { from = product_maps.front();   }
+    if ( reference_maps.back() < to    ) { to   = reference_maps.back();  }
+    if ( product_maps.back() < to      ) { to   = product_maps.back();    }
+    if ( to < from ) { return epochs; }
+
+    if ( interval > 0 ) {
+        for (datetime_ms t = from; !(to < t); t.add_seconds(interval*1000L)) {
+            epochs.push_back( t );
+        }
+    } else {
+        epochs.assign(
+            std::lower_bound(reference_maps.cbegin(), reference_maps.cend(),
+                             from),
+            std::upper_bound(reference_maps.cbegin(), reference_maps.cend(),
+                             to));
+    }
+    return epochs;
+}
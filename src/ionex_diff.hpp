@@ -0,0 +1,135 @@
+#ifndef __IONEX_DIFF_NGPT_
+#define __IONEX_DIFF_NGPT_
+
+#include <vector>
+#include "ionex.hpp"
+#include "ionex_cursor.hpp"
+#include "running_stats.hpp"
+
+/**
+ * \file
+ *
+ * \version
+ *
+ * \author    xanthos@mail.ntua.gr <br>
+ *            danast@mail.ntua.gr
+ *
+ * \date
+ *
+ * \brief     Streaming differences (and their statistics) between two IONEX
+ *            products.
+ *
+ * \copyright Copyright © 2015 Dionysos Satellite Observatory, <br>
+ *            National Technical University of Athens. <br>
+ *            This work is free. You can redistribute it and/or modify it under
+ *            the terms of the Do What The Fuck You Want To Public License,
+ *            Version 2, as published by Sam Hocevar. See http://www.wtfpl.net/
+ *            for more details.
+ *
+ * <b><center><hr>
+ * National Technical University of Athens <br>
+ *      Dionysos Satellite Observatory     <br>
+ *        Higher Geodesy Laboratory        <br>
+ *      http://dionysos.survey.ntua.gr
+ * <hr></center></b>
+ *
+ */
+
+namespace ngpt
+{
+
+/*
+ * \class   ionex_diff
+ *
+ * \details Differences between two IONEX products (e.g. from two analysis
+ *          centres), i.e. product minus reference, computed epoch by epoch off
+ *          two cursors (see ionex_cursor) set up for the same points and the
+ *          same (list of) epochs. Each cursor interpolates its own maps at the
+ *          points, so products on different grids (or with maps at different
+ *          epochs) are regridded (bilinear) and aligned (linear in time) onto
+ *          the common points and epochs; see align_epochs() for a common
+ *          epoch axis.
+ *
+ *          Each call to next() gives the difference map of one epoch; the
+ *          statistics of every point (cell) and of all points are updated on
+ *          the way, so one pass over the epochs gives both the difference
+ *          maps and the summary. Only the current rows are kept (memory does
+ *          not depend on the number of epochs); missing values (NaN) are left
+ *          out of the statistics.
+ *
+ * \warning The cursors must outlive the instance.
+ */
+class ionex_diff
+{
+public:
+    typedef ionex::datetime_ms datetime_ms;
+
+    /// Constructor off the cursors of the reference and the product.
+    /// \throw std::runtime_error if the cursors have a different number of
+    ///        points.
+    ionex_diff(ionex_cursor& reference, ionex_cursor& product);
+
+    /// Copy not allowed !
+    ionex_diff(const ionex_diff&) = delete;
+
+    /// Assignment not allowed !
+    ionex_diff& operator=(const ionex_diff&) = delete;
+
+    /// Number of points (i.e. differences per epoch).
+    std::size_t points() const noexcept { return _ref.size(); }
+
+    /// Compute the differences (product - reference) at all points at the
+    /// next epoch into diff (of at least points() values) and update the
+    /// statistics. Returns false when there are no more epochs.
+    /// \throw std::runtime_error if the cursors give different epochs, or if
+    ///        a map cannot be read.
+    bool next(datetime_ms& epoch, double* diff);
+
+    /// Call f(epoch, differences) for every (remaining) epoch, using buf (of
+    /// at least points() values) as the row buffer; stop if f returns false.
+    /// Returns the number of epochs processed.
+    template<typename F>
+    std::size_t
+    for_each(double* buf, F&& f)
+    {
+        std::size_t n = 0;
+        datetime_ms t;
+        while ( this->next(t, buf) ) {
+            ++n;
+            if ( !f(static_cast<const datetime_ms&>(t),
+                    static_cast<const double*>(buf)) ) { break; }
+        }
+        return n;
+    }
+
+    /// Statistics of the differences at every point (so far).
+    const std::vector<running_stats>& cells() const noexcept
+    { return _cells; }
+
+    /// Statistics of the differences at all points and epochs (so far).
+    const running_stats& total() const noexcept { return _total; }
+
+    /// Number of epochs processed (so far).
+    std::size_t epochs() const noexcept { return _epochs; }
+
+    /// The epochs common to two products, i.e. within the span of both, and
+    /// within [from, to]: every interval seconds if interval > 0, else the
+    /// epochs of the reference maps.
+    static std::vector<datetime_ms>
+    align_epochs(const std::vector<datetime_ms>& reference_maps,
+                 const std::vector<datetime_ms>& product_maps,
+                 datetime_ms from, datetime_ms to, int interval);
+
+private:
+    ionex_cursor&              _reference; ///< Cursor over the reference.
+    ionex_cursor&              _product;   ///< Cursor over the product.
+    std::vector<double>        _ref;       ///< Reference row (current epoch).
+    std::vector<running_stats> _cells;     ///< Statistics per point.
+    running_stats              _total;     ///< Statistics of all points.
+    std::size_t                _epochs;    ///< Epochs processed.
+
+}; // end ionex_diff
+
+} // end ngpt
+
+#endif
@@ -0,0 +1,87 @@
+#include <stdexcept>
+#include <utility>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "mmfile.hpp"
+
+using ngpt::mapped_file;
+
+/**
+ *  \details Map the whole file (read-only) into memory. The file descriptor
+ *           is closed right after the mapping is created (the mapping stays
+ *           valid).
+ *
+ *  \throw   std::runtime_error if the file cannot be opened or mapped.
+ */
+mapped_file::mapped_file(const char* filename)
+    : _filename(filename),
+      _data(nullptr),
+      _size(0)
+{
+    int fd = ::open(filename, O_RDONLY);
+    if ( fd < 0 ) {
+        throw std::runtime_error
+            ("Cannot open file: " + std::string(filename) );
+    }
+
+    struct stat st;
+    if ( ::fstat(fd, &st) ) {
+        ::close(fd);
+        throw std::runtime_error
+            ("Cannot stat file: " + std::string(filename) );
+    }
+
+    // mmap does not like zero-length mappings; nothing to map anyway.
+    if ( st.st_size > 0 ) {
+        void* addr = ::mmap(nullptr, static_cast<std::size_t>(st.st_size),
+                            PROT_READ, MAP_PRIVATE, fd, 0);
+        if ( addr == MAP_FAILED ) {
+            ::close(fd);
+            throw std::runtime_error
+                ("Cannot map file: " + std::string(filename) );
+        }
+        // we are (mostly) going to walk the file from top to bottom.
+        ::madvise(addr, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+        _data = static_cast<const char*>( addr );
+        _size = static_cast<std::size_t>( st.st_size );
+    }
+
+    ::close(fd);
+}
+
+mapped_file::~mapped_file() noexcept { this->unmap(); }
+
+mapped_file::mapped_file(mapped_file&& other) noexcept
+    : _filename(std::move(other._filename)),
+      _data(other._data),
+      _size(other._size)
+{
+    other._data = nullptr;
+    other._size = 0;
+}
+
+mapped_file&
+mapped_file::operator=(mapped_file&& other) noexcept
+{
+    if ( this != &other ) {
+        this->unmap();
+        _filename   = std::move( other._filename );
+        _data       = other._data;
+        _size       = other._size;
+        other._data = nullptr;
+        other._size = 0;
+    }
+    return *this;
+}
+
+void
+mapped_file::unmap() noexcept
+{
+    if ( _data ) {
+        ::munmap(const_cast<char*>(_data), _size);
+        _data = nullptr;
+        _size = 0;
+    }
+}
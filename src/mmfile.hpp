@@ -0,0 +1,95 @@
+#ifndef __NGPT_MMFILE_HPP__
+#define __NGPT_MMFILE_HPP__
+
+#include <cstddef>
+#include <string>
+
+/**
+ * \file
+ *
+ * \version
+ *
+ * \author    xanthos@mail.ntua.gr <br>
+ *            danast@mail.ntua.gr
+ *
+ * \date
+ *
+ * \brief     A read-only, memory-mapped file.
+ *
+ * \copyright Copyright © 2015 Dionysos Satellite Observatory, <br>
+ *            National Technical University of Athens. <br>
+ *            This work is free. You can redistribute it and/or modify it under
+ *            the terms of the Do What The Fuck You Want To Public License,
+ *            Version 2, as published by Sam Hocevar. See http://www.wtfpl.net/
+ *            for more details.
+ *
+ * <b><center><hr>
+ * National Technical University of Athens <br>
+ *      Dionysos Satellite Observatory     <br>
+ *        Higher Geodesy Laboratory        <br>
+ *      http://dionysos.survey.ntua.gr
+ * <hr></center></b>
+ *
+ */
+
+namespace ngpt
+{
+
+/*
+ * \class   mapped_file
+ *
+ * \details A (whole) file, mapped read-only into memory (POSIX mmap). The
+ *          mapping lives as long as the instance does; the file contents can
+ *          be accessed via data() (for size() bytes) with no copies and no
+ *          stream state.
+ *
+ * \warning The mapped memory is **not** null-terminated. An empty file results
+ *          in an instance with data() == nullptr and size() == 0.
+ */
+class mapped_file
+{
+public:
+    /// Constructor from filename; throws std::runtime_error if the file
+    /// cannot be opened/mapped.
+    explicit mapped_file(const char*);
+
+    /// Destructor; unmaps the file.
+    ~mapped_file() noexcept;
+
+    /// Copy not allowed !
+    mapped_file(const mapped_file&) = delete;
+
+    /// Assignment not allowed !
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    /// Move constructor.
+    mapped_file(mapped_file&&) noexcept;
+
+    /// Move assignment operator.
+    mapped_file& operator=(mapped_file&&) noexcept;
+
+    /// Pointer to the first byte of the file.
+    const char* data() const noexcept { return _data; }
+
+    /// Pointer past the last byte of the file.
+    const char* end() const noexcept { return _data + _size; }
+
+    /// Size of the file in bytes.
+    std::size_t size() const noexcept { return _size; }
+
+    /// The name of the mapped file.
+    std::string filename() const noexcept { return _filename; }
+
+private:
+    /// Unmap the file (if mapped).
+    void unmap() noexcept;
+
+    std::string _filename; ///< The name of the mapped file.
+    const char* _data;     ///< Start of the mapping (or nullptr).
+    std::size_t _size;     ///< Size of the mapping in bytes.
+
+}; // end mapped_file
+
+} // end ngpt
+
+#endif
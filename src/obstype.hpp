@@ -480,6 +480,15 @@ public:
     raw_obs(std::size_t i)
     const
     { return std::get<1>( cov_[i] ); }
+
+    /// \brief   Get the coefficient of the i-th raw observable.
+    ///
+    /// \warning No range check is performed to validate the index
+    ///
+    double
+    coefficient(std::size_t i)
+    const noexcept
+    { return std::get<0>( cov_[i] ); }
     
 #ifdef DEBUG
     friend
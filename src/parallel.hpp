@@ -0,0 +1,107 @@
+#ifndef __NGPT_PARALLEL_HPP__
+#define __NGPT_PARALLEL_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+/**
+ * \file
+ *
+ * \version
+ *
+ * \author    xanthos@mail.ntua.gr <br>
+ *            danast@mail.ntua.gr
+ *
+ * \date
+ *
+ * \brief     Minimal tools for running independent jobs on a pool of threads.
+ *
+ * \copyright Copyright © 2015 Dionysos Satellite Observatory, <br>
+ *            National Technical University of Athens. <br>
+ *            This work is free. You can redistribute it and/or modify it under
+ *            the terms of the Do What The Fuck You Want To Public License,
+ *            Version 2, as published by Sam Hocevar. See http://www.wtfpl.net/
+ *            for more details.
+ *
+ * <b><center><hr>
+ * National Technical University of Athens <br>
+ *      Dionysos Satellite Observatory     <br>
+ *        Higher Geodesy Laboratory        <br>
+ *      http://dionysos.survey.ntua.gr
+ * <hr></center></b>
+ *
+ */
+
+namespace ngpt
+{
+
+/// The number of threads to use, given a requested number (0 means one per
+/// hardware thread) and the number of jobs.
+inline unsigned
+pool_size(unsigned requested, std::size_t jobs) noexcept
+{
+    unsigned threads = requested ? requested
+                                 : std::thread::hardware_concurrency();
+    if ( !threads ) { threads = 1; }
+    if ( jobs < threads ) { threads = static_cast<unsigned>( jobs ); }
+    return threads ? threads : 1;
+}
+
+/** Call job(i) for every i in [0, n), on a pool of (at most) threads worker
+ *  threads; the calling thread is one of them. Jobs are handed out one at a
+ *  time (i.e. dynamic scheduling), so they may have very different costs.
+ *  If any job throws, no new jobs are started and the (first) exception is
+ *  re-thrown (in the calling thread) after all workers are done. If a worker
+ *  thread cannot be created, the jobs run on the threads already started.
+ *
+ *  \param[in] n       The number of jobs.
+ *  \param[in] job     A callable with signature void(std::size_t); calls with
+ *                     different indexes run concurrently.
+ *  \param[in] threads Max number of threads to use; 0 means one per hardware
+ *                     thread.
+ */
+template<typename F>
+void
+parallel_for(std::size_t n, F&& job, unsigned threads = 0)
+{
+    if ( !n ) { return; }
+    threads = pool_size( threads, n );
+
+    std::atomic<std::size_t> next { 0 };
+    std::exception_ptr       error;
+    std::mutex               error_mtx;
+
+    auto worker = [&]() {
+        for (std::size_t i = next++; i < n; i = next++) {
+            try {
+                job( i );
+            } catch (...) {
+                std::lock_guard<std::mutex> lock ( error_mtx );
+                if ( !error ) { error = std::current_exception(); }
+                next = n;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve( threads - 1 );
+    try {
+        for (unsigned t=1; t<threads; ++t) { pool.emplace_back( worker ); }
+    } catch (std::system_error&) {
+        // out of threads; go on with the ones already started.
+    }
+    worker();
+    for (auto& t : pool) { t.join(); }
+
+    if ( error ) { std::rethrow_exception( error ); }
+}
+
+} // end ngpt
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef __NGPT_PCV_BATCH_HPP__
+#define __NGPT_PCV_BATCH_HPP__
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "antpcv.hpp"
+
+/**
+ * \file      pcv_batch.hpp
+ *
+ * \version
+ *
+ * \author    xanthos@mail.ntua.gr <br>
+ *            danast@mail.ntua.gr
+ *
+ * \date
+ *
+ * \brief     Batched evaluation of antenna phase center variations over
+ *            arrays of zenith (and azimuth) angles.
+ *
+ * \copyright Copyright © 2015 Dionysos Satellite Observatory, <br>
+ *            National Technical University of Athens. <br>
+ *            This work is free. You can redistribute it and/or modify it under
+ *            the terms of the Do What The Fuck You Want To Public License,
+ *            Version 2, as published by Sam Hocevar. See http://www.wtfpl.net/
+ *            for more details.
+ *
+ * <b><center><hr>
+ * National Technical University of Athens <br>
+ *      Dionysos Satellite Observatory     <br>
+ *        Higher Geodesy Laboratory        <br>
+ *      http://dionysos.survey.ntua.gr
+ * <hr></center></b>
+ *
+ */
+
+namespace ngpt
+{
+
+/*
+ * \class   pcv_batch
+ *
+ * \details Evaluation of the pcv values of an antenna_pcv<T> pattern at a
+ *          (fixed) set of points, for any number of its frequencies. As in
+ *          bilinear_batch, the cell of every point (i.e. the index of its
+ *          first node in the pcv vector) and its interpolation weights are
+ *          computed once (see set_points()) and stored in SoA layout; the
+ *          pcv values of a frequency are then interpolated (see apply()) in a
+ *          branch-free gather-and-multiply-add loop, writing into a caller
+ *          buffer. Since all frequencies of a pattern share its grid, the
+ *          cells are reused for every frequency.
+ *
+ *          Points given with azimuth are interpolated (bilinearly) off the
+ *          'AZI' values, if the pattern has any; else (or if no azimuths are
+ *          given) off the 'NOAZI' values (linearly, on the zenith angle).
+ *          Azimuths are reduced to [0, 360) first. Points on the last node
+ *          of an axis are assigned to the last cell, with a zero weight for
+ *          the (non-existing) next node.
+ *
+ * \warning The instance holds a pointer to the pattern, which must outlive
+ *          it (e.g. hold on to the pcv handle). The grid must have at least
+ *          two nodes on each axis.
+ */
+template<typename T>
+class pcv_batch
+{
+public:
+    /// Constructor from the pattern to evaluate.
+    explicit pcv_batch(const antenna_pcv<T>& pcv) noexcept
+        : _pcv(&pcv), _azi(false),
+          _nzen(pcv.no_azi_grid_pts()),
+          _nazi(pcv.has_azi_pcv() && _nzen ? pcv.azi_grid_pts() / _nzen : 0)
+    {}
+
+    /// Number of points set.
+    std::size_t size() const noexcept { return _index.size(); }
+
+    /// Are the points interpolated off the 'AZI' values ?
+    bool azimuth_dependent() const noexcept { return _azi; }
+
+    /** Compute (and store) the cells and weights for n points, given as
+     *  separate zenith and azimuth arrays (in degrees); azimuth may be
+     *  nullptr (i.e. 'NOAZI' values). Any previously set points are
+     *  cleared.
+     *
+     *  \return 0 on success; else the (1-based) index of the first point
+     *          outside the grid (in which case no points are set).
+     */
+    std::size_t
+    set_points(const T* zenith, const T* azimuth, std::size_t n)
+    {
+        this->clear();
+        _azi = azimuth && _nazi;
+        if ( _nzen < 2 || (_azi && _nazi < 2) ) { return n ? 1 : 0; }
+
+        // tolerance (in cells) for points on the grid limits
+        constexpr double eps { 1e-6 };
+        const double zmax = static_cast<double>(_nzen - 1);
+        const double amax = static_cast<double>(_nazi - 1);
+        const double zen1 = _pcv->zen1(), dzen = _pcv->dzen();
+
+        _index.resize(n); _wz.resize(n);
+        if ( _azi ) { _wa.resize(n); }
+
+        for (std::size_t i=0; i<n; ++i) {
+            double u = (zenith[i] - zen1) / dzen;
+            if ( !(u >= -eps && u <= zmax+eps) ) {
+                this->clear();
+                return i+1;
+            }
+            double fu = std::floor(u);
+            if ( fu < 0e0 )       { fu = 0e0; }
+            if ( fu > zmax-1e0 )  { fu = zmax-1e0; }
+            _index[i] = static_cast<std::size_t>(fu);
+            _wz[i]    = static_cast<T>(u - fu);
+            if ( _azi ) {
+                double a = std::fmod(static_cast<double>(azimuth[i]), 360e0);
+                if ( a < 0e0 ) { a += 360e0; }
+                double v = (a - antenna_pcv_details::azi1) / _pcv->dazi();
+                if ( !(v <= amax+eps) ) {
+                    this->clear();
+                    return i+1;
+                }
+                double fv = std::floor(v);
+                if ( fv > amax-1e0 ) { fv = amax-1e0; }
+                _index[i] += static_cast<std::size_t>(fv) * _nzen;
+                _wa[i]     = static_cast<T>(v - fv);
+            }
+        }
+        return 0;
+    }
+
+    /** Interpolate the pcv values of the i-th frequency of the pattern for
+     *  all points set; out must have (at least) size() elements.
+     */
+    void
+    apply(std::size_t freq, T* out) const noexcept
+    {
+        const frequency_pcv<T>& f = _pcv->freq_pcv_pattern(freq);
+        const std::size_t  n   = _index.size();
+        const std::size_t* idx = _index.data();
+        const T*           wz  = _wz.data();
+        if ( _azi ) {
+            assert( f.azi_size() == _nzen * _nazi );
+            const std::size_t nx  = _nzen;
+            const T*          map = f.azi_vector_c().data();
+            const T*          wa  = _wa.data();
+            for (std::size_t i=0; i<n; ++i) {
+                const T* c = map + idx[i];
+                const T  lo = c[0]  + wz[i] * (c[1]    - c[0]);
+                const T  hi = c[nx] + wz[i] * (c[nx+1] - c[nx]);
+                out[i] = lo + wa[i] * (hi - lo);
+            }
+        } else {
+            assert( f.no_azi_size() == _nzen );
+            const T* vec = f.no_azi_vector_c().data();
+            for (std::size_t i=0; i<n; ++i) {
+                const T* c = vec + idx[i];
+                out[i] = c[0] + wz[i] * (c[1] - c[0]);
+            }
+        }
+    }
+
+    /** Interpolate the pcv values of nf frequencies (given by their indexes
+     *  in the pattern) for all points set; the values of the k-th frequency
+     *  are written at out[k*size() ... (k+1)*size()-1].
+     */
+    void
+    apply(const std::size_t* freqs, std::size_t nf, T* out) const noexcept
+    {
+        const std::size_t n = _index.size();
+        for (std::size_t k=0; k<nf; ++k) { this->apply(freqs[k], out + k*n); }
+    }
+
+    /// The index (in the pcv vector) of the first node of the i-th point's
+    /// cell.
+    std::size_t cell_index(std::size_t i) const noexcept { return _index[i]; }
+
+private:
+    /// Drop all points.
+    void
+    clear() noexcept
+    { _index.clear(); _wz.clear(); _wa.clear(); }
+
+    const antenna_pcv<T>* _pcv;  ///< The pattern.
+    bool        _azi;            ///< Points interpolated off 'AZI' values ?
+    std::size_t _nzen;           ///< Number of zenith nodes.
+    std::size_t _nazi;           ///< Number of azimuth nodes (0 if 'NOAZI').
+    std::vector<std::size_t> _index; ///< Cell (first node) index per point.
+    std::vector<T> _wz;          ///< Weight of the next zenith node per point.
+    std::vector<T> _wa;          ///< Weight of the next azimuth node per point.
+
+}; // end pcv_batch
+
+} // end ngpt
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef __NGPT_PCV_CACHE_HPP__
+#define __NGPT_PCV_CACHE_HPP__
+
+#include <cstddef>
+#include <ios>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include "antpcv.hpp"
+
+/**
+ * \file
+ *
+ * \version
+ *
+ * \author    xanthos@mail.ntua.gr <br>
+ *            danast@mail.ntua.gr
+ *
+ * \date
+ *
+ * \brief     A memory-bounded (LRU) cache of parsed antenna calibration
+ *            patterns.
+ *
+ * \copyright Copyright © 2015 Dionysos Satellite Observatory, <br>
+ *            National Technical University of Athens. <br>
+ *            This work is free. You can redistribute it and/or modify it under
+ *            the terms of the Do What The Fuck You Want To Public License,
+ *            Version 2, as published by Sam Hocevar. See http://www.wtfpl.net/
+ *            for more details.
+ *
+ * <b><center><hr>
+ * National Technical University of Athens <br>
+ *      Dionysos Satellite Observatory     <br>
+ *        Higher Geodesy Laboratory        <br>
+ *      http://dionysos.survey.ntua.gr
+ * <hr></center></b>
+ *
+ */
+
+namespace ngpt
+{
+
+/*
+ * \class   pcv_cache
+ *
+ * \details Parsed antenna_pcv<T> patterns, keyed by the position of their
+ *          record in the (ANTEX) file, handed out as shared, immutable
+ *          handles. The memory held by the cached patterns (see
+ *          antenna_pcv::bytes()) is bounded; when a new pattern does not fit,
+ *          the least recently used ones are evicted. A pattern larger than the
+ *          bound is handed out but not kept. Handles stay valid after their
+ *          pattern is evicted (or the cache is cleared/destroyed), so the
+ *          bound only applies to the patterns held by the cache itself.
+ *
+ * \warning Not thread-safe (nor is the antex it serves).
+ */
+template<typename T>
+class pcv_cache
+{
+public:
+    /// Shared, immutable handle to a pattern.
+    typedef std::shared_ptr<const antenna_pcv<T>> handle;
+
+    /// Key of a pattern, i.e. the position of its record in the file.
+    typedef std::streamoff key_type;
+
+    /// Default memory bound (bytes).
+    static constexpr std::size_t default_capacity { 8 * 1024 * 1024 };
+
+    /// Constructor; max_bytes is the memory bound.
+    explicit pcv_cache(std::size_t max_bytes = default_capacity) noexcept
+        : _capacity(max_bytes), _bytes(0), _hits(0), _misses(0), _evictions(0)
+    {}
+
+    /// The pattern of a key, marked as most recently used; nullptr if not
+    /// cached. Counts a hit or a miss.
+    handle
+    find(key_type key)
+    {
+        auto it = _map.find(key);
+        if ( it == _map.end() ) {
+            ++_misses;
+            return nullptr;
+        }
+        ++_hits;
+        _lru.splice(_lru.begin(), _lru, it->second);
+        return it->second->pcv;
+    }
+
+    /// Cache a (newly parsed) pattern under a key (replacing any previous
+    /// one), evicting least recently used patterns as needed; returns its
+    /// handle.
+    handle
+    insert(key_type key, antenna_pcv<T>&& pcv)
+    {
+        const std::size_t sz = pcv.bytes();
+        handle h { std::make_shared<const antenna_pcv<T>>(std::move(pcv)) };
+        this->erase(key);
+        if ( sz > _capacity ) { return h; }
+        this->shrink(_capacity - sz);
+        _lru.push_front( entry {key, h, sz} );
+        _map.emplace(key, _lru.begin());
+        _bytes += sz;
+        return h;
+    }
+
+    /// Drop all cached patterns (counters are not reset).
+    void
+    clear() noexcept
+    {
+        _map.clear();
+        _lru.clear();
+        _bytes = 0;
+    }
+
+    /// Set the memory bound, evicting patterns as needed.
+    void
+    set_capacity(std::size_t max_bytes)
+    {
+        _capacity = max_bytes;
+        this->shrink(_capacity);
+    }
+
+    /// The memory bound (bytes).
+    std::size_t capacity() const noexcept { return _capacity; }
+
+    /// Memory held by the cached patterns (bytes).
+    std::size_t bytes() const noexcept { return _bytes; }
+
+    /// Number of cached patterns.
+    std::size_t size() const noexcept { return _lru.size(); }
+
+    /// Number of lookups found in the cache.
+    std::size_t hits() const noexcept { return _hits; }
+
+    /// Number of lookups not found in the cache.
+    std::size_t misses() const noexcept { return _misses; }
+
+    /// Number of patterns evicted (to make space).
+    std::size_t evictions() const noexcept { return _evictions; }
+
+private:
+    /// A cached pattern.
+    struct entry
+    {
+        key_type    key;
+        handle      pcv;
+        std::size_t bytes;
+    };
+
+    /// Remove the pattern of a key (if cached).
+    void
+    erase(key_type key)
+    {
+        auto it = _map.find(key);
+        if ( it != _map.end() ) {
+            _bytes -= it->second->bytes;
+            _lru.erase(it->second);
+            _map.erase(it);
+        }
+    }
+
+    /// Evict least recently used patterns until at most max_bytes are held.
+    void
+    shrink(std::size_t max_bytes)
+    {
+        while ( _bytes > max_bytes && !_lru.empty() ) {
+            _bytes -= _lru.back().bytes;
+            _map.erase(_lru.back().key);
+            _lru.pop_back();
+            ++_evictions;
+        }
+    }
+
+    std::list<entry> _lru; ///< Cached patterns, most recently used first.
+    std::unordered_map<key_type, typename std::list<entry>::iterator> _map;
+    ///< Position of every key in _lru.
+    std::size_t _capacity;  ///< Memory bound (bytes).
+    std::size_t _bytes;     ///< Memory held (bytes).
+    std::size_t _hits;      ///< Lookups found.
+    std::size_t _misses;    ///< Lookups not found.
+    std::size_t _evictions; ///< Patterns evicted.
+
+}; // end pcv_cache
+
+template<typename T>
+constexpr std::size_t pcv_cache<T>::default_capacity;
+
+} // end ngpt
+
+#endif
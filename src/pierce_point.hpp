@@ -0,0 +1,129 @@
+#ifndef __IONOSPHERIC_PIERCE_POINT__
+#define __IONOSPHERIC_PIERCE_POINT__
+
+#include <cmath>
+#include <cstddef>
+#include "car2ell.hpp"
+#include "car2top.hpp"
+#include "geoconst.hpp"
+
+namespace ngpt {
+
+/** \details  Compute the ionospheric pierce points (i.e. the points where the
+ *            receiver-to-satellite line of sight crosses a spherical shell of
+ *            height H above a sphere of radius R; the single-layer model of
+ *            IONEX) and the respective mapping (i.e. slant) factors, for n
+ *            observations given as arrays (SoA). This is a template function,
+ *            depending on the ellipsoid parameter; see ellipsoid.hpp
+ *
+ *  \param[in]  x      Receiver cartesian x-components, meters (n values).
+ *  \param[in]  y      Receiver cartesian y-components, meters (n values).
+ *  \param[in]  z      Receiver cartesian z-components, meters (n values).
+ *  \param[in]  az     Azimouths of the satellites, radians (n values).
+ *  \param[in]  el     Elevations of the satellites, radians (n values).
+ *  \param[in]  n      Number of observations.
+ *  \param[in]  radius Radius of the (spherical) earth, e.g. the IONEX base
+ *                     radius.
+ *  \param[in]  height Height of the shell above the sphere, in the same
+ *                     units as radius.
+ *  \param[out] lat    Latitudes of the pierce points, degrees (n values).
+ *  \param[out] lon    Longtitudes of the pierce points, degrees (n values).
+ *                     They are in the range (-360, 360]; wrap them as needed.
+ *  \param[out] mf     Mapping factors, i.e. slant TEC = mf * vertical TEC
+ *                     (n values).
+ *
+ *  \throw    Does not throw.
+ *
+ *  \note     Inputs and outputs are plain arrays (SoA), so that the loop is
+ *            friendly to compiler vectorization. The output arrays may be the
+ *            same as the az/el input arrays.
+ *
+ *  Reference: Schaer, S., Gurtner, W., Feltens, J., "IONEX: The IONosphere Map
+ *            EXchange Format Version 1", eq. (2)
+ */
+template<ellipsoid E>
+void
+pierce_points(const double* x,  const double* y,  const double* z,
+              const double* az, const double* el, std::size_t n,
+              double radius,    double height,
+              double* lat,      double* lon,      double* mf)
+noexcept
+{
+    constexpr double rad2deg { 180e0 / ngpt::DPI };
+    const double ratio { radius / (radius + height) };
+
+    double phi, lambda, h;
+    for (std::size_t i=0; i<n; ++i) {
+        // Read the inputs first; the outputs may alias them (element-wise).
+        const double a { az[i] };
+        const double e { el[i] };
+        // Receiver (ellipsoidal) latitude and longtitude.
+        ngpt::car2ell<E>(x[i], y[i], z[i], phi, lambda, h);
+        // Zenith distance at the pierce point.
+        double sinzp { ratio * std::cos(e) };
+        double zp    { std::asin(sinzp) };
+        // Geocentric angle between the receiver and the pierce point.
+        double psi   { ngpt::DPI/2e0 - e - zp };
+        double sinp  { std::sin(psi) };
+        double cosp  { std::cos(psi) };
+        double sinf  { std::sin(phi) };
+        double cosf  { std::cos(phi) };
+        double sinl  { sinf*cosp + cosf*sinp*std::cos(a) };
+        double dlon  { std::atan2(sinp*std::sin(a)*cosf, cosp - sinf*sinl) };
+        lat[i] = std::asin(sinl) * rad2deg;
+        lon[i] = (lambda + dlon) * rad2deg;
+        mf[i]  = 1e0 / std::sqrt(1e0 - sinzp*sinzp);
+    }
+
+    // Finished.
+    return;
+}
+
+/** \details  Same as above, only the line of sight of every observation is
+ *            given as a pair of cartesian vectors (receiver and satellite).
+ *            The azimouth and elevation of each satellite are computed (via
+ *            car2top) into the lat and lon arrays, which are then used as
+ *            (aliased) input/output.
+ *
+ *  \param[in]  x      Receiver cartesian x-components, meters (n values).
+ *  \param[in]  y      Receiver cartesian y-components, meters (n values).
+ *  \param[in]  z      Receiver cartesian z-components, meters (n values).
+ *  \param[in]  sx     Satellite cartesian x-components, meters (n values).
+ *  \param[in]  sy     Satellite cartesian y-components, meters (n values).
+ *  \param[in]  sz     Satellite cartesian z-components, meters (n values).
+ *  \param[in]  n      Number of observations.
+ *  \param[in]  radius See above.
+ *  \param[in]  height See above.
+ *  \param[out] lat    See above.
+ *  \param[out] lon    See above.
+ *  \param[out] mf     See above.
+ *
+ *  \throw    Does not throw.
+ */
+template<ellipsoid E>
+void
+pierce_points(const double* x,  const double* y,  const double* z,
+              const double* sx, const double* sy, const double* sz,
+              std::size_t n,
+              double radius,    double height,
+              double* lat,      double* lon,      double* mf)
+noexcept
+{
+    double north, east, up;
+    for (std::size_t i=0; i<n; ++i) {
+        ngpt::car2top<E>(x[i], y[i], z[i], sx[i], sy[i], sz[i],
+                         north, east, up);
+        lat[i] = std::atan2(east, north);
+        lon[i] = std::atan2(up, std::sqrt(north*north + east*east));
+    }
+
+    // lat/lon now hold the azimouths/elevations.
+    pierce_points<E>(x, y, z, lat, lon, n, radius, height, lat, lon, mf);
+
+    // Finished.
+    return;
+}
+
+} // end namespace
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef __NGPT_RUNNING_STATS_HPP__
+#define __NGPT_RUNNING_STATS_HPP__
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+/**
+ * \file
+ *
+ * \version
+ *
+ * \author    xanthos@mail.ntua.gr <br>
+ *            danast@mail.ntua.gr
+ *
+ * \date
+ *
+ * \brief     Single-pass (streaming) summary statistics of a series.
+ *
+ * \copyright Copyright © 2015 Dionysos Satellite Observatory, <br>
+ *            National Technical University of Athens. <br>
+ *            This work is free. You can redistribute it and/or modify it under
+ *            the terms of the Do What The Fuck You Want To Public License,
+ *            Version 2, as published by Sam Hocevar. See http://www.wtfpl.net/
+ *            for more details.
+ *
+ * <b><center><hr>
+ * National Technical University of Athens <br>
+ *      Dionysos Satellite Observatory     <br>
+ *        Higher Geodesy Laboratory        <br>
+ *      http://dionysos.survey.ntua.gr
+ * <hr></center></b>
+ *
+ */
+
+namespace ngpt
+{
+
+/*
+ * \class   running_stats
+ *
+ * \details Count, mean, standard deviation, rms, min and max of a series of
+ *          values, updated one value at a time (Welford's algorithm), so that
+ *          no value need be kept. NaN values (e.g. missing) are not counted.
+ *          Two instances (e.g. off parts of a series) can be merged.
+ */
+class running_stats
+{
+public:
+    /// Add a value (NaN values are ignored).
+    void
+    add(double x) noexcept
+    {
+        if ( x != x ) { return; }
+        ++_count;
+        const double delta = x - _mean;
+        _mean  += delta / static_cast<double>(_count);
+        _m2    += delta * (x - _mean);
+        _sumsq += x * x;
+        if ( x < _min ) { _min = x; }
+        if ( x > _max ) { _max = x; }
+    }
+
+    /// Merge in the statistics of another (disjoint) series.
+    void
+    merge(const running_stats& o) noexcept
+    {
+        if ( !o._count ) { return; }
+        if ( !_count ) { *this = o; return; }
+        const double n1 = static_cast<double>(_count),
+                     n2 = static_cast<double>(o._count);
+        const double delta = o._mean - _mean;
+        _count += o._count;
+        _mean  += delta * n2 / (n1 + n2);
+        _m2    += o._m2 + delta * delta * n1 * n2 / (n1 + n2);
+        _sumsq += o._sumsq;
+        if ( o._min < _min ) { _min = o._min; }
+        if ( o._max > _max ) { _max = o._max; }
+    }
+
+    /// Number of (non-NaN) values.
+    std::size_t count() const noexcept { return _count; }
+
+    /// Mean; NaN if no values.
+    double mean() const noexcept { return _count ? _mean : nan(); }
+
+    /// (Sample) standard deviation; NaN if less than two values.
+    double
+    stddev() const noexcept
+    {
+        return _count > 1
+            ? std::sqrt( _m2 / static_cast<double>(_count-1) )
+            : nan();
+    }
+
+    /// Root mean square; NaN if no values.
+    double
+    rms() const noexcept
+    {
+        return _count
+            ? std::sqrt( _sumsq / static_cast<double>(_count) )
+            : nan();
+    }
+
+    /// Min value; NaN if no values.
+    double min() const noexcept { return _count ? _min : nan(); }
+
+    /// Max value; NaN if no values.
+    double max() const noexcept { return _count ? _max : nan(); }
+
+private:
+    static constexpr double nan() noexcept
+    { return std::numeric_limits<double>::quiet_NaN(); }
+
+    std::size_t _count { 0 };   ///< Number of values.
+    double      _mean  { 0e0 }; ///< Running mean.
+    double      _m2    { 0e0 }; ///< Sum of squared deviations from the mean.
+    double      _sumsq { 0e0 }; ///< Sum of squares.
+    double      _min   { std::numeric_limits<double>::max() };    ///< Min.
+    double      _max   { std::numeric_limits<double>::lowest() }; ///< Max.
+
+}; // end running_stats
+
+} // end ngpt
+
+#endif
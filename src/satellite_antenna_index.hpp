@@ -0,0 +1,155 @@
+#ifndef __NGPT_SATELLITE_ANTENNA_INDEX_HPP__
+#define __NGPT_SATELLITE_ANTENNA_INDEX_HPP__
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "datetime_v2.hpp"
+
+/**
+ * \file
+ *
+ * \version
+ *
+ * \author    xanthos@mail.ntua.gr <br>
+ *            danast@mail.ntua.gr
+ *
+ * \date
+ *
+ * \brief     Index of satellite antenna calibrations by satellite (PRN or
+ *            SVN) and validity interval.
+ *
+ * \copyright Copyright © 2015 Dionysos Satellite Observatory, <br>
+ *            National Technical University of Athens. <br>
+ *            This work is free. You can redistribute it and/or modify it under
+ *            the terms of the Do What The Fuck You Want To Public License,
+ *            Version 2, as published by Sam Hocevar. See http://www.wtfpl.net/
+ *            for more details.
+ *
+ * <b><center><hr>
+ * National Technical University of Athens <br>
+ *      Dionysos Satellite Observatory     <br>
+ *        Higher Geodesy Laboratory        <br>
+ *      http://dionysos.survey.ntua.gr
+ * <hr></center></b>
+ *
+ */
+
+namespace ngpt
+{
+
+/*
+ * \class   satellite_antenna_index
+ *
+ * \details Satellite antenna calibrations (of any value type V, e.g. the
+ *          position of the record in the file) keyed by satellite, with their
+ *          validity interval [VALID FROM, VALID UNTIL). A calibration is added
+ *          off its "TYPE / SERIAL NO" record and is found by both the PRN
+ *          (serial field, e.g. "G01") and the SVN code (e.g. "G063"); since a
+ *          PRN is reassigned to different satellites (and blocks) over time,
+ *          every satellite holds a list of intervals, sorted by start epoch,
+ *          and the calibration valid at an epoch is found by a binary search,
+ *          i.e. in O(log n) for n calibrations of the satellite.
+ *
+ *          Intervals of the same satellite are not expected to overlap; if
+ *          they do, the one starting last (at or before the epoch) is used.
+ *
+ * \note    Call sort() after adding calibrations and before any lookup.
+ */
+template<typename V>
+class satellite_antenna_index
+{
+public:
+    typedef ngpt::datev2<ngpt::milliseconds> datetime_ms;
+
+    /// The end of an open interval (i.e. no VALID UNTIL record).
+    static datetime_ms
+    end_of_time()
+    { return datetime_ms(year{9999}, month{12}, day_of_month{31}); }
+
+    /// Add a calibration valid within [from, until), off its
+    /// "TYPE / SERIAL NO" record. Records with no SVN code (i.e. receiver
+    /// antennas) are ignored; returns false then.
+    bool
+    add(const std::string& record, const datetime_ms& from,
+        const datetime_ms& until, const V& value)
+    {
+        const std::string prn { _field_(record, 20, 20) };
+        const std::string svn { _field_(record, 40, 10) };
+        if ( svn.empty() ) { return false; }
+        const interval i { from, until, value };
+        if ( !prn.empty() ) { _sats[prn].push_back( i ); }
+        _sats[svn].push_back( i );
+        ++_size;
+        return true;
+    }
+
+    /// Sort the intervals of every satellite (by start epoch).
+    void
+    sort()
+    {
+        for (auto& s : _sats) {
+            std::stable_sort(s.second.begin(), s.second.end(),
+                             [](const interval& a, const interval& b)
+                             { return a.from < b.from; });
+        }
+    }
+
+    /// The calibration of a satellite (PRN or SVN) valid at epoch t; nullptr
+    /// if there is none.
+    const V*
+    find(const std::string& sat, const datetime_ms& t) const
+    {
+        const auto s = _sats.find(sat);
+        if ( s == _sats.cend() ) { return nullptr; }
+        const auto& v = s->second;
+        // first interval starting after t; the one before it may hold t.
+        auto it = std::upper_bound(v.cbegin(), v.cend(), t,
+                                   [](const datetime_ms& e, const interval& i)
+                                   { return e < i.from; });
+        if ( it == v.cbegin() ) { return nullptr; }
+        --it;
+        return ( t < it->until ) ? &(it->value) : nullptr;
+    }
+
+    /// Number of calibrations.
+    std::size_t size() const noexcept { return _size; }
+
+    /// Drop all calibrations.
+    void
+    clear() noexcept
+    {
+        _sats.clear();
+        _size = 0;
+    }
+
+private:
+    /// A calibration and its validity interval.
+    struct interval
+    {
+        datetime_ms from;
+        datetime_ms until;
+        V           value;
+    };
+
+    /// A (trimmed) field of a record.
+    static std::string
+    _field_(const std::string& record, std::size_t start, std::size_t chars)
+    {
+        if ( record.size() <= start ) { return std::string(); }
+        std::string f { record.substr(start, chars) };
+        const auto first = f.find_first_not_of(' ');
+        if ( first == std::string::npos ) { return std::string(); }
+        return f.substr(first, f.find_last_not_of(' ') - first + 1);
+    }
+
+    std::unordered_map<std::string, std::vector<interval>> _sats; ///<
+    ///< Calibrations of every satellite (by PRN and by SVN).
+    std::size_t _size { 0 }; ///< Number of calibrations.
+
+}; // end satellite_antenna_index
+
+} // end ngpt
+
+#endif
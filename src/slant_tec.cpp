@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "slant_tec.hpp"
+#include "ionex_collection.hpp"
+
+using ngpt::ionex;
+using ngpt::slant_tec;
+
+namespace
+{
+/// Number of nodes on a grid axis, given as (from, to, step).
+std::size_t
+_axis_nodes_(const std::tuple<ngpt::ionex_grd_type,ngpt::ionex_grd_type,
+                              ngpt::ionex_grd_type>& axis)
+{
+    return std::lround( (std::get<1>(axis)-std::get<0>(axis))
+                       / std::get<2>(axis) ) + 1;
+}
+}
+
+/// \throw std::runtime_error if the instance is not (fully) loaded or holds 3d
+///        maps.
+slant_tec::slant_tec(const ionex& inx)
+    : _stencil(0e0, 0e0, 0, 0e0, 0e0, 0),
+      _snapshot(inx.snapshot())
+{
+    if ( !_snapshot->is_loaded() || _snapshot->is_partial() ) {
+        throw std::runtime_error
+            ("slant_tec::slant_tec() -> ionex instance not (fully) loaded.");
+    }
+    this->init( inx );
+    _map_epochs = _snapshot->epochs;
+    _map_step   = ngpt::uniform_map_step( _map_epochs );
+    const double scale = std::pow(10e0, static_cast<double>(inx.exponent()));
+    for (std::size_t i=0; i<_map_epochs.size(); ++i) {
+        _maps.push_back( _snapshot->map(ionex::map_type::tec, i) );
+        _valid.push_back( _snapshot->validity(ionex::map_type::tec, i) );
+        _scales.push_back( scale );
+    }
+}
+
+/// \throw std::runtime_error if the collection holds 3d maps.
+slant_tec::slant_tec(const ionex_collection& inxs)
+    : _stencil(0e0, 0e0, 0, 0e0, 0e0, 0)
+{
+    // all files are on the same (lat, lon and height) grid.
+    this->init( inxs.file(0) );
+    _map_epochs = inxs.map_epochs();
+    _map_step   = ngpt::uniform_map_step( _map_epochs );
+    for (const auto& src : inxs._map_src) {
+        _maps.push_back( src.first->tec_map(src.second) );
+        _valid.push_back( src.first->validity(ionex::map_type::tec,
+                                              src.second) );
+    }
+    _scales = inxs._scales;
+}
+
+void
+slant_tec::init(const ionex& inx)
+{
+    if ( inx.height_levels() != 1 ) {
+        throw std::runtime_error
+            ("slant_tec::slant_tec() -> single-layer model needs 2d maps.");
+    }
+    _radius = inx.base_radius();
+    _height = std::get<0>( inx.height_grid() );
+
+    auto lat_grid = inx.latitude_grid();
+    auto lon_grid = inx.longtitude_grid();
+    _stencil = bilinear_batch(std::get<0>(lon_grid), std::get<2>(lon_grid),
+                              _axis_nodes_(lon_grid),
+                              std::get<0>(lat_grid), std::get<2>(lat_grid),
+                              _axis_nodes_(lat_grid));
+    _lat1 = std::min( std::get<0>(lat_grid), std::get<1>(lat_grid) );
+    _lat2 = std::max( std::get<0>(lat_grid), std::get<1>(lat_grid) );
+    _lon1 = std::get<0>(lon_grid);
+    _span = std::get<1>(lon_grid) - std::get<0>(lon_grid);
+}
+
+void
+slant_tec::reserve(std::size_t n)
+{
+    if ( _lat.size() < n ) {
+        _lat.resize( n );
+        _lon.resize( n );
+        _mf.resize ( n );
+    }
+}
+
+/**
+ *  \details The longtitudes are wrapped into [lon1, lon1+360) and the
+ *           latitudes are clamped to the grid. The maps bracketing the epoch
+ *           are interpolated at all points (epochs outside the maps get the
+ *           values of the first/last map) and then linearly in time.
+ */
+void
+slant_tec::vertical(datetime_ms t, const double* lat, const double* lon,
+                    std::size_t n, double* vtec)
+{
+    if ( _map_epochs.empty() ) {
+        throw std::runtime_error("slant_tec::vertical() -> no maps.");
+    }
+
+    // wrap/clamp onto the grid (in the work buffers).
+    this->reserve( n );
+    for (std::size_t i=0; i<n; ++i) {
+        double lo = lon[i] - _lon1;
+        lo -= 360e0 * std::floor(lo / 360e0);
+        // the last meridian of a global grid is the same as the first.
+        if ( lo > _span ) { lo -= 360e0; }
+        _lon[i] = _lon1 + lo;
+        _lat[i] = std::min( std::max(lat[i], _lat1), _lat2 );
+    }
+    if ( _stencil.set_points(_lon.data(), _lat.data(), n) ) {
+        throw std::runtime_error
+            ("slant_tec::vertical() -> point outside grid.");
+    }
+
+    // the maps bracketing t
+    const map_bracket b = ngpt::bracket_epoch( _map_epochs, _map_step, t );
+    const std::size_t i = b.i, j = b.j;
+
+    _stencil.apply( _maps[i], _valid[i], vtec );
+    if ( i == j ) {
+        const double s = _scales[i];
+        for (std::size_t p=0; p<n; ++p) { vtec[p] *= s; }
+        return;
+    }
+    if ( _row.size() < n ) { _row.resize( n ); }
+    _stencil.apply( _maps[j], _valid[j], _row.data() );
+    if ( _valid[i] || _valid[j] ) {
+        // missing values; scale first, then renormalize in time.
+        const double si = _scales[i], sj = _scales[j];
+        double* rowj = _row.data();
+        for (std::size_t p=0; p<n; ++p) {
+            vtec[p] *= si;
+            rowj[p] *= sj;
+        }
+        ngpt::blend_maps( b, vtec, rowj, n, vtec );
+        return;
+    }
+    const double coefi = b.wi * _scales[i];
+    const double coefj = b.wj * _scales[j];
+    const double* rowj = _row.data();
+    for (std::size_t p=0; p<n; ++p) {
+        vtec[p] = coefi*vtec[p] + coefj*rowj[p];
+    }
+}
+
+void
+slant_tec::finish(datetime_ms t, std::size_t n, double* stec, double* ipp_lat,
+                  double* ipp_lon)
+{
+    // report the pierce points with longtitudes in [-180, 180).
+    if ( ipp_lat ) { std::copy(_lat.data(), _lat.data()+n, ipp_lat); }
+    if ( ipp_lon ) {
+        for (std::size_t i=0; i<n; ++i) {
+            ipp_lon[i] = _lon[i] - 360e0*std::floor((_lon[i]+180e0)/360e0);
+        }
+    }
+
+    // the inputs of vertical() are copied into the work buffers first, so
+    // they may be the buffers themselves.
+    this->vertical(t, _lat.data(), _lon.data(), n, stec);
+    for (std::size_t i=0; i<n; ++i) { stec[i] *= _mf[i]; }
+}
@@ -0,0 +1,166 @@
+#ifndef __SLANT_TEC_NGPT_
+#define __SLANT_TEC_NGPT_
+
+#include <memory>
+#include <vector>
+#include "ionex.hpp"
+#include "bilinear.hpp"
+#include "pierce_point.hpp"
+
+/**
+ * \file
+ *
+ * \version
+ *
+ * \author    xanthos@mail.ntua.gr <br>
+ *            danast@mail.ntua.gr
+ *
+ * \date
+ *
+ * \brief     Batch slant TEC computation, off (loaded) IONEX TEC maps.
+ *
+ * \copyright Copyright © 2015 Dionysos Satellite Observatory, <br>
+ *            National Technical University of Athens. <br>
+ *            This work is free. You can redistribute it and/or modify it under
+ *            the terms of the Do What The Fuck You Want To Public License,
+ *            Version 2, as published by Sam Hocevar. See http://www.wtfpl.net/
+ *            for more details.
+ *
+ * <b><center><hr>
+ * National Technical University of Athens <br>
+ *      Dionysos Satellite Observatory     <br>
+ *        Higher Geodesy Laboratory        <br>
+ *      http://dionysos.survey.ntua.gr
+ * <hr></center></b>
+ *
+ */
+
+namespace ngpt
+{
+
+class ionex_collection;
+
+/*
+ * \class   slant_tec
+ *
+ * \details Compute slant TEC values for batches of observations (receiver to
+ *          satellite lines of sight) at a given epoch, using the single-layer
+ *          model of IONEX: for every observation, the pierce point on the
+ *          shell (at the height of the maps, above the base radius) and the
+ *          mapping factor are computed (see pierce_points()), the vertical TEC
+ *          at the pierce point is interpolated off the maps (bilinear in
+ *          space, linear in time) and the slant TEC is the vertical TEC times
+ *          the mapping factor.
+ *
+ *          All inputs and outputs are plain arrays (SoA). Work buffers are
+ *          kept in the instance and reused, so after warm-up a call does not
+ *          allocate.
+ *
+ * \warning An ionex_collection source must outlive the instance. Off an
+ *          ionex, the instance holds the maps published when it was
+ *          constructed (see ionex::map_snapshot); a later ionex::refresh()
+ *          leaves it as it was (i.e. it does not see the new maps).
+ *          Instances are not thread-safe (they hold the work buffers); use
+ *          one per thread.
+ */
+class slant_tec
+{
+public:
+    typedef ionex::datetime_ms datetime_ms;
+
+    /// Constructor off a (loaded, 2d) ionex instance.
+    /// \throw std::runtime_error if the instance is not loaded (for the whole
+    ///        grid, see ionex::load_region()) or holds 3d maps.
+    explicit slant_tec(const ionex& inx);
+
+    /// Constructor off an ionex collection (of 2d maps).
+    /// \throw std::runtime_error if the collection holds 3d maps.
+    explicit slant_tec(const ionex_collection& inxs);
+
+    /// The height of the single-layer shell (km).
+    double shell_height() const noexcept { return _height; }
+
+    /// The (spherical) earth radius (km).
+    double base_radius() const noexcept { return _radius; }
+
+    /// Vertical TEC (TECU) at n points, given their latitude and longtitude
+    /// (degrees); longtitudes are wrapped onto the grid and latitudes are
+    /// clamped to the grid (i.e. polar caps get the values of the last
+    /// latitude band). Missing (9999) map values are left out (see
+    /// bilinear_batch::apply()); points with no valid value get a NaN.
+    /// \throw std::runtime_error if a point is off a (regional) grid.
+    void vertical(datetime_ms t, const double* lat, const double* lon,
+                  std::size_t n, double* vtec);
+
+    /// Slant TEC (TECU) for n observations at epoch t, given the receiver
+    /// (cartesian) positions and the azimouth/elevation (radians) of the
+    /// satellites. If ipp_lat/ipp_lon are given, the pierce points (degrees)
+    /// are stored there.
+    template<ellipsoid E>
+    void
+    compute(datetime_ms t,
+            const double* x,  const double* y,  const double* z,
+            const double* az, const double* el, std::size_t n,
+            double* stec,
+            double* ipp_lat = nullptr, double* ipp_lon = nullptr)
+    {
+        this->reserve( n );
+        ngpt::pierce_points<E>(x, y, z, az, el, n, _radius, _height,
+                               _lat.data(), _lon.data(), _mf.data());
+        this->finish(t, n, stec, ipp_lat, ipp_lon);
+    }
+
+    /// Slant TEC (TECU) for n observations at epoch t, given the receiver and
+    /// satellite (cartesian) positions. If ipp_lat/ipp_lon are given, the
+    /// pierce points (degrees) are stored there.
+    template<ellipsoid E>
+    void
+    compute(datetime_ms t,
+            const double* x,  const double* y,  const double* z,
+            const double* sx, const double* sy, const double* sz,
+            std::size_t n,
+            double* stec,
+            double* ipp_lat = nullptr, double* ipp_lon = nullptr)
+    {
+        this->reserve( n );
+        ngpt::pierce_points<E>(x, y, z, sx, sy, sz, n, _radius, _height,
+                               _lat.data(), _lon.data(), _mf.data());
+        this->finish(t, n, stec, ipp_lat, ipp_lon);
+    }
+
+private:
+    /// Set the grid, radius and height; called by all constructors.
+    void init(const ionex&);
+
+    /// Make sure the work buffers can hold n observations.
+    void reserve(std::size_t n);
+
+    /// Interpolate the vertical TEC at the (buffered) pierce points and
+    /// apply the mapping factors.
+    void finish(datetime_ms t, std::size_t n, double* stec, double* ipp_lat,
+                double* ipp_lon);
+
+    bilinear_batch                     _stencil;    ///< Cell indexes/weights.
+    std::vector<datetime_ms>           _map_epochs; ///< Epochs of the maps.
+    long                               _map_step;   ///< Step between the maps
+    ///< (ms), or 0 if not evenly spaced.
+    std::shared_ptr<const ionex::map_snapshot> _snapshot; ///< Maps of the
+    ///< ionex (keeping _maps and _valid alive); null for collections.
+    std::vector<const ionex_raw_type*> _maps;       ///< (Raw) TEC maps.
+    std::vector<const std::uint64_t*>  _valid;      ///< Validity bitmask of
+    ///< every map; nullptr if complete.
+    std::vector<double>                _scales;     ///< Scale (10^exponent)
+    ///< of every map.
+    double                             _radius;     ///< Base radius (km).
+    double                             _height;     ///< Shell height (km).
+    double                             _lat1, _lat2; ///< Latitude limits.
+    double                             _lon1, _span; ///< First longtitude and
+    ///< longtitude span of the grid.
+    std::vector<double> _lat, _lon, _mf;  ///< Pierce points/mapping factors.
+    std::vector<double> _row;             ///< Values off the later map.
+
+}; // end slant_tec
+
+} // end ngpt
+
+#endif
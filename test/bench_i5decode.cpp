@@ -0,0 +1,148 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "i5decode.hpp"
+
+/*
+ * Throughput micro-benchmark for decoding IONEX TEC lines (16 x I5); compares
+ * the strtol loop (as formerly used in ionex::read_latitude_map()) to the
+ * scalar and the SIMD fixed-width decoders. Before timing, all decoders are
+ * checked against each other, and against a few malformed lines.
+ *
+ * Usage: benchI5decode [number of lines]
+ */
+
+using namespace ngpt;
+using bclock = std::chrono::steady_clock;
+
+constexpr std::size_t LINE_CHARS { 81 }; // 80 chars plus '\0'
+
+// the strtol loop
+int
+decode_strtol(const char* line, std::size_t n, std::int16_t* out)
+{
+    char* start = const_cast<char*>(line);
+    char* end;
+    std::size_t idx = 0;
+    int prev_errno = errno;
+    errno = 0;
+    for (long lval = std::strtol(start, &end, 10);
+         start != end && idx < n;
+         lval = std::strtol(start, &end, 10) )
+    {
+        out[idx++] = static_cast<std::int16_t>( lval );
+        start = end;
+    }
+    int status = ( errno || idx != n );
+    errno = prev_errno;
+    return status;
+}
+
+// make nlines random TEC lines; about 1/20 of the values is 9999
+std::vector<char>
+make_lines(std::size_t nlines)
+{
+    std::mt19937 gen ( 16012016 );
+    std::uniform_int_distribution<int> tec ( -99, 999 );
+    std::uniform_int_distribution<int> gap ( 0, 19 );
+    std::vector<char> buf ( nlines * LINE_CHARS );
+    for (std::size_t i=0; i<nlines; ++i) {
+        char* line = buf.data() + i*LINE_CHARS;
+        for (std::size_t k=0; k<I5_FIELDS_PER_LINE; ++k) {
+            int v = gap(gen) ? tec(gen) : IONEX_NO_VALUE;
+            std::snprintf(line+5*k, 6, "%5d", v);
+        }
+    }
+    return buf;
+}
+
+template<typename F>
+double
+time_it(const std::vector<char>& buf, std::size_t nlines, F&& decode,
+        long& checksum)
+{
+    std::int16_t vals[I5_FIELDS_PER_LINE];
+    checksum = 0;
+    auto start = bclock::now();
+    for (std::size_t i=0; i<nlines; ++i) {
+        if ( decode(buf.data() + i*LINE_CHARS, vals) ) {
+            std::cerr << "\nDecoding failed at line " << i << "!\n";
+            std::exit(1);
+        }
+        checksum += vals[i%I5_FIELDS_PER_LINE];
+    }
+    std::chrono::duration<double> secs = bclock::now() - start;
+    return secs.count();
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t nlines = ( argc > 1 ) ? std::strtoul(argv[1], nullptr, 10)
+                                      : 1000000;
+    std::vector<char> buf = make_lines( nlines );
+
+    // validation: all decoders must agree (also for partial lines)
+    std::int16_t v1[I5_FIELDS_PER_LINE], v2[I5_FIELDS_PER_LINE],
+                 v3[I5_FIELDS_PER_LINE];
+    std::uint16_t nv1, nv2;
+    for (std::size_t i=0; i<std::min(nlines, std::size_t(10000)); ++i) {
+        const char* line = buf.data() + i*LINE_CHARS;
+        std::size_t n = 1 + i%I5_FIELDS_PER_LINE;
+        if ( decode_strtol(line, n, v1)
+            || decode_i5_line_scalar(line, 5*n, n, v2, &nv1)
+            || decode_i5_line(line, 5*n, n, v3, &nv2)
+            || std::memcmp(v1, v2, n*sizeof(std::int16_t))
+            || std::memcmp(v1, v3, n*sizeof(std::int16_t))
+            || nv1 != nv2 ) {
+            std::cerr << "\nDecoders disagree at line " << i << "!\n";
+            return 1;
+        }
+    }
+    // malformed fields must be detected, wherever they are in the line
+    const char* bad_fields[] = { "  3- ", "  5 6", "   1a", "     ", "99999",
+                                 "--12 ", "   - ", "+  12", "12   " };
+    char line[LINE_CHARS];
+    std::size_t k = 0;
+    for (const char* field : bad_fields) {
+        std::memcpy(line, buf.data(), LINE_CHARS);
+        std::memcpy(line+5*k, field, 5);
+        if ( !decode_i5_line(line, 80, 16, v1)
+            || !decode_i5_line_scalar(line, 80, 16, v1) ) {
+            std::cerr << "\nMalformed line not detected: \"" << line << "\"\n";
+            return 1;
+        }
+        k = (k+7) % I5_FIELDS_PER_LINE;
+    }
+    std::cout << "\nDecoders validated (SIMD "
+              << (i5_simd_enabled() ? "enabled" : "not available") << ").";
+
+    // timing
+    long cs1, cs2, cs3;
+    double t1 = time_it(buf, nlines, [](const char* l, std::int16_t* v)
+                    { return decode_strtol(l, I5_FIELDS_PER_LINE, v); }, cs1);
+    double t2 = time_it(buf, nlines, [](const char* l, std::int16_t* v)
+                    { return decode_i5_line_scalar(l, 80, 16, v); }, cs2);
+    double t3 = time_it(buf, nlines, [](const char* l, std::int16_t* v)
+                    { return decode_i5_line(l, 80, 16, v); }, cs3);
+    if ( cs1 != cs2 || cs1 != cs3 ) {
+        std::cerr << "\nChecksums differ!\n";
+        return 1;
+    }
+
+    double mb = nlines * 80e0 / 1e6;
+    std::cout << "\nDecoded " << nlines << " lines (" << mb << " MB):";
+    std::cout << "\n  strtol loop : " << t1 << " sec, " << mb/t1 << " MB/sec";
+    std::cout << "\n  scalar I5   : " << t2 << " sec, " << mb/t2 << " MB/sec"
+              << " (x" << t1/t2 << ")";
+    std::cout << "\n  decode_i5   : " << t3 << " sec, " << mb/t3 << " MB/sec"
+              << " (x" << t1/t3 << ")";
+    std::cout << "\n";
+    return 0;
+}
@@ -1,6 +1,11 @@
+#include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include "antex.hpp"
 #include "antenna.hpp"
+#include "antenna_database.hpp"
+#include "pcv_batch.hpp"
 
 using namespace ngpt;
 
@@ -41,6 +46,245 @@ int main(int argc, char* argv[])
     print_pcv_info( pcv );
     */
 
+    // every antenna in the file must be found (off the antenna index) ...
+    for (const auto& i : atx.get_antenna_list()) {
+        if ( atx.find_antenna(i.first) ) {
+            std::cerr << "\nAntenna not found: " << i.first.to_string() << "\n";
+            return 1;
+        }
+    }
+    // ... and an unknown serial must resolve to the generic antenna.
+    ant = "TRMSPS985       NONE";
+    ant.set_serial_nr("NOSUCHSERIAL        ");
+    if ( atx.find_antenna(ant) ) {
+        std::cerr << "\nGeneric antenna not found for unknown serial!\n";
+        return 1;
+    }
+
+    // patterns off the cache: the same antenna (and an unknown serial of it)
+    // must be parsed once and share one handle.
+    auto h1 = atx.cached_antenna_pattern(ant);
+    ant = "TRMSPS985       NONE";
+    auto h2 = atx.cached_antenna_pattern(ant);
+    if ( !h1 || h1 != h2 || atx.pattern_cache().misses() != 1
+         || atx.pattern_cache().hits() != 1 ) {
+        std::cerr << "\nPattern cache failed!\n";
+        return 1;
+    }
+    // a bound smaller than the pattern evicts it (the handle stays valid).
+    atx.pattern_cache().set_capacity( h1->bytes() - 1 );
+    if ( atx.pattern_cache().size() || atx.pattern_cache().evictions() != 1
+         || !h1->no_azi_grid_pts() ) {
+        std::cerr << "\nPattern cache eviction failed!\n";
+        return 1;
+    }
+
+    // the (parallel) bulk load must hold every antenna, with the same
+    // patterns as read off the antex instance.
+    antenna_database db (argv[1]);
+    if ( db.size() != atx.get_antenna_list().size() ) {
+        std::cerr << "\nAntenna database size mismatch!\n";
+        return 1;
+    }
+    for (std::size_t i=0; i<db.size(); ++i) {
+        auto a = db.pattern_at(i);
+        auto b = atx.cached_antenna_pattern(db.antenna_at(i));
+        if ( !b || db.find(db.antenna_at(i)) != a
+             || a->frequencies() != b->frequencies()
+             || a->no_azi_grid_pts() != b->no_azi_grid_pts()
+             || a->azi_grid_pts() != b->azi_grid_pts()
+             || a->no_azi_pcv(a->zen1(), 0) != b->no_azi_pcv(b->zen1(), 0) ) {
+            std::cerr << "\nAntenna database mismatch for: "
+                      << db.antenna_at(i).to_string() << "\n";
+            return 1;
+        }
+    }
+    if ( !db.find(ant) ) {
+        std::cerr << "\nGeneric antenna not found in database!\n";
+        return 1;
+    }
+
+    // satellite antennas, by PRN/SVN and epoch: the PRN must resolve to the
+    // calibration (SVN) valid at the epoch, if any.
+    typedef antex::datetime_ms datetime_ms;
+    const datetime_ms t1999 (year{1999}, month{6}, day_of_month{1});
+    const datetime_ms t2004 (year{2004}, month{6}, day_of_month{1});
+    const datetime_ms t2008 (year{2008}, month{1}, day_of_month{1});
+    if (   atx.find_satellite_antenna("G01", t1999) != 1
+        || atx.find_satellite_antenna("G01", t2004) != 0
+        || db.find_satellite("G01", t1999)
+        || db.find_satellite("G01", t2004) != db.find_satellite("G001", t2004)
+        || db.find_satellite("G041", t2004)
+        || db.find_satellite("G01", t2008) != db.find_satellite("G041", t2008)
+        || db.find_satellite("G001", t2008) ) {
+        std::cerr << "\nSatellite antenna index failed!\n";
+        return 1;
+    }
+    auto sat = atx.cached_satellite_pattern("G01", t2008);
+    if ( !sat || sat->no_azi_pcv(sat->zen1(), 0)
+                 != db.find_satellite("G041", t2008)->no_azi_pcv(sat->zen1(), 0) ) {
+        std::cerr << "\nSatellite antenna pattern mismatch!\n";
+        return 1;
+    }
+
+    // a binary snapshot must hold exactly the same antennas and patterns ...
+    std::string snap_name ( std::string(argv[1]) + ".snapshot" );
+    if ( db.write_snapshot(snap_name.c_str()) ) {
+        std::cerr << "\nFailed to write the antenna snapshot!\n";
+        return 1;
+    }
+    {
+        antenna_database sdb (snap_name.c_str());
+        bool same = sdb.is_snapshot() && sdb.size() == db.size();
+        for (std::size_t i=0; same && i<db.size(); ++i) {
+            const auto& a = *db.pattern_at(i);
+            const auto& b = *sdb.pattern_at(i);
+            same = db.antenna_at(i).is_same(sdb.antenna_at(i))
+                && a.frequencies() == b.frequencies()
+                && a.has_azi_pcv() == b.has_azi_pcv()
+                && a.zen1() == b.zen1() && a.zen2() == b.zen2()
+                && a.dzen() == b.dzen();
+            for (std::size_t j=0; same && j<a.frequencies(); ++j) {
+                const auto& fa = a.freq_pcv_pattern(j);
+                const auto& fb = b.freq_pcv_pattern(j);
+                same = fa.north() == fb.north() && fa.east() == fb.east()
+                    && fa.up() == fb.up()
+                    && fa.type().raw_obs(0).satsys() == fb.type().raw_obs(0).satsys()
+                    && fa.type().raw_obs(0).band() == fb.type().raw_obs(0).band()
+                    && fa.no_azi_vector_c() == fb.no_azi_vector_c()
+                    && fa.azi_vector_c() == fb.azi_vector_c();
+            }
+        }
+        same = same
+            && sdb.find_satellite("G01", t2004) == sdb.find_satellite("G001", t2004)
+            && sdb.find_satellite("G01", t2008) == sdb.find_satellite("G041", t2008)
+            && !sdb.find_satellite("G01", t1999);
+        if ( !same ) {
+            std::cerr << "\nSnapshot and parsed databases differ!\n";
+            std::remove( snap_name.c_str() );
+            return 1;
+        }
+    }
+    // ... and a corrupted one (values, or header counts) must be rejected.
+    for (std::streamoff at : {std::streamoff(-1), std::streamoff(16)}) {
+        if ( db.write_snapshot(snap_name.c_str()) ) {
+            std::cerr << "\nFailed to write the antenna snapshot!\n";
+            return 1;
+        }
+        {
+            std::fstream f ( snap_name, std::ios::in | std::ios::out
+                                        | std::ios::binary );
+            if ( at < 0 ) {
+                f.seekp( at, std::ios::end );
+                f.put( '\x7f' );
+            } else {
+                // a number of antennas whose size (in bytes) wraps around.
+                const char huge[8] = { 1, 0, 0, 0, 0, 0, 0, 4 };
+                f.seekp( at );
+                f.write( huge, sizeof(huge) );
+            }
+        }
+        try {
+            antenna_database sdb (snap_name.c_str());
+            std::cerr << "\nCorrupted snapshot not detected!\n";
+            std::remove( snap_name.c_str() );
+            return 1;
+        } catch (std::runtime_error&) {}
+    }
+    std::remove( snap_name.c_str() );
+
+    // batched evaluation must match the (per point) interpolation, for all
+    // patterns and frequencies.
+    for (std::size_t i=0; i<db.size(); ++i) {
+        const auto& p = *db.pattern_at(i);
+        std::vector<pcv_type> zens, azis;
+        for (std::size_t z=0; z+1<p.no_azi_grid_pts(); ++z) {
+            for (int a=0; a<7; ++a) {
+                zens.push_back( p.zen1() + (z+.37f)*p.dzen() );
+                azis.push_back( 360.0f * (a+.61f) / 7 );
+            }
+        }
+        pcv_batch<pcv_type> nb (p), ab (p);
+        std::vector<pcv_type> nout (zens.size()), aout (zens.size());
+        if ( nb.set_points(zens.data(), nullptr, zens.size())
+             || ab.set_points(zens.data(), azis.data(), zens.size())
+             || ab.azimuth_dependent() != p.has_azi_pcv() ) {
+            std::cerr << "\nBatch points rejected for: "
+                      << db.antenna_at(i).to_string() << "\n";
+            return 1;
+        }
+        for (std::size_t f=0; f<p.frequencies(); ++f) {
+            nb.apply(f, nout.data());
+            ab.apply(f, aout.data());
+            for (std::size_t k=0; k<zens.size(); ++k) {
+                pcv_type an = p.has_azi_pcv()
+                            ? p.azi_pcv(zens[k], azis[k], f)
+                            : p.no_azi_pcv(zens[k], f);
+                if (   std::abs(nout[k] - p.no_azi_pcv(zens[k], f)) > 1e-4
+                    || std::abs(aout[k] - an) > 1e-4 ) {
+                    std::cerr << "\nBatch pcv mismatch for: "
+                              << db.antenna_at(i).to_string() << "\n";
+                    return 1;
+                }
+            }
+        }
+    }
+    {
+        // points off the grid are rejected (1-based index of the first one).
+        const auto& p = *db.pattern_at(0);
+        pcv_type zens[] = { p.zen1(), p.zen2() + p.dzen() };
+        pcv_batch<pcv_type> b (p);
+        if ( b.set_points(zens, nullptr, 2) != 2 || b.size() ) {
+            std::cerr << "\nBatch points off the grid not rejected!\n";
+            return 1;
+        }
+    }
+
+    // a precombined (e.g. ionosphere-free) pattern must evaluate to the
+    // linear combination of its frequencies' patterns.
+    for (std::size_t i=0; i<db.size(); ++i) {
+        const auto& p = *db.pattern_at(i);
+        if ( p.frequencies() < 2 ) { continue; }
+        const auto r0 = p.freq_pcv_pattern(0).type().raw_obs(0);
+        const auto r1 = p.freq_pcv_pattern(1).type().raw_obs(0);
+        const double c0 { 2.545727780163160 }, c1 { -1.545727780163160 };
+        observation_type lc (r0.satsys(), observable_type::carrier_phase,
+                             r0.band(), '?', c0);
+        lc.add_type(r1.satsys(), observable_type::carrier_phase, r1.band(),
+                    '?', c1);
+        const auto c = p.combination(lc);
+        const auto& f = c.freq_pcv_pattern(0);
+        const auto& f0 = p.freq_pcv_pattern(0);
+        const auto& f1 = p.freq_pcv_pattern(1);
+        bool ok = c.frequencies() == 1 && c.has_azi_pcv() == p.has_azi_pcv()
+            && f.type().raw_obs_num() == 2
+            && std::abs(f.up() - (c0*f0.up() + c1*f1.up())) < 1e-3
+            && std::abs(f.north() - (c0*f0.north() + c1*f1.north())) < 1e-3;
+        for (std::size_t k=0; ok && k+3<3*p.no_azi_grid_pts(); ++k) {
+            const pcv_type zen = p.zen1() + k*p.dzen()/3;
+            ok = std::abs(c.no_azi_pcv(zen, 0)
+                          - (c0*p.no_azi_pcv(zen, 0) + c1*p.no_azi_pcv(zen, 1)))
+                 < 1e-3;
+            for (pcv_type azi=0; ok && p.has_azi_pcv() && azi<360; azi+=25) {
+                ok = std::abs(c.azi_pcv(zen, azi, 0)
+                              - (c0*p.azi_pcv(zen, azi, 0)
+                                 + c1*p.azi_pcv(zen, azi, 1))) < 1e-3;
+            }
+        }
+        if ( !ok ) {
+            std::cerr << "\nCombined pattern mismatch for: "
+                      << db.antenna_at(i).to_string() << "\n";
+            return 1;
+        }
+        // a raw observable with no pattern cannot be combined.
+        lc.add_type(r0.satsys(), observable_type::carrier_phase, 9, '?', 1e0);
+        try {
+            p.combination(lc);
+            std::cerr << "\nInvalid combination not detected!\n";
+            return 1;
+        } catch (std::runtime_error&) {}
+    }
+
     // cool! let's try again with a different antenna
     ant = "TRMSPS985       NONE";
     pcv = atx.get_antenna_pattern( ant );
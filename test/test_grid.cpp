@@ -1,6 +1,8 @@
 #include <iostream>
 #include <vector>
+#include <cmath>
 #include "grid.hpp"
+#include "bilinear.hpp"
 
 using std::cout;
 template<class T> void ignore( const T& ) { }
@@ -36,6 +38,37 @@ int main()
     std::cout<<"    ("<<std::get<0>(upleft.node_index()) << "," << std::get<1>(upleft.node_index())<<")";
     std::cout<<"\n";
 
+    // batched bilinear interpolation on an IONEX-like grid (latitudes in
+    // descending order); a plane must be reproduced exactly, even on the limits.
+    ngpt::bilinear_batch bb (-180.0, 5.0, 73, 87.5, -2.5, 71);
+    std::vector<double> plane ( bb.grid_size() );
+    for (std::size_t j=0; j<71; ++j) {
+        for (std::size_t i=0; i<73; ++i) {
+            plane[j*73+i] = 2.0*(-180.0+5.0*i) - 3.0*(87.5-2.5*j) + 1.0;
+        }
+    }
+    std::vector<double> lons { 23.68, -180.0, 180.0, 0.0, 179.9 };
+    std::vector<double> lats { 32.14, 87.5, -87.5, 0.0, -87.4 };
+    std::vector<double> res  ( lons.size() );
+    if ( bb.set_points(lons.data(), lats.data(), lons.size()) ) {
+        std::cout<<"\nbilinear_batch: failed to set points!\n";
+        return 1;
+    }
+    bb.apply(plane.data(), res.data());
+    for (std::size_t i=0; i<res.size(); ++i) {
+        if ( std::abs(res[i] - (2.0*lons[i]-3.0*lats[i]+1.0)) > 1e-9 ) {
+            std::cout<<"\nbilinear_batch: wrong value at ("<<lons[i]<<", "
+                     <<lats[i]<<")!\n";
+            return 1;
+        }
+    }
+    double out_lon = 181.0, out_lat = 0.0;
+    if ( !bb.set_points(&out_lon, &out_lat, 1) ) {
+        std::cout<<"\nbilinear_batch: point outside grid not detected!\n";
+        return 1;
+    }
+    std::cout<<"\nbilinear_batch ok.\n";
+
 /*
   cout << "\n==================================================================";
   cout << "\nTESTING THE CLASS: ngpt::tick_axis_impl<>";
@@ -1,9 +1,25 @@
 #include <iostream>
+#include <fstream>
+#include <cstdio>
 #include <vector>
 #include <utility>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <stdexcept>
+#include <cstdint>
 
 #include "cursein.hpp"
 #include "ionex.hpp"
+#include "ionex_collection.hpp"
+#include "ionex_cursor.hpp"
+#include "ionex_diff.hpp"
+#include "ionex_climatology.hpp"
+#include "slant_tec.hpp"
+#include "ell2car.hpp"
+#include "parallel.hpp"
 
 using namespace ngpt;
 typedef std::pair<float, float> point;
@@ -11,9 +27,9 @@ typedef std::pair<float, float> point;
 int main(int argc, char* argv[])
 {
     // must pass the atx file to inspect as cmd
-    if ( argc != 2 ) {
+    if ( argc < 2 ) {
         std::cout << "\nAre you " fucking " " stupid "?";
-        std::cout << "\nUsage: testIonex <inxfile>\n";
+        std::cout << "\nUsage: testIonex <inxfile> [<inxfile of next day> ...]\n";
         return 1;
     }
 
@@ -32,6 +48,437 @@ int main(int argc, char* argv[])
         std::cout << "\n" << str_eph << " " << tec_vals[0][i];
     }
 
+    // decode all maps in memory; results should be exactly the same.
+    if ( inx.load() ) {
+        std::cout << "\nFailed to load the TEC maps!\n";
+        return 1;
+    }
+    std::cout << "\nIONEX loaded; " << inx.map_epochs().size() << " maps in memory.";
+    std::vector<ionex::datetime_ms> epochs2;
+    auto tec_vals2 = inx.interpolate( pts, epochs2 );
+    if ( epochs2.size() != epochs.size() || tec_vals2[0] != tec_vals[0] ) {
+        std::cout << "\nLoaded and streamed TEC values differ!\n";
+        return 1;
+    }
+    std::cout << "\nLoaded and streamed TEC values match.";
+
+    // concurrent queries off the (shared, const) loaded instance.
+    {
+        const ionex& shared = inx;
+        std::vector<int> ok ( 8, 0 );
+        ngpt::parallel_for(ok.size(), [&](std::size_t i) {
+            std::vector<ionex::datetime_ms> e;
+            ok[i] = shared.interpolate( pts, e ) == tec_vals2;
+        }, 4);
+        if ( std::count(ok.begin(), ok.end(), 1) != 8 ) {
+            std::cout << "\nConcurrent and serial TEC values differ!\n";
+            return 1;
+        }
+        std::cout << "\nConcurrent queries off a shared instance match.";
+    }
+
+    // same thing, via the memory-mapped reader; the cubes (of all map types)
+    // should be identical.
+    ionex minx ( argv[1] );
+    if ( minx.load(ionex::reader_backend::mmap) ) {
+        std::cout << "\nFailed to load the (memory-mapped) maps!\n";
+        return 1;
+    }
+    const ionex::map_type types[] = { ionex::map_type::tec,
+                                      ionex::map_type::rms,
+                                      ionex::map_type::height };
+    const char* type_names[] = { "TEC", "RMS", "HGT" };
+    std::size_t maps = inx.map_epochs().size();
+    for (int t=0; t<3; ++t) {
+        if ( !inx.has_maps(types[t]) ) { continue; }
+        if ( minx.map_epochs() != inx.map_epochs()
+            || !minx.has_maps(types[t])
+            || !std::equal(inx.map(types[t], 0), inx.map(types[t], maps),
+                           minx.map(types[t], 0)) ) {
+            std::cout << "\nMapped and streamed "<<type_names[t]<<" maps differ!\n";
+            return 1;
+        }
+        std::cout << "\nMapped and streamed " << type_names[t] << " maps match ("
+                  << maps << "x" << inx.map_size() << " values).";
+    }
+
+    // a binary cache of the instance should hold exactly the same maps.
+    std::string cache_name ( std::string(argv[1]) + ".cache" );
+    if ( inx.write_cache(cache_name.c_str()) ) {
+        std::cout << "\nFailed to write the binary cache!\n";
+        return 1;
+    }
+    {
+        ionex cinx ( cache_name.c_str() );
+        std::remove( cache_name.c_str() );
+        std::vector<ionex::datetime_ms> e1, e2;
+        auto v1 = cinx.interpolate( pts, e1 );
+        auto v2 = inx.interpolate ( pts, e2 );
+        bool same = cinx.is_cached() && cinx.is_loaded()
+            && cinx.map_epochs() == inx.map_epochs()
+            && cinx.first_epoch() == inx.first_epoch()
+            && cinx.last_epoch() == inx.last_epoch()
+            && cinx.latitude_grid() == inx.latitude_grid()
+            && cinx.longtitude_grid() == inx.longtitude_grid()
+            && cinx.height_grid() == inx.height_grid()
+            && e1 == e2 && v1[0] == v2[0];
+        for (int t=0; same && t<3; ++t) {
+            same = cinx.has_maps(types[t]) == inx.has_maps(types[t])
+                && ( !inx.has_maps(types[t])
+                    || std::equal(inx.map(types[t], 0), inx.map(types[t], maps),
+                                  cinx.map(types[t], 0)) );
+        }
+        if ( !same ) {
+            std::cout << "\nCached and parsed instances differ!\n";
+            return 1;
+        }
+        std::cout << "\nCached and parsed instances match.";
+    }
+
+    // corrupted cache headers (a map count wrapping the size checks, a zero
+    // latitude step) must be rejected.
+    for (int c=0; c<2; ++c) {
+        if ( inx.write_cache(cache_name.c_str()) ) {
+            std::cout << "\nFailed to write the binary cache!\n";
+            return 1;
+        }
+        {
+            std::fstream f ( cache_name, std::ios::in | std::ios::out
+                                         | std::ios::binary );
+            const std::uint64_t nmaps = 1ULL << 63;
+            const float step = 0e0f;
+            f.seekp( c ? 68 : 32 );
+            if ( c ) { f.write(reinterpret_cast<const char*>(&step), sizeof(step)); }
+            else     { f.write(reinterpret_cast<const char*>(&nmaps), sizeof(nmaps)); }
+        }
+        bool rejected;
+        try {
+            ionex cinx ( cache_name.c_str() );
+            rejected = !cinx.is_loaded();
+        } catch (std::runtime_error&) {
+            rejected = true;
+        }
+        std::remove( cache_name.c_str() );
+        if ( !rejected ) {
+            std::cout << "\nCorrupted cache file accepted!\n";
+            return 1;
+        }
+    }
+
+    // a growing (TEC-only) product; start off the first half of the maps and
+    // refresh once all of them are recorded.
+    if ( !inx.has_maps(types[1]) && !inx.has_maps(types[2])
+        && detect_compression(argv[1]) == compression::none ) {
+        std::string grow_name ( std::string(argv[1]) + ".grow" );
+        auto write_maps = [&](std::size_t n) {
+            std::ifstream fin  ( argv[1] );
+            std::ofstream fout ( grow_name );
+            std::string line;
+            std::size_t written = 0;
+            while ( written < n && std::getline(fin, line) ) {
+                if ( line.size() > 60 && !line.compare(60, 17, "# OF MAPS IN FILE") ) {
+                    std::string count ( std::to_string(n) );
+                    line.replace(0, 6, std::string(6-count.size(), ' ') + count);
+                }
+                if ( line.size() > 60 && !line.compare(60, 14, "END OF TEC MAP") ) {
+                    ++written;
+                }
+                fout << line << "\n";
+            }
+            fout << std::string(60, ' ') << "END OF FILE\n";
+        };
+        write_maps( maps/2 );
+        ionex ginx ( grow_name.c_str() );
+        std::size_t added = 0;
+        bool ok = !ginx.load() && ginx.map_epochs().size() == maps/2;
+        // query (off another thread) while refreshing; every query sees
+        // either the old or the new maps, and a pinned snapshot is kept.
+        const auto before = ginx.snapshot();
+        std::atomic<bool> done ( false ), reads_ok ( true );
+        std::thread reader ( [&]() {
+            const ionex& cginx = ginx;
+            do {
+                std::vector<ionex::datetime_ms> ep;
+                cginx.interpolate( pts, ep );
+                if ( ep.size() != maps/2 && ep.size() != maps ) {
+                    reads_ok = false;
+                }
+            } while ( !done );
+        } );
+        write_maps( maps );
+        ok = ok && !ginx.refresh(&added);
+        done = true;
+        reader.join();
+        ok = ok && reads_ok && added == maps - maps/2
+            && ginx.map_epochs() == inx.map_epochs()
+            && std::equal(inx.tec_map(0), inx.tec_map(maps), ginx.tec_map(0))
+            && before->epochs.size() == maps/2
+            && std::equal(inx.tec_map(0), inx.tec_map(maps/2),
+                          before->map(ionex::map_type::tec, 0));
+        std::remove( grow_name.c_str() );
+        if ( !ok ) {
+            std::cout << "\nRefreshed and parsed instances differ!\n";
+            return 1;
+        }
+        std::cout << "\nRefreshed instance picked up " << added << " new maps.";
+    }
+
+    // any other map type (at the last height) should also be the same,
+    // streamed or loaded.
+    for (int t=1; t<3; ++t) {
+        if ( !inx.has_maps(types[t]) ) { continue; }
+        ionex sinx ( argv[1] );
+        std::size_t level = inx.height_levels() - 1;
+        std::vector<ionex::datetime_ms> e1, e2;
+        auto v1 = sinx.interpolate( pts, e1, nullptr, nullptr, 0, types[t], level );
+        auto v2 = inx.interpolate ( pts, e2, nullptr, nullptr, 0, types[t], level );
+        if ( e1 != e2 || v1[0] != v2[0] ) {
+            std::cout << "\nLoaded and streamed "<<type_names[t]<<" values differ!\n";
+            return 1;
+        }
+        std::cout << "\nLoaded and streamed " << type_names[t] << " values match"
+                  << " (height level " << level << ").";
+    }
+
+    // decoding only a region around the point (either backend) should give
+    // the same values.
+    for (auto backend : {ionex::reader_backend::stream,
+                         ionex::reader_backend::mmap}) {
+        ionex rinx ( argv[1] );
+        if ( rinx.load_region(30e0, 35e0, 20e0, 28e0, backend)
+            || !rinx.is_partial() ) {
+            std::cout << "\nFailed to load a region of the maps!\n";
+            return 1;
+        }
+        std::vector<ionex::datetime_ms> e1;
+        auto v1 = rinx.interpolate( pts, e1 );
+        if ( e1 != epochs2 || v1[0] != tec_vals2[0]
+            || !rinx.write_cache(cache_name.c_str()) ) {
+            std::cout << "\nRegion and fully loaded TEC values differ!\n";
+            return 1;
+        }
+        // the region goes with the maps; a snapshot of the partial maps
+        // stays partial once the whole grid is loaded.
+        const auto part = rinx.snapshot();
+        if ( rinx.load(backend) || rinx.is_partial() || !part->is_partial()
+            || !rinx.covers_cell(0) || part->covers_cell(0) ) {
+            std::cout << "\nRegion not kept with its maps!\n";
+            return 1;
+        }
+    }
+    std::cout << "\nRegion and fully loaded TEC values match.";
+
+    // stream a high-rate series through a cursor; should match interpolate().
+    ionex::datetime_ms from { inx.first_epoch() }, to { inx.first_epoch() };
+    to.add_seconds( 3L*3600L*1000L );
+    std::vector<ionex::datetime_ms> epochs4;
+    auto tec_vals4 = inx.interpolate( pts, epochs4, &from, &to, 30 );
+    ionex_cursor cursor ( inx, pts, from, to, 30 );
+    double row;
+    std::size_t rows = 0;
+    cursor.for_each(&row, [&](const ionex::datetime_ms& t, const double* tec) {
+        if ( !(t == epochs4[rows]) || *tec != tec_vals4[0][rows] ) {
+            return false;
+        }
+        ++rows;
+        return true;
+    });
+    if ( rows != epochs4.size() ) {
+        std::cout << "\nCursor and interpolate() results differ!\n";
+        return 1;
+    }
+    std::cout << "\nCursor streamed " << rows << " epochs; matches interpolate().";
+
+    // differences of the (mmap) loaded instance minus the parsed one; all
+    // zero, over all points and epochs.
+    {
+        ionex_cursor rcur ( inx,  pts, epochs4 );
+        ionex_cursor pcur ( minx, pts, epochs4 );
+        ionex_diff diff ( rcur, pcur );
+        double d;
+        std::size_t n = diff.for_each(&d, [](const ionex::datetime_ms&,
+                                             const double*) { return true; });
+        const auto& st = diff.total();
+        if ( n != epochs4.size() || diff.cells()[0].count() != st.count()
+            || (st.count() && (st.min() != 0e0 || st.max() != 0e0)) ) {
+            std::cout << "\nDifferences of identical products not zero!\n";
+            return 1;
+        }
+        std::cout << "\nDifferences of identical products are zero ("
+                  << n << " epochs).";
+    }
+
+    // bracketing maps off the (constant) step should be exactly those found
+    // by searching.
+    const long map_step = ngpt::uniform_map_step( inx.map_epochs() );
+    if ( map_step ) {
+        for (const auto& t : epochs4) {
+            auto b1 = ngpt::bracket_epoch( inx.map_epochs(), map_step, t );
+            auto b2 = ngpt::bracket_epoch( inx.map_epochs(), 0, t );
+            if ( b1.i != b2.i || b1.j != b2.j || b1.wi != b2.wi
+                || b1.wj != b2.wj ) {
+                std::cout << "\nStep and search map brackets differ!\n";
+                return 1;
+            }
+        }
+        std::cout << "\nMap brackets off the step (" << map_step
+                  << " ms) match the search.";
+    }
+
+    // missing (9999) values are left out; at the middle of a cell, the value
+    // is the mean of the valid nodes of the cell.
+    if ( const std::uint64_t* valid = inx.validity(ionex::map_type::tec, 0) ) {
+        const auto lat = inx.latitude_grid(), lon = inx.longtitude_grid();
+        const std::size_t nlat = std::lround( (std::get<1>(lat)-std::get<0>(lat))
+                                              / std::get<2>(lat) ) + 1;
+        const std::size_t nlon = std::lround( (std::get<1>(lon)-std::get<0>(lon))
+                                              / std::get<2>(lon) ) + 1;
+        auto ok = [valid](std::size_t k) {
+            return static_cast<int>( (valid[k/64] >> (k%64)) & 1u );
+        };
+        const ionex_raw_type* map = inx.tec_map(0);
+        bool checked = false;
+        for (std::size_t k=0; !checked && k<(nlat-1)*nlon; ++k) {
+            const std::size_t nodes[] = { k, k+1, k+nlon, k+nlon+1 };
+            int n = 0;
+            double sum = 0e0;
+            for (std::size_t node : nodes) {
+                n   += ok( node );
+                sum += ok( node ) ? map[node] : 0;
+            }
+            if ( k%nlon == nlon-1 || n == 0 || n == 4 ) { continue; }
+            std::vector<point> cpt { point(
+                std::get<0>(lon) + (k%nlon + 0.5e0)*std::get<2>(lon),
+                std::get<0>(lat) + (k/nlon + 0.5e0)*std::get<2>(lat)) };
+            std::vector<ionex::datetime_ms> e0 { inx.map_epochs()[0] };
+            auto v = inx.interpolate( cpt, e0 );
+            const double expected = sum / n * std::pow(10e0, inx.exponent());
+            if ( std::abs(v[0][0] - expected) > 1e-9 ) {
+                std::cout << "\nValues next to missing ones are wrong!\n";
+                return 1;
+            }
+            checked = true;
+        }
+        if ( checked ) {
+            std::cout << "\nMissing values left out of the interpolation.";
+        }
+    }
+
+    // climatology (streamed off the file); the statistics of the first cell
+    // are those of the series of the first grid node.
+    {
+        ionex_climatology clim ( {argv[1]} );
+        const auto lat = inx.latitude_grid(), lon = inx.longtitude_grid();
+        std::vector<point> node { point(std::get<0>(lon), std::get<0>(lat)) };
+        std::vector<ionex::datetime_ms> e0;
+        auto v = inx.interpolate( node, e0 );
+        running_stats st;
+        for (double x : v[0]) { st.add( x ); }
+        const auto& c = clim.cell(0);
+        const double p50 = clim.percentile(0, 50e0);
+        if ( clim.maps() != maps || clim.cells()*inx.height_levels() != inx.map_size()
+            || c.count() != st.count()
+            || (st.count() && (std::abs(c.mean() - st.mean()) > 1e-9
+                               || c.max() != st.max() || c.min() != st.min()
+                               || !(p50 >= c.min() && p50 <= c.max()))) ) {
+            std::cout << "\nClimatology and interpolated series differ!\n";
+            return 1;
+        }
+        std::cout << "\nClimatology of " << clim.maps() << " maps; cell 0: mean "
+                  << c.mean() << ", median " << p50 << ", max " << c.max();
+    }
+
+    // slant TEC; at the zenith, the pierce point is the receiver's location
+    // and slant TEC is vertical TEC. Az/El and cartesian input should agree.
+    if ( inx.height_levels() == 1 ) {
+        constexpr double d2r { DPI / 180e0 };
+        double x, y, z;
+        ell2car<ellipsoid::wgs84>(pts[0].second*d2r, pts[0].first*d2r, 0e0,
+                                  x, y, z);
+        double az[] = { 0e0, 1e0 }, el[] = { DPI/2e0, 0.3e0 };
+        double xs[] = { x, x }, ys[] = { y, y }, zs[] = { z, z };
+        double stec[2], ilat[2], ilon[2];
+        slant_tec engine ( inx );
+        engine.compute<ellipsoid::wgs84>(epochs[3], xs, ys, zs, az, el, 2,
+                                         stec, ilat, ilon);
+        if ( std::abs(stec[0] - tec_vals[0][3]) > 1e-3
+            || std::abs(ilat[0] - pts[0].second) > 1e-4
+            || std::abs(ilon[0] - pts[0].first) > 1e-4
+            || !(stec[1] > stec[0]) ) {
+            std::cout << "\nZenith slant TEC differs from vertical TEC!\n";
+            return 1;
+        }
+        // satellites 20000 km away, in the same directions.
+        double sx[2], sy[2], sz[2], stec2[2];
+        for (int i=0; i<2; ++i) {
+            double n = std::cos(el[i])*std::cos(az[i]) * 20e6;
+            double e = std::cos(el[i])*std::sin(az[i]) * 20e6;
+            double u = std::sin(el[i]) * 20e6;
+            double f = pts[0].second*d2r, l = pts[0].first*d2r;
+            sx[i] = x - std::sin(f)*std::cos(l)*n - std::sin(l)*e
+                      + std::cos(f)*std::cos(l)*u;
+            sy[i] = y - std::sin(f)*std::sin(l)*n + std::cos(l)*e
+                      + std::cos(f)*std::sin(l)*u;
+            sz[i] = z + std::cos(f)*n + std::sin(f)*u;
+        }
+        engine.compute<ellipsoid::wgs84>(epochs[3], xs, ys, zs, sx, sy, sz, 2,
+                                         stec2);
+        if ( std::abs(stec2[0]-stec[0]) > 1e-6
+            || std::abs(stec2[1]-stec[1]) > 1e-6 ) {
+            std::cout << "\nSlant TEC from Az/El and cartesian input differ!\n";
+            return 1;
+        }
+        std::cout << "\nSlant TEC ok; zenith " << stec[0] << ", elevation 0.3 rad "
+                  << stec[1] << " TECU.";
+    }
+
+    // more files given; load all of them as a collection.
+    if ( argc > 2 ) {
+        std::vector<std::string> files ( argv+1, argv+argc );
+        ionex_collection inxs ( files );
+        std::size_t all_maps = 0;
+        for (std::size_t i=0; i<inxs.size(); ++i) {
+            all_maps += inxs.file(i).map_epochs().size();
+        }
+        std::cout << "\nCollection of " << inxs.size() << " files; "
+                  << inxs.map_epochs().size() << " maps (out of " << all_maps
+                  << " in files).";
+        if ( !std::is_sorted(inxs.map_epochs().cbegin(), inxs.map_epochs().cend())
+            || std::adjacent_find(inxs.map_epochs().cbegin(),
+                                  inxs.map_epochs().cend())
+               != inxs.map_epochs().cend() ) {
+            std::cout << "\nCollection epochs are not strictly increasing!\n";
+            return 1;
+        }
+        // within the first file, results should be the same as before.
+        std::vector<ionex::datetime_ms> epochs3 ( inx.map_epochs() );
+        auto tec_vals3 = inxs.interpolate( pts, epochs3 );
+        if ( tec_vals3[0] != tec_vals[0] ) {
+            std::cout << "\nCollection and file TEC values differ!\n";
+            return 1;
+        }
+        std::cout << "\nCollection and file TEC values match.";
+
+        // a climatology of the files uses every (distinct) map once.
+        ionex_climatology clim ( files, ionex::map_type::tec, 0, 0e0, 256e0,
+                                 512, 2 );
+        if ( clim.maps() != inxs.map_epochs().size() ) {
+            std::cout << "\nClimatology of the files used "<<clim.maps()<<" maps!\n";
+            return 1;
+        }
+        std::cout << "\nClimatology of the files used " << clim.maps() << " maps.";
+        // ... and is the same (bit for bit) on any number of threads.
+        std::vector<std::string> rfiles ( files.rbegin(), files.rend() );
+        ionex_climatology clim1 ( rfiles, ionex::map_type::tec, 0, 0e0, 256e0,
+                                  512, 1 );
+        if (   clim1.mean_map() != clim.mean_map()
+            || clim1.stddev_map() != clim.stddev_map()
+            || clim1.percentile_map(50e0) != clim.percentile_map(50e0) ) {
+            std::cout << "\nClimatology depends on the number of threads!\n";
+            return 1;
+        }
+    }
+
     std::cout << "\n";
     return 0;
 }